@@ -0,0 +1,152 @@
+/*
+ * fsbench.c - compares reading 4KB filesystem blocks as stored (a memcpy out
+ * of the image, what the kernel does for an uncompressed module) against
+ * decompressing them with the kernel's LZ4 decoder, and estimates what the
+ * smaller image saves when it has to come over the network first.
+ *
+ * Build on the host:   gcc -O2 -fno-builtin -o fsbench fsbench.c lz4enc.c ../student-distrib/fs/lz4.c
+ * Usage:               ./fsbench [-n iterations] [-l link_mbit] <file>...
+ *
+ * Any file works (an image made by mkfs, or the programs that go into one),
+ * it's cut into 4KB blocks and each block is compressed on its own like
+ * mkfs -z does.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lz4enc.h"
+
+#define BLOCK_SIZE 4096
+
+/* from student-distrib/fs/lz4.c, the kernel's types are the same sizes */
+int lz4_decompress_block(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len);
+
+typedef struct zblock {
+    uint8_t *data;
+    int len;            /* BLOCK_SIZE if stored uncompressed */
+} zblock_t;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t *load(char **files, int nfiles, size_t *blocks) {
+    size_t size = 0;
+    uint8_t *buf = NULL;
+    int i;
+    for (i = 0; i < nfiles; i++) {
+        FILE *f = fopen(files[i], "rb");
+        if (!f) {
+            fprintf(stderr, "fsbench: cannot open %s\n", files[i]);
+            exit(1);
+        }
+        fseek(f, 0, SEEK_END);
+        long len = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        /* every file starts on a block boundary, like in the image */
+        size_t padded = (len + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+        buf = realloc(buf, size + padded);
+        memset(buf + size, 0, padded);
+        if (len && fread(buf + size, 1, len, f) != (size_t)len) {
+            fprintf(stderr, "fsbench: cannot read %s\n", files[i]);
+            exit(1);
+        }
+        fclose(f);
+        size += padded;
+    }
+    *blocks = size / BLOCK_SIZE;
+    return buf;
+}
+
+int main(int argc, char **argv) {
+    int iters = 200;
+    double link_mbit = 100;
+    int argi = 1;
+    size_t nblocks, b, zsize = 0;
+    int it;
+
+    while (argi + 1 < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-n") == 0)
+            iters = atoi(argv[argi + 1]);
+        else if (strcmp(argv[argi], "-l") == 0)
+            link_mbit = atof(argv[argi + 1]);
+        else
+            break;
+        argi += 2;
+    }
+    if (argi >= argc || iters <= 0 || link_mbit <= 0) {
+        fprintf(stderr, "usage: %s [-n iterations] [-l link_mbit] <file>...\n", argv[0]);
+        return 1;
+    }
+
+    uint8_t *raw = load(argv + argi, argc - argi, &nblocks);
+    if (nblocks == 0) {
+        fprintf(stderr, "fsbench: nothing to read\n");
+        return 1;
+    }
+    zblock_t *z = calloc(nblocks, sizeof(zblock_t));
+    uint8_t out[BLOCK_SIZE];
+    volatile uint32_t sink = 0;
+
+    double t = now();
+    for (b = 0; b < nblocks; b++) {
+        z[b].data = malloc(BLOCK_SIZE);
+        z[b].len = lz4_compress_block(raw + b * BLOCK_SIZE, BLOCK_SIZE, z[b].data, BLOCK_SIZE - 1);
+        if (z[b].len < 0) {
+            memcpy(z[b].data, raw + b * BLOCK_SIZE, BLOCK_SIZE);
+            z[b].len = BLOCK_SIZE;
+        }
+        zsize += z[b].len;
+    }
+    double compress_time = now() - t;
+
+    /* every block has to come back exactly */
+    for (b = 0; b < nblocks; b++) {
+        int n = z[b].len == BLOCK_SIZE ? (memcpy(out, z[b].data, BLOCK_SIZE), BLOCK_SIZE)
+                                       : lz4_decompress_block(z[b].data, z[b].len, out, BLOCK_SIZE);
+        if (n != BLOCK_SIZE || memcmp(out, raw + b * BLOCK_SIZE, BLOCK_SIZE) != 0) {
+            fprintf(stderr, "fsbench: block %zu does not round trip\n", b);
+            return 1;
+        }
+    }
+
+    t = now();
+    for (it = 0; it < iters; it++) {
+        for (b = 0; b < nblocks; b++) {
+            memcpy(out, raw + b * BLOCK_SIZE, BLOCK_SIZE);
+            sink += out[b % BLOCK_SIZE];
+        }
+    }
+    double raw_time = (now() - t) / iters;
+
+    t = now();
+    for (it = 0; it < iters; it++) {
+        for (b = 0; b < nblocks; b++) {
+            if (z[b].len == BLOCK_SIZE)
+                memcpy(out, z[b].data, BLOCK_SIZE);
+            else
+                lz4_decompress_block(z[b].data, z[b].len, out, BLOCK_SIZE);
+            sink += out[b % BLOCK_SIZE];
+        }
+    }
+    double lz4_time = (now() - t) / iters;
+
+    double mb = nblocks * (double)BLOCK_SIZE / (1 << 20);
+    double link_bytes = link_mbit * 1e6 / 8;
+    double raw_load = nblocks * (double)BLOCK_SIZE / link_bytes;
+    double z_load = zsize / link_bytes;
+
+    printf("%zu blocks, %.2f MB, compressed to %.2f MB (%.1f%%) in %.1f ms\n",
+           nblocks, mb, zsize / (double)(1 << 20), 100.0 * zsize / (nblocks * (double)BLOCK_SIZE),
+           compress_time * 1e3);
+    printf("read as stored:      %9.1f MB/s  (%.3f ms per pass)\n", mb / raw_time, raw_time * 1e3);
+    printf("lz4 decompress:      %9.1f MB/s  (%.3f ms per pass)\n", mb / lz4_time, lz4_time * 1e3);
+    printf("at %.0f Mbit/s: load %.1f ms raw, %.1f ms compressed + %.1f ms to decompress everything once\n",
+           link_mbit, raw_load * 1e3, z_load * 1e3, lz4_time * 1e3);
+    return sink == 0xFFFFFFFF;
+}
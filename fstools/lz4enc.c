@@ -0,0 +1,94 @@
+/*
+ * lz4enc.c - LZ4 block encoder, see lz4enc.h
+ */
+#include <string.h>
+
+#include "lz4enc.h"
+
+#define MIN_MATCH       4
+#define LAST_LITERALS   5       /* the block has to end with this many literals */
+#define MF_LIMIT        12      /* the last match has to start this far from the end */
+#define MAX_OFFSET      65535
+#define HASH_BITS       12
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash4(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* writes the 255-run encoding of a length that didn't fit in its nibble */
+static int put_length(uint8_t **op, uint8_t *oend, int len) {
+    for (; len >= 255; len -= 255) {
+        if (*op >= oend)
+            return -1;
+        *(*op)++ = 255;
+    }
+    if (*op >= oend)
+        return -1;
+    *(*op)++ = (uint8_t)len;
+    return 0;
+}
+
+/* emits literals [lit, lit + lit_len) and, if match_len, a match */
+static int put_sequence(uint8_t **op, uint8_t *oend, const uint8_t *lit, int lit_len,
+                        int offset, int match_len) {
+    uint8_t *token = (*op)++;
+    if (token >= oend)
+        return -1;
+    *token = (uint8_t)((lit_len < 15 ? lit_len : 15) << 4);
+    if (lit_len >= 15 && put_length(op, oend, lit_len - 15) != 0)
+        return -1;
+    if (oend - *op < lit_len)
+        return -1;
+    memcpy(*op, lit, lit_len);
+    *op += lit_len;
+    if (!match_len)
+        return 0;
+
+    if (oend - *op < 2)
+        return -1;
+    *(*op)++ = (uint8_t)offset;
+    *(*op)++ = (uint8_t)(offset >> 8);
+    match_len -= MIN_MATCH;
+    *token |= match_len < 15 ? match_len : 15;
+    if (match_len >= 15 && put_length(op, oend, match_len - 15) != 0)
+        return -1;
+    return 0;
+}
+
+int lz4_compress_block(const uint8_t *src, int src_len, uint8_t *dst, int dst_cap) {
+    int table[1 << HASH_BITS];
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dst_cap;
+    int anchor = 0;
+    int ip = 0;
+
+    memset(table, 0xFF, sizeof(table));
+    while (ip < src_len - MF_LIMIT) {
+        uint32_t seq = read32(src + ip);
+        uint32_t h = hash4(seq);
+        int ref = table[h];
+        table[h] = ip;
+        if (ref < 0 || ip - ref > MAX_OFFSET || read32(src + ref) != seq) {
+            ip++;
+            continue;
+        }
+
+        int len = MIN_MATCH;
+        while (ip + len < src_len - LAST_LITERALS && src[ref + len] == src[ip + len])
+            len++;
+        if (put_sequence(&op, oend, src + anchor, ip - anchor, ip - ref, len) != 0)
+            return -1;
+        ip += len;
+        anchor = ip;
+    }
+
+    if (put_sequence(&op, oend, src + anchor, src_len - anchor, 0, 0) != 0)
+        return -1;
+    return (int)(op - dst);
+}
@@ -0,0 +1,19 @@
+/*
+ * lz4enc.h - LZ4 block encoder for the host tools
+ *
+ * Produces the LZ4 block format that student-distrib/fs/lz4.c decodes.
+ * Greedy single-probe hash matching, so it is fast but doesn't squeeze out
+ * the last few percent the reference encoder would.
+ */
+#ifndef LZ4ENC_H
+#define LZ4ENC_H
+
+#include <stdint.h>
+
+/*
+ * Compresses src_len bytes of src into dst. Returns the compressed size, or
+ * -1 if it doesn't fit in dst_cap bytes.
+ */
+int lz4_compress_block(const uint8_t *src, int src_len, uint8_t *dst, int dst_cap);
+
+#endif
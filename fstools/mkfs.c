@@ -0,0 +1,276 @@
+/*
+ * mkfs.c - builds a filesystem image from a host directory tree
+ *
+ * Same layout as the image createfs makes (boot block, inode blocks, data
+ * blocks, all 4KB), but subdirectories are kept: a subdirectory is a
+ * directory entry of type 1 whose inode holds packed 64B directory entries,
+ * one per child. The root directory stays in the boot block so that old
+ * kernels can still read the top level.
+ *
+ * With -z every data block is LZ4 compressed on its own, and the data area
+ * becomes a block map (offset and length of each compressed block) followed
+ * by the compressed blocks. The kernel decompresses blocks as they are read.
+ *
+ * Build on the host:   gcc -O2 -o mkfs mkfs.c lz4enc.c
+ * Usage:               ./mkfs [-z] [-i num_inodes] <dir> <image>
+ */
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "lz4enc.h"
+
+#define BLOCK_SIZE          4096
+#define NAME_LEN            32
+#define DENTRY_SIZE         64
+#define ROOT_MAX_DENTRIES   63
+#define BLOCKS_PER_INODE    1023
+#define DEFAULT_INODES      64      /* the kernel keeps a fixed inodes[64] */
+
+#define TYPE_RTC            0
+#define TYPE_DIR            1
+#define TYPE_FILE           2
+
+#define LZ4_MAGIC           0x345A4C46  /* "FLZ4", first reserved word of the boot block */
+#define ZMAP_ENTRY_SIZE     8           /* offset + length of a compressed block */
+
+typedef struct dentry {
+    char name[NAME_LEN];
+    uint32_t type;
+    uint32_t inode;
+    uint8_t reserved[24];
+} dentry_t;
+
+typedef struct node {
+    char name[NAME_LEN + 1];
+    uint32_t type;
+    uint32_t inode;
+    uint8_t *data;                  /* file contents, or packed dentries for a directory */
+    uint32_t size;
+    struct node **children;
+    int num_children;
+} node_t;
+
+static uint32_t num_inodes = DEFAULT_INODES;
+static uint32_t next_inode = 1;     /* inode 0 is left empty, "." uses it in the root */
+static uint32_t num_data_blocks = 0;
+
+static void die(const char *msg, const char *arg) {
+    fprintf(stderr, "mkfs: %s%s%s\n", msg, arg ? ": " : "", arg ? arg : "");
+    exit(1);
+}
+
+static uint8_t *read_file(const char *path, uint32_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        die("cannot open", path);
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = malloc(len ? len : 1);
+    if (len && fread(buf, 1, len, f) != (size_t)len)
+        die("cannot read", path);
+    fclose(f);
+    *size = len;
+    return buf;
+}
+
+static int cmp_nodes(const void *a, const void *b) {
+    return strcmp((*(node_t **)a)->name, (*(node_t **)b)->name);
+}
+
+static node_t *build_tree(const char *path, const char *name, int is_root) {
+    node_t *n = calloc(1, sizeof(node_t));
+    struct stat st;
+    strncpy(n->name, name, NAME_LEN);
+
+    if (stat(path, &st) != 0)
+        die("cannot stat", path);
+
+    if (!S_ISDIR(st.st_mode)) {
+        n->type = strcmp(name, "rtc") == 0 ? TYPE_RTC : TYPE_FILE;
+        if (n->type == TYPE_FILE) {
+            n->inode = next_inode++;
+            n->data = read_file(path, &n->size);
+        }
+        return n;
+    }
+
+    n->type = TYPE_DIR;
+    if (!is_root)
+        n->inode = next_inode++;
+
+    DIR *d = opendir(path);
+    struct dirent *de;
+    if (!d)
+        die("cannot open directory", path);
+    while ((de = readdir(d)) != NULL) {
+        char child[4096];
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        if (strlen(de->d_name) > NAME_LEN)
+            fprintf(stderr, "mkfs: warning: %s truncated to %d characters\n", de->d_name, NAME_LEN);
+        snprintf(child, sizeof(child), "%s/%s", path, de->d_name);
+        n->children = realloc(n->children, (n->num_children + 1) * sizeof(node_t *));
+        n->children[n->num_children++] = build_tree(child, de->d_name, 0);
+    }
+    closedir(d);
+    qsort(n->children, n->num_children, sizeof(node_t *), cmp_nodes);
+
+    if (!is_root) {
+        /* subdirectory contents are stored as file data */
+        int i;
+        n->size = n->num_children * DENTRY_SIZE;
+        n->data = calloc(1, n->size ? n->size : 1);
+        for (i = 0; i < n->num_children; i++) {
+            dentry_t *e = (dentry_t *)(n->data + i * DENTRY_SIZE);
+            memcpy(e->name, n->children[i]->name, strnlen(n->children[i]->name, NAME_LEN));
+            e->type = n->children[i]->type;
+            e->inode = n->children[i]->inode;
+        }
+    }
+    return n;
+}
+
+static void count_blocks(node_t *n) {
+    int i;
+    if (n->data) {
+        uint32_t blocks = (n->size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        if (blocks > BLOCKS_PER_INODE)
+            die("file too large", n->name);
+        num_data_blocks += blocks;
+    }
+    for (i = 0; i < n->num_children; i++)
+        count_blocks(n->children[i]);
+}
+
+/* writes the inode of `n` and its data blocks, then recurses */
+static void write_node(uint8_t *img, node_t *n, uint32_t *next_block) {
+    int i;
+    if (n->data) {
+        uint32_t *inode = (uint32_t *)(img + (1 + n->inode) * BLOCK_SIZE);
+        uint8_t *data_base = img + (1 + num_inodes) * BLOCK_SIZE;
+        uint32_t off;
+        inode[0] = n->size;
+        for (off = 0, i = 1; off < n->size; off += BLOCK_SIZE, i++) {
+            uint32_t len = n->size - off < BLOCK_SIZE ? n->size - off : BLOCK_SIZE;
+            inode[i] = *next_block;
+            memcpy(data_base + *next_block * BLOCK_SIZE, n->data + off, len);
+            (*next_block)++;
+        }
+    }
+    for (i = 0; i < n->num_children; i++)
+        write_node(img, n->children[i], next_block);
+}
+
+/*
+ * Replaces the data area of img (everything after the inodes) with the block
+ * map and the compressed blocks. Returns the new image size
+ */
+static size_t compress_image(uint8_t **img_p, size_t img_size) {
+    uint8_t *img = *img_p;
+    size_t header = (size_t)(1 + num_inodes) * BLOCK_SIZE;
+    size_t map_size = ((size_t)num_data_blocks * ZMAP_ENTRY_SIZE + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    uint8_t *out = calloc(1, header + map_size + (size_t)num_data_blocks * BLOCK_SIZE + BLOCK_SIZE);
+    uint32_t *map = (uint32_t *)(out + header);
+    uint8_t *zdata = out + header + map_size;
+    uint32_t off = 0;
+    uint32_t b;
+
+    memcpy(out, img, header);
+    ((uint32_t *)out)[3] = LZ4_MAGIC;
+    for (b = 0; b < num_data_blocks; b++) {
+        const uint8_t *block = img + header + (size_t)b * BLOCK_SIZE;
+        /* only worth it if it saves something, BLOCK_SIZE means stored as is */
+        int len = lz4_compress_block(block, BLOCK_SIZE, zdata + off, BLOCK_SIZE - 1);
+        if (len < 0) {
+            memcpy(zdata + off, block, BLOCK_SIZE);
+            len = BLOCK_SIZE;
+        }
+        map[2 * b] = off;
+        map[2 * b + 1] = len;
+        off += len;
+    }
+
+    free(img);
+    *img_p = out;
+    /* whole blocks, the kernel reads the image in 4KB units */
+    return header + map_size + (off + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+}
+
+int main(int argc, char **argv) {
+    int argi = 1;
+    int compress = 0;
+    int i;
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-z") == 0) {
+            compress = 1;
+            argi++;
+        } else if (strcmp(argv[argi], "-i") == 0 && argi + 1 < argc) {
+            num_inodes = atoi(argv[argi + 1]);
+            argi += 2;
+        } else {
+            break;
+        }
+    }
+    if (argc - argi != 2) {
+        fprintf(stderr, "usage: %s [-z] [-i num_inodes] <dir> <image>\n", argv[0]);
+        return 1;
+    }
+
+    node_t *root = build_tree(argv[argi], ".", 1);
+
+    /* createfs always adds the RTC device file, so do we */
+    for (i = 0; i < root->num_children && strcmp(root->children[i]->name, "rtc") != 0; i++)
+        ;
+    if (i == root->num_children) {
+        node_t *rtc = calloc(1, sizeof(node_t));
+        strcpy(rtc->name, "rtc");
+        rtc->type = TYPE_RTC;
+        root->children = realloc(root->children, (root->num_children + 1) * sizeof(node_t *));
+        root->children[root->num_children++] = rtc;
+    }
+    if (root->num_children + 1 > ROOT_MAX_DENTRIES)
+        die("too many entries in the root directory", NULL);
+    if (next_inode > num_inodes)
+        die("not enough inodes, use -i", NULL);
+    count_blocks(root);
+
+    size_t img_size = (size_t)(1 + num_inodes + num_data_blocks) * BLOCK_SIZE;
+    uint8_t *img = calloc(1, img_size);
+
+    /* boot block: counts, then "." and the root entries */
+    uint32_t *stats = (uint32_t *)img;
+    dentry_t *entries = (dentry_t *)(img + DENTRY_SIZE);
+    stats[0] = root->num_children + 1;
+    stats[1] = num_inodes;
+    stats[2] = num_data_blocks;
+    strcpy(entries[0].name, ".");
+    entries[0].type = TYPE_DIR;
+    entries[0].inode = 0;
+    for (i = 0; i < root->num_children; i++) {
+        memcpy(entries[i + 1].name, root->children[i]->name, strnlen(root->children[i]->name, NAME_LEN));
+        entries[i + 1].type = root->children[i]->type;
+        entries[i + 1].inode = root->children[i]->inode;
+    }
+
+    uint32_t next_block = 0;
+    write_node(img, root, &next_block);
+    size_t raw_size = img_size;
+    if (compress)
+        img_size = compress_image(&img, img_size);
+
+    FILE *out = fopen(argv[argi + 1], "wb");
+    if (!out || fwrite(img, 1, img_size, out) != img_size)
+        die("cannot write", argv[argi + 1]);
+    fclose(out);
+    printf("%s: %u entries in /, %u inodes used of %u, %u data blocks\n",
+           argv[argi + 1], root->num_children + 1, next_inode - 1, num_inodes, num_data_blocks);
+    if (compress)
+        printf("%s: compressed to %zu bytes from %zu (%.1f%%)\n",
+               argv[argi + 1], img_size, raw_size, 100.0 * img_size / raw_size);
+    return 0;
+}
@@ -4,6 +4,9 @@
 #include "tests.h"
 #include "task.h"
 #include "terminal.h"
+#include "errno.h"
+#include "mm/uaccess.h"
+#include "wait.h"
 
 // RTC is IRQ8, irq vector 0x28
 // info from https://wiki.osdev.org/RTC
@@ -14,67 +17,123 @@
 #define RTC_REG_B 0x8B
 #define RTC_REG_C 0x8C
 
-#define HIGH_RTC_RATE 1024
+#define RTC_REG_B_PIE 0x40 // periodic interrupt enable
+
+// fastest rate a file can ask for, and so the fastest the hardware runs
+#define RTC_MAX_RATE 1024
+#define RTC_MAX_LOG2 10
+#define RTC_DEFAULT_RATE 2
 #define RTC_X 70
 #define RTC_Y 1
 
 uint8_t is_running;
-uint32_t current_RTC_rate = 2;
 
-void init_RTC()
+// open rtc files at each rate, indexed by log2 of the rate. The hardware runs
+// at the highest rate anyone has, and not at all without readers
+static uint32_t rtc_rate_users[RTC_MAX_LOG2 + 1];
+static uint32_t rtc_hw_rate;
+
+// time in 1 / RTC_MAX_RATE seconds, each interrupt moves it one hardware period
+static volatile uint32_t rtc_time;
+static wait_queue_t rtc_wait;
+
+int is_power_of_two(uint32_t rate)
 {
+  int ret = 0;
+  while (rate != 1)
+  {
+    if (rate % 2 != 0)
+    {
+      return -1;
+    }
+    rate >>= 1;
+    ret++;
+  }
+  return ret;
+}
 
+// turns the periodic interrupt on or off in register B
+static void rtc_set_periodic(int on)
+{
   outb(RTC_REG_B, RTC_IO_PORT); // register B, disable NMI
   uint8_t prev = inb(CMOS_IO_PORT);
   outb(RTC_REG_B, RTC_IO_PORT); // have to do this again cuz of the read, resets read to register D
-  outb(prev | 0x40, CMOS_IO_PORT);
+  outb(on ? (prev | RTC_REG_B_PIE) : (prev & ~RTC_REG_B_PIE), CMOS_IO_PORT);
+  if (on)
+  {
+    // an interrupt that was flagged while it was off would hold the line
+    outb(RTC_REG_C, RTC_IO_PORT);
+    inb(CMOS_IO_PORT);
+  }
+}
+
+// picks the hardware rate after a file opened, closed or changed its rate.
+// The ports are only touched when the rate actually changes
+static void rtc_update_rate()
+{
+  uint32_t flags;
+  int32_t i;
+  cli_and_save(flags);
+  for (i = RTC_MAX_LOG2; i > 0 && !rtc_rate_users[i]; i--)
+    ;
+  uint32_t rate = i > 0 ? 1 << i : 0;
+  if (rate != rtc_hw_rate)
+  {
+    if (!rate)
+    {
+      disable_irq(RTC_IRQ_NUM);
+      rtc_set_periodic(0);
+    }
+    else
+    {
+      set_RTC_rate(rate);
+      if (!rtc_hw_rate)
+      {
+        rtc_set_periodic(1);
+        enable_irq(RTC_IRQ_NUM);
+      }
+    }
+    rtc_hw_rate = rate;
+  }
+  restore_flags(flags);
+}
 
-  enable_irq(RTC_IRQ_NUM);
+void init_RTC()
+{
+  // nobody has it open yet, so no interrupts until somebody does
+  wait_queue_init(&rtc_wait);
+  rtc_set_periodic(0);
+  disable_irq(RTC_IRQ_NUM);
 }
 
 /*
 The RTC interrupt rate should be set to a default value of
 2 Hz (2 interrupts per second) when the RTC device is opened.
-For simplicity, RTC interrupts should remain on at all times.
+Every open file has its own rate (in private_data), reads wait for the
+next tick at that rate.
 */
-int32_t open_RTC(const uint8_t *filename)
+int32_t open_RTC(inode_t *inode, file_t *file)
 {
-  // just call init_RTC()
-
-  // set RTC to highest possible rate
-  // On most machines however, the RTC interrupt rate can not go higher than 8 kHz.
-  set_RTC_rate(HIGH_RTC_RATE);
-  current_RTC_rate = 2;
-  init_RTC();
+  file->private_data = (void *)RTC_DEFAULT_RATE;
+  rtc_rate_users[is_power_of_two(RTC_DEFAULT_RATE)]++;
+  rtc_update_rate();
   return 0;
 }
 
 /*
 For the real-time clock (RTC), this call should always return 0, but only after an interrupt has
-occurred (set a flag and wait until the interrupt handler clears it, then return 0).
+occurred at the file's rate. Sleeps until then instead of spinning.
 */
-int32_t read_RTC(int32_t fd, void *buf, int32_t nbytes)
+int32_t read_RTC(file_t *file, void *buf, int32_t nbytes)
 {
-  the_flag = 1;
-  while (the_flag == 1)
-  {
-    // do nothing
-  }
-  return 0;
-}
-
-int is_power_of_two(uint32_t rate)
-{
-  int ret = 0;
-  while (rate != 1)
-  {
-    if (rate % 2 != 0)
-    {
-      return -1;
-    }
-    rate >>= 1;
-    ret++;
-  }
+  uint32_t period = RTC_MAX_RATE / (uint32_t)file->private_data;
+  uint32_t flags, deadline;
+  int32_t ret;
+  cli_and_save(flags);
+  // the next multiple of the period, like a clock ticking at the file's rate
+  deadline = (rtc_time / period + 1) * period;
+  wait_event(&rtc_wait, (int32_t)(rtc_time - deadline) >= 0, ret);
+  restore_flags(flags);
   return ret;
 }
 
@@ -83,7 +142,7 @@ In the case of the RTC, the system call should always accept only a 4-byte
 integer specifying the interrupt rate in Hz,
 and should set the rate of periodic interrupts accordingly.
 */
-int32_t write_RTC(int32_t fd, const void *buf, int32_t nbytes)
+int32_t write_RTC(file_t *file, const void *buf, int32_t nbytes)
 {
 
   // int ret = set_RTC_rate(*((uint32_t *)buf));
@@ -91,23 +150,48 @@ int32_t write_RTC(int32_t fd, const void *buf, int32_t nbytes)
   // {
   //   return -1;
   // }
-  uint32_t val = *((uint32_t *)buf);
-  if (is_power_of_two(val) == -1 || val < 2 || val > 32768)
+  uint32_t val;
+  if (nbytes != sizeof(uint32_t))
   {
     return -1;
   }
-  current_RTC_rate = val;
+  if (__copy_from_user(&val, buf, sizeof(uint32_t)))
+  {
+    return -EFAULT;
+  }
+  if (val < 2 || val > RTC_MAX_RATE || is_power_of_two(val) == -1)
+  {
+    return -1;
+  }
+  uint32_t flags;
+  cli_and_save(flags);
+  rtc_rate_users[is_power_of_two((uint32_t)file->private_data)]--;
+  rtc_rate_users[is_power_of_two(val)]++;
+  file->private_data = (void *)val;
+  restore_flags(flags);
+  rtc_update_rate();
 
   return nbytes;
 }
 
-int32_t close_RTC(int32_t fd)
+int32_t close_RTC(inode_t *inode, file_t *file)
 {
-  // just reset RTC frequency
-  current_RTC_rate = 2;
+  // the last fd of this open went away, it doesn't keep the RTC going anymore
+  uint32_t flags;
+  cli_and_save(flags);
+  rtc_rate_users[is_power_of_two((uint32_t)file->private_data)]--;
+  restore_flags(flags);
+  rtc_update_rate();
   return 0;
 }
 
+file_operations_t rtc_fops = {
+    .open = open_RTC,
+    .release = close_RTC,
+    .read = read_RTC,
+    .write = write_RTC,
+};
+
 // make this return a value so we know when we entered invalid frequency
 int set_RTC_rate(uint32_t rate_num)
 {
@@ -115,19 +199,19 @@ int set_RTC_rate(uint32_t rate_num)
   // the formula is frequency =  32768 >> (rate-1);
   // 15 -> 2Hz, 14 -> 4Hz, etc. 1-> 32768 Hz
 
-  cli();
   int power_of_two = is_power_of_two(rate_num);
-  if (rate_num < 2 || rate_num > 1024 || !power_of_two)
+  if (rate_num < 2 || rate_num > RTC_MAX_RATE || power_of_two <= 0)
   {
     return -1;
   }
+  uint32_t flags;
+  cli_and_save(flags);
   rate_num = (16 - power_of_two);
   outb(RTC_REG_A, RTC_IO_PORT); // select register A, disable NMI
   uint8_t prev = inb(CMOS_IO_PORT);
   outb(RTC_REG_A, RTC_IO_PORT);
   outb((prev & 0xF0) | rate_num, CMOS_IO_PORT);
-
-  sti();
+  restore_flags(flags);
   return 0;
 }
 
@@ -173,24 +257,24 @@ int set_RTC_rate(uint32_t rate_num)
 // function should call test_interrupts every time it receives an interrupt
 void RTC_interrupt_handler()
 {
-  cli();
   send_eoi(RTC_IRQ_NUM);
 
   rtc_test_counter++;
-  // extra *2 because its rate-1
-  if (rtc_test_counter % (HIGH_RTC_RATE / (current_RTC_rate * 2)) == 0 && rtc_test_counter != 0)
+  if (rtc_hw_rate)
   {
-    rtc_virtual_counter++;
-    // clear the flag for read_RTC()
-    the_flag = 0;
+    rtc_time += RTC_MAX_RATE / rtc_hw_rate;
+  }
+  // readers check their own deadline
+  if (rtc_wait.head)
+  {
+    wake_up(&rtc_wait);
   }
 
   // write_RTC_data();
 
+  // register C has to be read or the RTC won't interrupt again
   outb(0x0C, RTC_IO_PORT);
   inb(CMOS_IO_PORT);
-
-  sti();
 }
 
 void toggle_run()
@@ -2,20 +2,20 @@
 #define RTC_H
 
 #include "types.h"
+#include "fs/vfs.h"
 
 void init_RTC();
 int set_RTC_rate(uint32_t rate_num);
 void RTC_interrupt_handler();
 void toggle_run();
 
-// for the syscalls
-int32_t open_RTC(const uint8_t* filename);
-int32_t read_RTC(int32_t fd, void* buf, int32_t nbytes);
-int32_t write_RTC(int32_t fd, const void* buf, int32_t nbytes);
-int32_t close_RTC(int32_t fd);
+// for the syscalls, registered as the "rtc" character device
+int32_t open_RTC(inode_t* inode, file_t* file);
+int32_t read_RTC(file_t* file, void* buf, int32_t nbytes);
+int32_t write_RTC(file_t* file, const void* buf, int32_t nbytes);
+int32_t close_RTC(inode_t* inode, file_t* file);
 
-volatile uint8_t the_flag;
-extern uint32_t current_RTC_rate;
+extern file_operations_t rtc_fops;
 
 
 #endif
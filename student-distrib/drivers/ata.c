@@ -0,0 +1,334 @@
+#include "ata.h"
+#include "block.h"
+#include "../lib.h"
+#include "../i8259.h"
+#include "../errno.h"
+#include "../wait.h"
+#include "../irqstat.h"
+#include "../scheduler.h"
+
+// PCI configuration space access ports
+#define PCI_CONFIG_ADDRESS 	0xCF8
+#define PCI_CONFIG_DATA 	0xCFC
+#define PCI_CLASS_STORAGE 	0x01
+#define PCI_SUBCLASS_IDE 	0x01
+#define PCI_COMMAND_IO 		0x1
+#define PCI_COMMAND_MASTER 	0x4
+
+// how many status polls before we give up on the drive
+#define ATA_TIMEOUT 		1000000
+// how long a DMA command gets before we give up, in PIT ticks (100 Hz)
+#define ATA_DMA_TIMEOUT_TICKS 	200
+#define PIT_TICKS 			irq_count[ICW2_MASTER + TIMER_IRQ_NUM]
+
+static blkdev_t hda;
+
+// base port of the bus master registers, 0 if we couldn't find a controller (PIO only)
+static uint16_t bm_base = 0;
+
+// PRD table has to be dword aligned and must not cross a 64KB boundary
+static ata_prd_t prdt[ATA_PRDT_ENTRIES] __attribute__((aligned(128)));
+
+// set by the interrupt handler once the drive raises IRQ 14
+static volatile int ata_irq_fired = 0;
+static volatile uint8_t ata_bm_status = 0;
+
+// the task waiting for a DMA command sleeps here until the IRQ or the deadline
+static wait_queue_t ata_wait;
+static volatile int ata_waiting = 0;
+static uint32_t ata_deadline;
+
+static uint32_t pci_config_read(uint8_t bus, uint8_t dev, uint8_t func, uint8_t offset) {
+  uint32_t addr = 0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (offset & 0xFC);
+  outl(addr, PCI_CONFIG_ADDRESS);
+  return inl(PCI_CONFIG_DATA);
+}
+
+static void pci_config_write(uint8_t bus, uint8_t dev, uint8_t func, uint8_t offset, uint32_t val) {
+  uint32_t addr = 0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | (offset & 0xFC);
+  outl(addr, PCI_CONFIG_ADDRESS);
+  outl(val, PCI_CONFIG_DATA);
+}
+
+/**
+ * @brief Walks PCI bus 0 looking for an IDE controller with bus mastering
+ * capability, and turns bus mastering on for it
+ *
+ * @return uint16_t I/O base of the bus master registers, or 0 if none found
+ */
+static uint16_t ata_find_bus_master() {
+  int dev, func;
+  for (dev = 0; dev < 32; dev++) {
+    for (func = 0; func < 8; func++) {
+      uint32_t id = pci_config_read(0, dev, func, 0x0);
+      if ((id & 0xFFFF) == 0xFFFF) {
+        continue;
+      }
+      uint32_t class = pci_config_read(0, dev, func, 0x8);
+      if (((class >> 24) & 0xFF) != PCI_CLASS_STORAGE || ((class >> 16) & 0xFF) != PCI_SUBCLASS_IDE) {
+        continue;
+      }
+      // bit 7 of prog-if says whether the controller can bus master
+      if (!(class & 0x8000)) {
+        continue;
+      }
+      uint32_t bar4 = pci_config_read(0, dev, func, 0x20);
+      if (!(bar4 & 0x1)) {
+        continue; // we only know how to talk to it through I/O space
+      }
+      uint32_t cmd = pci_config_read(0, dev, func, 0x4);
+      pci_config_write(0, dev, func, 0x4, cmd | PCI_COMMAND_IO | PCI_COMMAND_MASTER);
+      return bar4 & 0xFFFC;
+    }
+  }
+  return 0;
+}
+
+// reading the alternate status register 4 times gives the drive the 400ns it needs
+static void ata_delay() {
+  inb(ATA_PRIMARY_CTRL);
+  inb(ATA_PRIMARY_CTRL);
+  inb(ATA_PRIMARY_CTRL);
+  inb(ATA_PRIMARY_CTRL);
+}
+
+static int ata_wait_not_busy() {
+  int i;
+  for (i = 0; i < ATA_TIMEOUT; i++) {
+    uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    if (!(status & ATA_SR_BSY)) {
+      return (status & (ATA_SR_ERR | ATA_SR_DF)) ? -EIO : 0;
+    }
+  }
+  return -ETIMEDOUT;
+}
+
+static int ata_wait_drq() {
+  int i;
+  for (i = 0; i < ATA_TIMEOUT; i++) {
+    uint8_t status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+    if (status & (ATA_SR_ERR | ATA_SR_DF)) {
+      return -EIO;
+    }
+    if (!(status & ATA_SR_BSY) && (status & ATA_SR_DRQ)) {
+      return 0;
+    }
+  }
+  return -ETIMEDOUT;
+}
+
+/**
+ * @brief Selects the master drive and programs the LBA28 address + count.
+ * A count of 0 means 256 sectors to the drive, but we never send more than
+ * ATA_MAX_SECTORS
+ */
+static int ata_setup_lba(uint32_t lba, uint32_t count) {
+  int ret = ata_wait_not_busy();
+  if (ret < 0) {
+    return ret;
+  }
+  outb(0xE0 | ((lba >> 24) & 0x0F), ATA_PRIMARY_IO + ATA_REG_HDDEVSEL);
+  ata_delay();
+  outb(count & 0xFF, ATA_PRIMARY_IO + ATA_REG_SECCOUNT);
+  outb(lba & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA0);
+  outb((lba >> 8) & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA1);
+  outb((lba >> 16) & 0xFF, ATA_PRIMARY_IO + ATA_REG_LBA2);
+  return 0;
+}
+
+/**
+ * @brief Polled PIO transfer, one sector at a time through the data port
+ */
+static int ata_pio_xfer(uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf, int is_write) {
+  int ret = ata_setup_lba(lba, count);
+  if (ret < 0) {
+    return ret;
+  }
+  outb(is_write ? ATA_CMD_WRITE_PIO : ATA_CMD_READ_PIO, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+
+  uint32_t i;
+  for (i = 0; i < count; i++) {
+    uint8_t *sector = bufs[i / sectors_per_buf] + (i % sectors_per_buf) * BLKDEV_SECTOR_SIZE;
+    ata_delay();
+    ret = ata_wait_drq();
+    if (ret < 0) {
+      return ret;
+    }
+    if (is_write) {
+      asm volatile ("rep outsw" : "+S"(sector) : "c"(BLKDEV_SECTOR_SIZE / 2), "d"(ATA_PRIMARY_IO) : "memory");
+    }
+    else {
+      asm volatile ("rep insw" : "+D"(sector) : "c"(BLKDEV_SECTOR_SIZE / 2), "d"(ATA_PRIMARY_IO) : "memory");
+    }
+  }
+
+  if (is_write) {
+    outb(ATA_CMD_CACHE_FLUSH, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+    return ata_wait_not_busy();
+  }
+  return 0;
+}
+
+/**
+ * @brief Clears the interrupt on the controller and on the drive, and keeps
+ * the bus master status for ata_dma_xfer to check
+ */
+static void ata_interrupt_ack() {
+  if (bm_base) {
+    ata_bm_status = inb(bm_base + ATA_BM_STATUS);
+    // write 1 to clear the interrupt bit
+    outb(ATA_BM_SR_IRQ, bm_base + ATA_BM_STATUS);
+  }
+  // reading the status register acknowledges the interrupt on the drive side
+  inb(ATA_PRIMARY_IO + ATA_REG_STATUS);
+}
+
+/**
+ * @brief Bus master DMA transfer. Every buffer becomes one PRD entry, so a
+ * read ahead of several cache blocks is still a single command and a single
+ * interrupt. Buffers are kernel memory, which is identity mapped, so the
+ * virtual address is also the physical address
+ */
+static int ata_dma_xfer(uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf, int is_write) {
+  uint32_t nbufs = (count + sectors_per_buf - 1) / sectors_per_buf;
+  uint32_t i;
+  if (nbufs > ATA_PRDT_ENTRIES || sectors_per_buf * BLKDEV_SECTOR_SIZE > 0x10000) {
+    return ata_pio_xfer(lba, count, bufs, sectors_per_buf, is_write);
+  }
+
+  uint32_t left = count;
+  for (i = 0; i < nbufs; i++) {
+    uint32_t n = left < sectors_per_buf ? left : sectors_per_buf;
+    prdt[i].addr = (uint32_t)bufs[i];
+    prdt[i].size = (n * BLKDEV_SECTOR_SIZE) & 0xFFFF;
+    prdt[i].flags = (i == nbufs - 1) ? ATA_PRD_EOT : 0;
+    left -= n;
+  }
+
+  // stop the engine, point it at the table, clear the error + irq bits (write 1 to clear)
+  outb(0, bm_base + ATA_BM_COMMAND);
+  outl((uint32_t)prdt, bm_base + ATA_BM_PRDT);
+  outb(ATA_BM_SR_ERR | ATA_BM_SR_IRQ, bm_base + ATA_BM_STATUS);
+  outb(is_write ? 0 : ATA_BM_CMD_READ, bm_base + ATA_BM_COMMAND);
+
+  int ret = ata_setup_lba(lba, count);
+  if (ret < 0) {
+    return ret;
+  }
+
+  uint32_t flags;
+  cli_and_save(flags);
+  ata_irq_fired = 0;
+  outb(is_write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+  outb((is_write ? 0 : ATA_BM_CMD_READ) | ATA_BM_CMD_START, bm_base + ATA_BM_COMMAND);
+
+  if (scheduling_on_flag) {
+    // sleep until the handler or ata_timer_tick wakes us. A signal can't cut
+    // this short, the drive is still writing into the buffers
+    ata_deadline = PIT_TICKS + ATA_DMA_TIMEOUT_TICKS;
+    ata_waiting = 1;
+    while (!ata_irq_fired && (int32_t)(PIT_TICKS - ata_deadline) < 0) {
+      wait_queue_sleep(&ata_wait);
+    }
+    ata_waiting = 0;
+  }
+  else {
+    // mounting at boot, before there's a task to sleep or a timer tick. Poll
+    // the bus master for the interrupt bit instead, each inb is an ISA cycle
+    for (i = 0; i < ATA_TIMEOUT && !ata_irq_fired; i++) {
+      if (inb(bm_base + ATA_BM_STATUS) & ATA_BM_SR_IRQ) {
+        ata_interrupt_ack();
+        ata_irq_fired = 1;
+      }
+    }
+  }
+
+  outb(0, bm_base + ATA_BM_COMMAND);
+  restore_flags(flags);
+  if (!ata_irq_fired) {
+    return -ETIMEDOUT;
+  }
+  if ((ata_bm_status & ATA_BM_SR_ERR) || (inb(ATA_PRIMARY_IO + ATA_REG_STATUS) & (ATA_SR_ERR | ATA_SR_DF))) {
+    return -EIO;
+  }
+  return 0;
+}
+
+static int ata_read(blkdev_t *dev, uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf) {
+  if (bm_base) {
+    return ata_dma_xfer(lba, count, bufs, sectors_per_buf, 0);
+  }
+  return ata_pio_xfer(lba, count, bufs, sectors_per_buf, 0);
+}
+
+static int ata_write(blkdev_t *dev, uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf) {
+  if (bm_base) {
+    return ata_dma_xfer(lba, count, bufs, sectors_per_buf, 1);
+  }
+  return ata_pio_xfer(lba, count, bufs, sectors_per_buf, 1);
+}
+
+int ata_init() {
+  uint16_t identify[256];
+  int i;
+
+  // floating bus means there is nothing on the channel
+  if (inb(ATA_PRIMARY_IO + ATA_REG_STATUS) == 0xFF) {
+    return -ENODEV;
+  }
+
+  outb(0xA0, ATA_PRIMARY_IO + ATA_REG_HDDEVSEL);
+  ata_delay();
+  outb(0, ATA_PRIMARY_IO + ATA_REG_SECCOUNT);
+  outb(0, ATA_PRIMARY_IO + ATA_REG_LBA0);
+  outb(0, ATA_PRIMARY_IO + ATA_REG_LBA1);
+  outb(0, ATA_PRIMARY_IO + ATA_REG_LBA2);
+  outb(ATA_CMD_IDENTIFY, ATA_PRIMARY_IO + ATA_REG_COMMAND);
+  if (inb(ATA_PRIMARY_IO + ATA_REG_STATUS) == 0) {
+    return -ENODEV;
+  }
+  if (ata_wait_not_busy() < 0) {
+    return -ENODEV;
+  }
+  // ATAPI and SATA devices set these to a signature instead of aborting cleanly
+  if (inb(ATA_PRIMARY_IO + ATA_REG_LBA1) || inb(ATA_PRIMARY_IO + ATA_REG_LBA2)) {
+    return -ENODEV;
+  }
+  if (ata_wait_drq() < 0) {
+    return -ENODEV;
+  }
+  for (i = 0; i < 256; i++) {
+    identify[i] = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
+  }
+
+  strcpy((int8_t *)hda.name, (int8_t *)"hda");
+  // words 60-61 hold the number of LBA28 addressable sectors
+  hda.num_sectors = identify[60] | ((uint32_t)identify[61] << 16);
+  hda.max_sectors = ATA_MAX_SECTORS;
+  hda.read = ata_read;
+  hda.write = ata_write;
+  hda.private_data = NULL;
+
+  bm_base = ata_find_bus_master();
+  wait_queue_init(&ata_wait);
+
+  // nIEN = 0 so the drive actually raises IRQ 14
+  outb(0, ATA_PRIMARY_CTRL);
+  enable_irq(ATA_PRIMARY_IRQ);
+
+  printf("hda: %d sectors, %s\n", hda.num_sectors, bm_base ? "DMA" : "PIO");
+  return blkdev_register(&hda);
+}
+
+void ata_timer_tick() {
+  if (ata_waiting && (int32_t)(PIT_TICKS - ata_deadline) >= 0) {
+    wake_up(&ata_wait);
+  }
+}
+
+void ata_interrupt_handler() {
+  ata_interrupt_ack();
+  ata_irq_fired = 1;
+  wake_up(&ata_wait);
+  send_eoi(ATA_PRIMARY_IRQ);
+}
@@ -0,0 +1,87 @@
+/**
+ * @file ata.h
+ * @brief Driver for the primary ATA (IDE) channel. Uses bus master DMA when a
+ * PCI IDE controller is found, and falls back to polled PIO otherwise. The
+ * master drive gets registered as block device "hda".
+ */
+#ifndef ATA_H
+#define ATA_H
+
+#include "../types.h"
+
+// primary channel I/O ports
+#define ATA_PRIMARY_IO 			0x1F0
+#define ATA_PRIMARY_CTRL 		0x3F6
+#define ATA_PRIMARY_IRQ 		14
+
+// offsets from ATA_PRIMARY_IO
+#define ATA_REG_DATA 			0
+#define ATA_REG_ERROR 			1
+#define ATA_REG_SECCOUNT 		2
+#define ATA_REG_LBA0 			3
+#define ATA_REG_LBA1 			4
+#define ATA_REG_LBA2 			5
+#define ATA_REG_HDDEVSEL 		6
+#define ATA_REG_COMMAND 		7
+#define ATA_REG_STATUS 			7
+
+// status register bits
+#define ATA_SR_ERR 				0x01
+#define ATA_SR_DRQ 				0x08
+#define ATA_SR_DF 				0x20
+#define ATA_SR_DRDY 			0x40
+#define ATA_SR_BSY 				0x80
+
+// commands
+#define ATA_CMD_READ_PIO 		0x20
+#define ATA_CMD_WRITE_PIO 		0x30
+#define ATA_CMD_READ_DMA 		0xC8
+#define ATA_CMD_WRITE_DMA 		0xCA
+#define ATA_CMD_CACHE_FLUSH 	0xE7
+#define ATA_CMD_IDENTIFY 		0xEC
+
+// bus master IDE registers (offsets from BAR4)
+#define ATA_BM_COMMAND 			0
+#define ATA_BM_STATUS 			2
+#define ATA_BM_PRDT 			4
+
+#define ATA_BM_CMD_START 		0x01
+#define ATA_BM_CMD_READ 		0x08	///< direction bit: device to memory
+#define ATA_BM_SR_ERR 			0x02
+#define ATA_BM_SR_IRQ 			0x04
+
+#define ATA_PRD_EOT 			0x8000	///< marks the last entry of the PRD table
+#define ATA_PRDT_ENTRIES 		16
+
+// LBA28 sector count register is 8 bits, and we also cap at one PRD per buffer
+#define ATA_MAX_SECTORS 		128
+
+/**
+ *	Physical region descriptor used by bus master DMA. Each one describes a
+ *	physically contiguous buffer that must not cross a 64KB boundary
+ */
+typedef struct s_ata_prd {
+	uint32_t addr;		///< physical address of the buffer
+	uint16_t size;		///< byte count (0 means 64KB)
+	uint16_t flags;		///< ATA_PRD_EOT on the last entry
+} __attribute__((packed)) ata_prd_t;
+
+/**
+ * @brief Probes the primary master drive and registers it as "hda" if present.
+ * Must be called after the PIC is set up, since it unmasks IRQ 14
+ *
+ * @return int 0 on success, -ENODEV if there is no drive
+ */
+int ata_init();
+
+/**
+ * @brief Called on every PIT tick, wakes a DMA waiter whose deadline passed
+ */
+void ata_timer_tick();
+
+/**
+ * @brief IRQ 14 handler, called from ata_handler_wrapper
+ */
+void ata_interrupt_handler();
+
+#endif
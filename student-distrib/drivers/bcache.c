@@ -0,0 +1,265 @@
+#include "bcache.h"
+#include "../lib.h"
+#include "../errno.h"
+#include "../mm/uaccess.h"
+
+bcache_stats_t bcache_stats;
+
+// the pool lives in the kernel's identity mapped memory, so the buffers can be
+// handed straight to the DMA engine. Page alignment also keeps every buffer
+// inside a single 64KB DMA boundary
+static uint8_t bcache_data[BCACHE_NUM_BUFS][BCACHE_BLOCK_SIZE] __attribute__((aligned(BCACHE_BLOCK_SIZE)));
+static bcache_buf_t bcache_bufs[BCACHE_NUM_BUFS];
+static bcache_buf_t *bcache_hash[BCACHE_HASH_SIZE];
+
+// LRU list, head is the most recently used buffer
+static bcache_buf_t *lru_head = NULL;
+static bcache_buf_t *lru_tail = NULL;
+
+// last block each device was asked for, used to detect sequential access
+static uint32_t last_block[BLKDEV_MAX];
+
+static uint32_t bcache_hashfn(blkdev_t *dev, uint32_t block) {
+  return (block ^ (dev->id * 0x9E3779B1)) % BCACHE_HASH_SIZE;
+}
+
+static bcache_buf_t *bcache_lookup(blkdev_t *dev, uint32_t block) {
+  bcache_buf_t *buf;
+  for (buf = bcache_hash[bcache_hashfn(dev, block)]; buf; buf = buf->hash_next) {
+    if (buf->dev == dev && buf->block == block) {
+      return buf;
+    }
+  }
+  return NULL;
+}
+
+static void bcache_hash_remove(bcache_buf_t *buf) {
+  bcache_buf_t **p = &bcache_hash[bcache_hashfn(buf->dev, buf->block)];
+  while (*p) {
+    if (*p == buf) {
+      *p = buf->hash_next;
+      break;
+    }
+    p = &(*p)->hash_next;
+  }
+  buf->hash_next = NULL;
+}
+
+static void bcache_hash_insert(bcache_buf_t *buf) {
+  uint32_t h = bcache_hashfn(buf->dev, buf->block);
+  buf->hash_next = bcache_hash[h];
+  bcache_hash[h] = buf;
+}
+
+static void lru_unlink(bcache_buf_t *buf) {
+  if (buf->lru_prev) buf->lru_prev->lru_next = buf->lru_next;
+  else lru_head = buf->lru_next;
+  if (buf->lru_next) buf->lru_next->lru_prev = buf->lru_prev;
+  else lru_tail = buf->lru_prev;
+  buf->lru_prev = buf->lru_next = NULL;
+}
+
+static void lru_push_front(bcache_buf_t *buf) {
+  buf->lru_prev = NULL;
+  buf->lru_next = lru_head;
+  if (lru_head) lru_head->lru_prev = buf;
+  lru_head = buf;
+  if (!lru_tail) lru_tail = buf;
+}
+
+static int bcache_writeback(bcache_buf_t *buf) {
+  int ret = blkdev_write(buf->dev, buf->block * BCACHE_SECTORS_PER_BLOCK, BCACHE_SECTORS_PER_BLOCK,
+                         &buf->data, BCACHE_SECTORS_PER_BLOCK);
+  if (ret == 0) {
+    buf->flags &= ~BCACHE_DIRTY;
+    bcache_stats.writebacks++;
+  }
+  return ret;
+}
+
+/**
+ * @brief Takes the least recently used unpinned buffer (writing it back if
+ * dirty) and renames it to (dev, block). The returned buffer is pinned
+ */
+static bcache_buf_t *bcache_get_victim(blkdev_t *dev, uint32_t block) {
+  bcache_buf_t *buf;
+  for (buf = lru_tail; buf; buf = buf->lru_prev) {
+    if (buf->refcount == 0) {
+      break;
+    }
+  }
+  if (!buf) {
+    return NULL;
+  }
+  if ((buf->flags & BCACHE_DIRTY) && bcache_writeback(buf) < 0) {
+    return NULL;
+  }
+  if (buf->dev) {
+    bcache_hash_remove(buf);
+    if (buf->flags & BCACHE_VALID) {
+      bcache_stats.evictions++;
+    }
+  }
+  buf->dev = dev;
+  buf->block = block;
+  buf->flags = 0;
+  buf->refcount = 1;
+  bcache_hash_insert(buf);
+  lru_unlink(buf);
+  lru_push_front(buf);
+  return buf;
+}
+
+/**
+ * @brief Brings in up to `max` consecutive uncached blocks starting at `start`
+ * with a single device request. The blocks are left unpinned and flagged as
+ * read-ahead, except the first one when `demand` is set: the caller wants
+ * that one, so it stays pinned for the caller to return with bcache_release
+ *
+ * @return int number of blocks read, or the negative of an errno
+ */
+static int bcache_load(blkdev_t *dev, uint32_t start, uint32_t max, int demand) {
+  bcache_buf_t *bufs[1 + BCACHE_READAHEAD];
+  uint8_t *datas[1 + BCACHE_READAHEAD];
+  uint32_t dev_blocks = dev->num_sectors / BCACHE_SECTORS_PER_BLOCK;
+  uint32_t n = 0;
+  int ret, i;
+
+  while (n < max && start + n < dev_blocks && !bcache_lookup(dev, start + n)) {
+    bufs[n] = bcache_get_victim(dev, start + n);
+    if (!bufs[n]) {
+      break;
+    }
+    datas[n] = bufs[n]->data;
+    n++;
+  }
+  if (n == 0) {
+    return 0;
+  }
+
+  ret = blkdev_read(dev, start * BCACHE_SECTORS_PER_BLOCK, n * BCACHE_SECTORS_PER_BLOCK,
+                    datas, BCACHE_SECTORS_PER_BLOCK);
+
+  for (i = 0; i < n; i++) {
+    if (ret < 0 || i > 0 || !demand) {
+      bufs[i]->refcount--;
+    }
+    if (ret < 0) {
+      // forget them so the next lookup goes back to the device
+      bcache_hash_remove(bufs[i]);
+      bufs[i]->dev = NULL;
+      bufs[i]->flags = 0;
+      continue;
+    }
+    bufs[i]->flags = BCACHE_VALID;
+    if (i > 0 || !demand) {
+      bufs[i]->flags |= BCACHE_READAHEAD_BUF;
+      bcache_stats.readahead++;
+    }
+  }
+  return ret < 0 ? ret : n;
+}
+
+void bcache_init() {
+  int i;
+  memset(&bcache_stats, 0, sizeof(bcache_stats));
+  memset(bcache_hash, 0, sizeof(bcache_hash));
+  lru_head = lru_tail = NULL;
+  for (i = 0; i < BCACHE_NUM_BUFS; i++) {
+    bcache_bufs[i].dev = NULL;
+    bcache_bufs[i].block = 0;
+    bcache_bufs[i].flags = 0;
+    bcache_bufs[i].refcount = 0;
+    bcache_bufs[i].data = bcache_data[i];
+    bcache_bufs[i].hash_next = NULL;
+    lru_push_front(&bcache_bufs[i]);
+  }
+  for (i = 0; i < BLKDEV_MAX; i++) {
+    last_block[i] = 0xFFFFFFFF;
+  }
+}
+
+bcache_buf_t *bcache_read(blkdev_t *dev, uint32_t block) {
+  int sequential = (block == last_block[dev->id] + 1);
+  last_block[dev->id] = block;
+
+  bcache_buf_t *buf = bcache_lookup(dev, block);
+  if (buf) {
+    bcache_stats.hits++;
+    // pinned and at the hot end before the read-ahead below goes looking
+    // for victims, or it could recycle this very buffer
+    buf->refcount++;
+    lru_unlink(buf);
+    lru_push_front(buf);
+    if (buf->flags & BCACHE_READAHEAD_BUF) {
+      bcache_stats.readahead_hits++;
+      buf->flags &= ~BCACHE_READAHEAD_BUF;
+      // the reader caught up with the window, start fetching the next one
+      if (sequential) {
+        bcache_load(dev, block + 1, BCACHE_READAHEAD, 0);
+      }
+    }
+  }
+  else {
+    bcache_stats.misses++;
+    // bcache_load leaves the demanded block pinned for us
+    if (bcache_load(dev, block, sequential ? 1 + BCACHE_READAHEAD : 1, 1) <= 0) {
+      return NULL;
+    }
+    buf = bcache_lookup(dev, block);
+    lru_unlink(buf);
+    lru_push_front(buf);
+  }
+  return buf;
+}
+
+void bcache_mark_dirty(bcache_buf_t *buf) {
+  buf->flags |= BCACHE_DIRTY;
+}
+
+void bcache_release(bcache_buf_t *buf) {
+  if (buf->refcount > 0) {
+    buf->refcount--;
+  }
+}
+
+int bcache_sync(blkdev_t *dev) {
+  int i, ret = 0;
+  for (i = 0; i < BCACHE_NUM_BUFS; i++) {
+    bcache_buf_t *buf = &bcache_bufs[i];
+    if ((buf->flags & BCACHE_DIRTY) && (dev == NULL || buf->dev == dev)) {
+      int err = bcache_writeback(buf);
+      if (err < 0) {
+        ret = err;
+      }
+    }
+  }
+  return ret;
+}
+
+int32_t sys_iostat(const char *name, iostat_t *buf) {
+  char kname[BLKDEV_NAME_LENGTH];
+  iostat_t st;
+  if (!name || !buf) {
+    return -EINVAL;
+  }
+  int32_t len = strncpy_from_user((int8_t *)kname, (const int8_t *)name, BLKDEV_NAME_LENGTH);
+  if (len < 0) {
+    return len;
+  }
+  if (len == BLKDEV_NAME_LENGTH) {
+    return -ENODEV;
+  }
+  blkdev_t *dev = blkdev_get(kname);
+  if (!dev) {
+    return -ENODEV;
+  }
+  uint32_t requests = dev->stats.reads + dev->stats.writes;
+  st.dev = dev->stats;
+  st.avg_cycles = requests ? div64_32(dev->stats.total_cycles, requests) : 0;
+  st.cache = bcache_stats;
+  if (copy_to_user(buf, &st, sizeof(iostat_t))) {
+    return -EFAULT;
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file bcache.h
+ * @brief Buffer cache sitting between filesystems and block devices. Caches
+ * 4KB blocks (the filesystem block size) in a fixed pool with LRU eviction,
+ * writes dirty blocks back lazily, and reads ahead when it sees sequential
+ * access so that a large file read turns into a few big DMA requests instead
+ * of one tiny request per block.
+ */
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include "../types.h"
+#include "block.h"
+
+#define BCACHE_BLOCK_SIZE 		4096
+#define BCACHE_SECTORS_PER_BLOCK (BCACHE_BLOCK_SIZE / BLKDEV_SECTOR_SIZE)
+#define BCACHE_NUM_BUFS 		32		///< number of cached blocks
+#define BCACHE_HASH_SIZE 		64		///< buckets in the (dev, block) hash table
+#define BCACHE_READAHEAD 		4		///< extra blocks fetched on sequential access
+
+// buffer flags
+#define BCACHE_VALID 			0x1		///< buffer holds the block's data
+#define BCACHE_DIRTY 			0x2		///< buffer was modified and must be written back
+#define BCACHE_READAHEAD_BUF 	0x4		///< brought in by read-ahead and not used yet
+
+/**
+ *	A cached block
+ */
+typedef struct s_bcache_buf {
+	blkdev_t *dev;						///< device the block belongs to
+	uint32_t block;						///< block number on the device (in BCACHE_BLOCK_SIZE units)
+	uint32_t flags;						///< BCACHE_* flags
+	uint32_t refcount;					///< number of users holding this buffer
+	uint8_t *data;						///< BCACHE_BLOCK_SIZE bytes of data
+	struct s_bcache_buf *hash_next;		///< next buffer in the same hash bucket
+	struct s_bcache_buf *lru_prev;		///< more recently used neighbour
+	struct s_bcache_buf *lru_next;		///< less recently used neighbour
+} bcache_buf_t;
+
+/**
+ *	Cache statistics, see sys_iostat
+ */
+typedef struct s_bcache_stats {
+	uint32_t hits;				///< lookups served from the cache
+	uint32_t misses;			///< lookups that had to go to the device
+	uint32_t readahead;			///< blocks fetched by read-ahead
+	uint32_t readahead_hits;	///< read-ahead blocks that were later used
+	uint32_t evictions;			///< valid buffers that were recycled
+	uint32_t writebacks;		///< dirty buffers written to the device
+} bcache_stats_t;
+
+extern bcache_stats_t bcache_stats;
+
+/**
+ *	What sys_iostat hands back to user space
+ */
+typedef struct s_iostat {
+	blkdev_stats_t dev;			///< stats of the requested device
+	uint32_t avg_cycles;		///< dev.total_cycles / requests, so user space doesn't need 64-bit division
+	bcache_stats_t cache;		///< buffer cache stats (shared by all devices)
+} iostat_t;
+
+/**
+ * @brief Sets up the buffer pool, call once at boot
+ */
+void bcache_init();
+
+/**
+ * @brief Gets a block, reading it (and possibly the blocks after it) from the
+ * device if it isn't cached. The buffer stays pinned until bcache_release
+ *
+ * @param dev the device
+ * @param block block number in BCACHE_BLOCK_SIZE units
+ * @return bcache_buf_t* the buffer, or NULL on I/O error or if every buffer is pinned
+ */
+bcache_buf_t *bcache_read(blkdev_t *dev, uint32_t block);
+
+/**
+ * @brief Marks a held buffer as modified, it gets written back on eviction or bcache_sync
+ */
+void bcache_mark_dirty(bcache_buf_t *buf);
+
+/**
+ * @brief Unpins a buffer returned by bcache_read
+ */
+void bcache_release(bcache_buf_t *buf);
+
+/**
+ * @brief Writes back every dirty buffer of a device
+ *
+ * @param dev the device, or NULL for all devices
+ * @return int 0 on success, or the negative of an errno on failure
+ */
+int bcache_sync(blkdev_t *dev);
+
+/**
+ * @brief Fills in I/O statistics for a block device and the buffer cache
+ *
+ * @param name device name, like "hda"
+ * @param buf where to put the stats
+ * @return int32_t 0 on success, -ENODEV if there's no such device
+ */
+int32_t sys_iostat(const char *name, iostat_t *buf);
+
+#endif
@@ -0,0 +1,90 @@
+#include "block.h"
+#include "../lib.h"
+#include "../errno.h"
+
+static blkdev_t *blkdev_table[BLKDEV_MAX];
+static uint32_t num_blkdevs = 0;
+
+int blkdev_register(blkdev_t *dev) {
+  if (num_blkdevs >= BLKDEV_MAX) {
+    return -ENOSPC;
+  }
+  memset(&dev->stats, 0, sizeof(blkdev_stats_t));
+  dev->id = num_blkdevs;
+  blkdev_table[num_blkdevs++] = dev;
+  return 0;
+}
+
+blkdev_t *blkdev_get(const char *name) {
+  int i;
+  for (i = 0; i < num_blkdevs; i++) {
+    if (strncmp(blkdev_table[i]->name, (int8_t *)name, BLKDEV_NAME_LENGTH) == 0) {
+      return blkdev_table[i];
+    }
+  }
+  return NULL;
+}
+
+blkdev_t *blkdev_get_by_id(uint32_t id) {
+  if (id >= num_blkdevs) {
+    return NULL;
+  }
+  return blkdev_table[id];
+}
+
+/**
+ * @brief Common path for reads and writes. Splits the request into chunks the
+ * driver can take (always on buffer boundaries) and times every chunk.
+ */
+static int blkdev_xfer(blkdev_t *dev, blkdev_xfer_t xfer, uint32_t lba, uint32_t count,
+                       uint8_t **bufs, uint32_t sectors_per_buf, int is_write) {
+  if (!xfer) {
+    return -EROFS;
+  }
+  if (lba + count > dev->num_sectors || lba + count < lba) {
+    return -EINVAL;
+  }
+
+  // largest chunk that still ends on a buffer boundary
+  uint32_t chunk = (dev->max_sectors / sectors_per_buf) * sectors_per_buf;
+  if (chunk == 0) {
+    return -EINVAL;
+  }
+
+  while (count > 0) {
+    uint32_t n = count < chunk ? count : chunk;
+    uint64_t start = rdtsc();
+    int ret = xfer(dev, lba, n, bufs, sectors_per_buf);
+    uint32_t cycles = (uint32_t)(rdtsc() - start);
+
+    if (is_write) {
+      dev->stats.writes++;
+      dev->stats.sectors_written += n;
+    }
+    else {
+      dev->stats.reads++;
+      dev->stats.sectors_read += n;
+    }
+    dev->stats.total_cycles += cycles;
+    if (cycles > dev->stats.max_cycles) {
+      dev->stats.max_cycles = cycles;
+    }
+    if (ret < 0) {
+      dev->stats.errors++;
+      return ret;
+    }
+
+    lba += n;
+    count -= n;
+    bufs += n / sectors_per_buf;
+  }
+  return 0;
+}
+
+int blkdev_read(blkdev_t *dev, uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf) {
+  return blkdev_xfer(dev, dev->read, lba, count, bufs, sectors_per_buf, 0);
+}
+
+int blkdev_write(blkdev_t *dev, uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf) {
+  return blkdev_xfer(dev, dev->write, lba, count, bufs, sectors_per_buf, 1);
+}
@@ -0,0 +1,97 @@
+/**
+ * @file block.h
+ * @brief Block device abstraction. Drivers (like the ATA driver) register a
+ * blkdev_t with read/write callbacks, and everything above (the buffer cache,
+ * filesystems) only ever talks to devices through blkdev_read/blkdev_write
+ * so that I/O counts and latency get tracked in one place.
+ */
+#ifndef BLOCK_H
+#define BLOCK_H
+
+#include "../types.h"
+
+#define BLKDEV_MAX 				4 		///< maximum number of registered block devices
+#define BLKDEV_NAME_LENGTH 		8 		///< max length of device name ("hda", "hdb")
+#define BLKDEV_SECTOR_SIZE 		512 	///< every device we support uses 512 byte sectors
+
+/**
+ *	Per-device I/O statistics. Latencies are in TSC cycles, measured around
+ *	the driver callback so they include the time spent waiting on the disk
+ */
+typedef struct s_blkdev_stats {
+	uint32_t reads;				///< number of read requests sent to the driver
+	uint32_t writes;			///< number of write requests sent to the driver
+	uint32_t sectors_read;		///< total sectors read
+	uint32_t sectors_written;	///< total sectors written
+	uint32_t errors;			///< requests the driver failed
+	uint64_t total_cycles;		///< sum of request latencies
+	uint32_t max_cycles;		///< slowest single request
+} blkdev_stats_t;
+
+struct s_blkdev;
+
+/**
+ *	Driver callback for a transfer
+ *
+ *	@param dev: the device
+ *	@param lba: first sector
+ *	@param count: number of sectors
+ *	@param bufs: array of buffers, each one BLKDEV_SECTOR_SIZE * sectors_per_buf
+ *				 bytes. Letting the caller hand us a list of buffers is what lets
+ *				 the buffer cache read ahead into several cache blocks with a
+ *				 single DMA request
+ *	@param sectors_per_buf: how many sectors go into each buffer of `bufs`
+ *	@return 0 on success, or the negative of an errno on failure
+ */
+typedef int (*blkdev_xfer_t)(struct s_blkdev *dev, uint32_t lba, uint32_t count,
+							 uint8_t **bufs, uint32_t sectors_per_buf);
+
+/**
+ *	A block device
+ */
+typedef struct s_blkdev {
+	char 			name[BLKDEV_NAME_LENGTH];	///< name of the device, like "hda"
+	uint32_t 		id;							///< index into the device table
+	uint32_t 		num_sectors;				///< capacity in sectors
+	uint32_t 		max_sectors;				///< largest transfer the driver takes in one go
+	blkdev_xfer_t 	read;						///< read callback
+	blkdev_xfer_t 	write;						///< write callback, NULL for read-only devices
+	void* 			private_data;				///< driver private data
+	blkdev_stats_t 	stats;						///< I/O statistics
+} blkdev_t;
+
+/**
+ * @brief Adds a device to the device table
+ *
+ * @param dev the device, which must stay allocated forever
+ * @return int 0 on success, -ENOSPC if the table is full
+ */
+int blkdev_register(blkdev_t *dev);
+
+/**
+ * @brief Looks up a registered device by name
+ *
+ * @param name like "hda"
+ * @return blkdev_t* the device or NULL
+ */
+blkdev_t *blkdev_get(const char *name);
+
+/**
+ * @brief Looks up a registered device by its index in the table
+ */
+blkdev_t *blkdev_get_by_id(uint32_t id);
+
+/**
+ * @brief Reads sectors from a device into a list of buffers (see blkdev_xfer_t),
+ * splitting the request if it is larger than what the driver takes at once
+ *
+ * @return int 0 on success, or the negative of an errno on failure
+ */
+int blkdev_read(blkdev_t *dev, uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf);
+
+/**
+ * @brief Write counterpart of blkdev_read
+ */
+int blkdev_write(blkdev_t *dev, uint32_t lba, uint32_t count, uint8_t **bufs, uint32_t sectors_per_buf);
+
+#endif
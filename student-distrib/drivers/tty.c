@@ -1,30 +1,163 @@
 #include "tty.h"
+#include "../lib.h"
+#include "../errno.h"
+#include "../mm/uaccess.h"
 
-tty_t *cur_tty = NULL;
 static tty_t tty_list[TTY_NUMBER];
 
-
+// keeps the compiler from moving ring accesses across the index updates. x86
+// doesn't reorder stores with stores or loads with loads, so that's enough
+#define barrier() asm volatile("" : : : "memory")
 
 int tty_init() {
   int i;
-	// initialize all terminals to sleep
-	for (i=0; i<TTY_NUMBER; ++i){
-		tty_list[i].tty_status = TTY_SLEEP | TTY_BACKGROUND;
-		// initialize flags, 0 for now
-		tty_list[i].indev_flag = 0;
-		tty_list[i].outdev_flag = 0;
-		tty_list[i].flags = 0;
-		tty_list[i].input_pid_waiting = 0;
-
-		// initialize buffer
-		tty_list[i].buf.index = 0;
-		tty_list[i].buf.end = TTY_BUF_LENGTH - 1;
-		tty_list[i].buf.flags = 0;
-	}
-  
-	// initialize the first tty
-	tty_list[0].tty_status = TTY_ACTIVE | TTY_FOREGROUND;
-	tty_list[0].output_private_data = terminal_out_tty_init();
-	tty_list[0].fg_proc = 1; 		// NOTE HARDCODED
-	tty_list[0].root_proc = 1;		// NOTE HARDCODED
+  for (i = 0; i < TTY_NUMBER; ++i) {
+    tty_list[i].flags = TTY_FG_ECHO | TTY_FG_CANON;
+    tty_list[i].buf.head = 0;
+    tty_list[i].buf.tail = 0;
+    tty_list[i].line_len = 0;
+    wait_queue_init(&tty_list[i].rd_wait);
+  }
+  return 0;
+}
+
+tty_t *tty_get(uint32_t n) {
+  return &tty_list[n];
+}
+
+// producer side. All n bytes go in or none do, so a canonical line never
+// shows up half
+static int tty_push(tty_buf_t *b, const uint8_t *data, uint32_t n) {
+  uint32_t head = b->head;
+  uint32_t i;
+  if (TTY_BUF_LENGTH - (head - b->tail) < n) {
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    b->buf[(head + i) & TTY_BUF_MASK] = data[i];
+  }
+  barrier();
+  b->head = head + n;
+  return 0;
+}
+
+void tty_receive(tty_t *tty, uint8_t c) {
+  int echo = !(tty->flags & TTY_FG_NECHO);
+
+  if (tty->flags & TTY_FG_RAW) {
+    if (tty_push(&tty->buf, &c, 1) == 0) {
+      wake_up(&tty->rd_wait);
+      if (echo && c != '\b') {
+        putc(c);
+      }
+    }
+    return;
+  }
+
+  switch (c) {
+    case '\b':
+      if (tty->line_len) {
+        tty->line_len--;
+        if (echo) {
+          do_backspace();
+        }
+      }
+      break;
+    case '\n':
+      // there's always room for the newline. If the readers are that far
+      // behind the line is lost, like a full line buffer used to drop keys
+      tty->line[tty->line_len++] = '\n';
+      if (tty_push(&tty->buf, tty->line, tty->line_len) == 0) {
+        wake_up(&tty->rd_wait);
+      }
+      tty->line_len = 0;
+      if (echo) {
+        putc('\n');
+      }
+      break;
+    default:
+      if (tty->line_len < TTY_LINE_LENGTH - 1) {
+        tty->line[tty->line_len++] = c;
+        if (echo) {
+          putc(c);
+        }
+      }
+      break;
+  }
+}
+
+// consumer side, how much one read may take right now
+static uint32_t tty_avail(tty_t *tty) {
+  uint32_t tail = tty->buf.tail;
+  uint32_t head = tty->buf.head;
+  uint32_t i;
+  barrier();
+  if (tty->flags & TTY_FG_RAW) {
+    return head - tail;
+  }
+  for (i = tail; i != head; i++) {
+    if (tty->buf.buf[i & TTY_BUF_MASK] == '\n') {
+      return i - tail + 1;
+    }
+  }
+  return 0;
+}
+
+int32_t tty_read(tty_t *tty, void *buf, int32_t nbytes) {
+  uint32_t n, tail, first, flags;
+  int32_t ret;
+
+  if (nbytes <= 0) {
+    return 0;
+  }
+  // sleep until tty_receive has something. Taking the bytes happens with
+  // interrupts off, so two tasks reading one tty still make one consumer
+  cli_and_save(flags);
+  wait_event(&tty->rd_wait, (n = tty_avail(tty)) != 0, ret);
+  if (ret < 0) {
+    restore_flags(flags);
+    return ret;
+  }
+
+  if (n > (uint32_t)nbytes) {
+    n = nbytes;
+  }
+  tail = tty->buf.tail;
+  // the bytes might wrap around the end of the ring
+  first = TTY_BUF_LENGTH - (tail & TTY_BUF_MASK);
+  if (first > n) {
+    first = n;
+  }
+  if (__copy_to_user(buf, &tty->buf.buf[tail & TTY_BUF_MASK], first) ||
+      __copy_to_user((uint8_t *)buf + first, tty->buf.buf, n - first)) {
+    restore_flags(flags);
+    return -EFAULT;
+  }
+  barrier();
+  tty->buf.tail = tail + n;
+  restore_flags(flags);
+  return n;
+}
+
+int32_t tty_ioctl(tty_t *tty, uint32_t request, uint32_t arg) {
+  uint32_t flags;
+  switch (request) {
+    case TTY_IOCTL_GETFLAGS:
+      return tty->flags;
+    case TTY_IOCTL_SETFLAGS:
+      if (arg & ~(TTY_FG_NECHO | TTY_FG_RAW)) {
+        return -EINVAL;
+      }
+      // the IRQ edits the line, so it changes mode with the IRQ held off.
+      // A half typed line doesn't carry over into the other mode
+      cli_and_save(flags);
+      tty->flags = arg;
+      tty->line_len = 0;
+      // in raw mode a reader may have something to take already
+      wake_up(&tty->rd_wait);
+      restore_flags(flags);
+      return 0;
+    default:
+      return -ENOTTY;
+  }
 }
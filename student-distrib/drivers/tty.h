@@ -1,62 +1,80 @@
+/**
+ * @file tty.h
+ * @brief Keyboard input line discipline. The keyboard IRQ hands each key to
+ * tty_receive, which edits the current line (canonical mode) or passes the
+ * key on as is (raw mode). Input that's ready to read goes into a ring that
+ * the IRQ only ever appends to and readers only ever take from, so neither
+ * side needs a lock. Keys typed before anybody reads are kept in the ring.
+ * Readers sleep on the tty's wait queue until tty_receive has input for them.
+ */
 #ifndef TTY_H
 #define TTY_H
 
-#include "../errno.h"
-#include "../task.h"
-#include "../signal.h"
-
-#define	TTY_SLEEP 			0x0 		///< tty flag, means tty is not in use
-#define TTY_ACTIVE 			0x1			///< tty flag, means tty is in use
-#define TTY_FOREGROUND 		0x2 		///< tty flag, means tty is foreground
-#define TTY_BACKGROUND 		0x0 		///< tty flag, means tty is background
+#include "../types.h"
+#include "../fs/vfs.h"
+#include "../wait.h"
 
-#define TTY_NUMBER			4 			///< maximum number of tty
-#define TTY_BUF_LENGTH		128 		///< maximum length of tty buffer
+#define TTY_NUMBER			4 			///< maximum number of tty, one per terminal
+#define TTY_BUF_LENGTH		256 		///< size of the input ring, a power of two
+#define TTY_BUF_MASK		(TTY_BUF_LENGTH - 1)
+#define TTY_LINE_LENGTH		128 		///< longest line canonical mode edits, with the newline
 
+// tty flags, TTY_IOCTL_GETFLAGS / TTY_IOCTL_SETFLAGS
 #define TTY_FG_ECHO		 	0x0 		///< tty echo any key press to the terminal
 #define TTY_FG_NECHO		0x1 		///< tty doesn't echo key press
+#define TTY_FG_CANON		0x0 		///< reads return whole lines, backspace edits the line
+#define TTY_FG_RAW			0x2 		///< every key can be read right away, no editing
 
-#define TTY_BUF_ENTER		0x1 		///< buffer flag flag for there is an enter in the buffer
-
-#define TTY_DRIVER_NAME_LENGTH	32 		///< maximum length of in/out driver name length
+// ioctl requests on a tty, arg is the flags
+#define TTY_IOCTL_GETFLAGS	0x5401		///< returns the flags
+#define TTY_IOCTL_SETFLAGS	0x5402		///< sets the flags, returns 0
 
 /**
- *	tty buffer structure stores all information about the buffer of a tty
- * 	including flags, current index, end of buffer, and the buffer data,
- * 	note that the buffer is a wrapped around structure
+ *	Input ready to be read. Indices only ever count up and are masked on
+ *	use, head is only written by the keyboard IRQ and tail only by readers
  */
 typedef struct s_tty_buffer{
 	uint8_t 	buf[TTY_BUF_LENGTH]; 	///< buffer data
-	uint8_t 	flags; 					///< buffer flag
-	uint32_t 	index; 					///< index of next empty spot
-	uint32_t 	end; 					///< end of the buffer
+	volatile uint32_t head; 			///< one past the last byte put in
+	volatile uint32_t tail; 			///< next byte to read
 } tty_buf_t;
 
 /**
  *	tty structure stores all the information of a tty
  */
 typedef struct s_tty{
-	uint32_t		tty_status;		///< tty status
-	uint32_t 		indev_flag; 	///< flag and feature for input
-	uint32_t 		outdev_flag; 	///< flag and feature for output
-	uint32_t		flags; 			///< flags and attributes for tty
-	uint32_t 		fg_proc;		///< process pid currently running at foreground of this tty
-	uint32_t 		root_proc;		///< first process born with this tty
+	uint32_t		flags; 			///< TTY_FG_*
 	struct s_tty_buffer	buf; 			///< tty buffer
-
-	uint32_t 		input_pid_waiting; 		///< pid of the process waiting for input, 0 for none
-	void* 			input_private_data; 	///< input private data, memory allocated by input driver
-	void* 			output_private_data;	///< output private data, memory allocated by output driver
-
-	// not implemented
-/*	int (*tty_write)(uint8_t* buf, uint32_t* size); ///< output function pointer
-	int (*tty_in_open)(struct s_tty* tty); 	///< open input driver
-	int (*tty_out_open)(struct s_tty* tty); ///< open output driver*/
+	uint8_t			line[TTY_LINE_LENGTH];	///< canonical line being typed, IRQ side only
+	uint32_t		line_len;		///< bytes in line
+	wait_queue_t	rd_wait;		///< readers waiting for input
 } tty_t;
 
 int tty_init();
 
-/// Current active TTY
-extern tty_t* cur_tty;
+/**
+ * @brief The tty of terminal n
+ */
+tty_t *tty_get(uint32_t n);
+
+/**
+ * @brief Called from the keyboard IRQ (interrupts off) with a key typed into
+ * tty. '\b' is backspace, '\n' enter
+ */
+void tty_receive(tty_t *tty, uint8_t c);
+
+/**
+ * @brief Waits for input and reads it into buf (user memory). In canonical
+ * mode it reads up to the end of one line, what doesn't fit in nbytes is left
+ * for the next read. In raw mode it reads whatever has been typed
+ * @return int32_t bytes read, -EFAULT, -EINTR if a signal came first
+ */
+int32_t tty_read(tty_t *tty, void *buf, int32_t nbytes);
+
+/**
+ * @brief TTY_IOCTL_* on tty
+ * @return int32_t see the requests, -ENOTTY for an unknown one, -EINVAL
+ */
+int32_t tty_ioctl(tty_t *tty, uint32_t request, uint32_t arg);
 
 #endif
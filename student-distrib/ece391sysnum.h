@@ -16,7 +16,13 @@
 
 // https://thevivekpandey.github.io/posts/2017-09-25-linux-system-calls.html
 // the numbers do NOT match up with the official documentation, but that's imposisble anyways since ECE391 syscalls 
-// take up 1-10, either way the numbers don't really matter since we can just register them in a different order
+// take up 1-10, either way the numbers don't really matter since we can just register them in a different order.
+// Which handler each number runs is in syscall_table.h
+#define SYSCALL_BRK			11
+#define SYSCALL_SBRK		12
+#define SYSCALL_PIPE		13
+#define SYSCALL_DUP2		14
+#define SYSCALL_MAKE_INITD	15		///< used once, by the kernel's own init process
 #define SYSCALL_OPEN		16
 #define SYSCALL_CLOSE		17
 #define SYSCALL_READ		18
@@ -37,8 +43,6 @@
 #define SYSCALL_FSTAT		32
 #define SYSCALL_LSTAT		33
 #define SYSCALL_GETPID		34
-#define SYSCALL_BRK			35
-#define SYSCALL_SBRK		36
 
 #define SYSCALL_LSEEK		35
 #define SYSCALL_CHMOD		36
@@ -48,16 +52,28 @@
 #define SYSCALL_SYMLINK		40
 #define SYSCALL_READLINK	41
 #define SYSCALL_TRUNCATE	42
+#define SYSCALL_SIGQUEUE	43
 #define SYSCALL_RENAME		44
 #define SYSCALL_GETCWD		45
 #define SYSCALL_CHDIR		46
 #define SYSCALL_MKDIR		47
 #define SYSCALL_RMDIR		48
 #define SYSCALL_IOCTL		49
+#define SYSCALL_SIGNALFD	50
 
 #define SYSCALL_GETUID		51
 #define SYSCALL_SETUID		52
 #define SYSCALL_GETGID		53
 #define SYSCALL_SETGID		54
 
-#define NUM_SYSCALLS        100
\ No newline at end of file
+#define SYSCALL_IOSTAT		55
+#define SYSCALL_DUP			56
+#define SYSCALL_READV		57
+#define SYSCALL_WRITEV		58
+#define SYSCALL_PREAD		59	///< 4th argument (offset) in esi
+#define SYSCALL_PWRITE		60	///< 4th argument (offset) in esi
+#define SYSCALL_RING_SETUP	61
+#define SYSCALL_ENTER_RING	62
+#define SYSCALL_IRQSTAT		63
+
+#define NUM_SYSCALLS        64	///< size of syscall_table, numbers go up to NUM_SYSCALLS - 1
\ No newline at end of file
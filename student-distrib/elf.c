@@ -1,40 +1,252 @@
 #include "elf.h"
 #include "task.h"
+#include "paging.h"
 #include "system_calls.h"
 #include "errno.h"
+#include "lib.h"
+#include "mm/kmalloc.h"
+#include "fs/procfs.h"
 
-int elf_load(int fd) {
-
+// reads exactly n bytes at off, buf can be a kernel or a user address
+static int elf_read_at(file_t *file, uint32_t off, void *buf, uint32_t n) {
+  int ret;
+  file->pos = off;
+  ret = file->f_op->read(file, buf, n);
+  if (ret < 0) {
+    return ret;
+  }
+  return (uint32_t)ret == n ? 0 : -EIO;
 }
 
-int elf_sanity(int fd) {
-  elf_eheader_t eh;
-  int ret = sys_read(fd, &eh, sizeof(elf_eheader_t));
+int elf_read_header(file_t *file, elf_eheader_t *eh) {
+  if (!file->f_op || !file->f_op->read) {
+    return -EBADF;
+  }
+  int ret = elf_read_at(file, 0, eh, sizeof(elf_eheader_t));
   if (ret < 0) {
-    return ret;
+    return ret == -EIO ? -ENOEXEC : ret;
   }
-  if (ret != sizeof(eh)) {
-		return -EIO;
-	}
 	// Sanity checks
-	if (eh.magic[0] != '\x7f' || eh.magic[1] != 'E' ||
-		eh.magic[2] != 'L' || eh.magic[3] != 'F') {
+	if (eh->magic[0] != '\x7f' || eh->magic[1] != 'E' ||
+		eh->magic[2] != 'L' || eh->magic[3] != 'F') {
 		return -ENOEXEC;
 	}
-	
-	if (eh.arch != 1) {
+
+	if (eh->arch != 1) {
 		// Not 32 bits
 		return -ENOEXEC;
 	}
-	if (eh.endianness != 1) {
+	if (eh->endianness != 1) {
 		// Not LE
 		return -ENOEXEC;
 	}
-	if (eh.machine != 3) {
+	if (eh->machine != 3) {
 		// Not x86
 		return -ENOEXEC;
 	}
-	
+
 	return 0;
 }
 
+static elf_image_t elf_cache[ELF_CACHE_IMAGES];
+static uint32_t elf_cache_clock;
+static uint32_t elf_cache_misses;
+
+// reads the program headers and keeps the PT_LOAD ones, checking that each
+// fits in the program page before anything is loaded
+static int elf_read_segments(file_t *file, const elf_eheader_t *eh, elf_image_t *image) {
+  elf_pheader_t ph[ELF_MAX_PHNUM];
+  uint32_t start = PROGRAM_IMAGE_VIRTUAL_ADDRESS;
+  uint32_t end = PROGRAM_IMAGE_VIRTUAL_ADDRESS + FOURMB;
+  uint32_t i;
+  int ret;
+
+  if (eh->phentsize != sizeof(elf_pheader_t) || eh->phnum == 0 || eh->phnum > ELF_MAX_PHNUM) {
+    return -ENOEXEC;
+  }
+  ret = elf_read_at(file, eh->phoff, ph, eh->phnum * sizeof(elf_pheader_t));
+  if (ret < 0) {
+    return ret == -EIO ? -ENOEXEC : ret;
+  }
+
+  image->nseg = 0;
+  image->data_len = 0;
+  for (i = 0; i < eh->phnum; i++) {
+    if (ph[i].type != ELF_PT_LOAD) {
+      continue;
+    }
+    if (ph[i].filesz > ph[i].memsz || ph[i].vaddr < start || ph[i].vaddr > end ||
+        ph[i].memsz > end - ph[i].vaddr) {
+      return -ENOEXEC;
+    }
+    elf_segment_t *seg = &image->seg[image->nseg++];
+    seg->vaddr = ph[i].vaddr;
+    seg->offset = ph[i].offset;
+    seg->filesz = ph[i].filesz;
+    seg->memsz = ph[i].memsz;
+    seg->data = image->data_len;
+    image->data_len += ph[i].filesz;
+  }
+  if (!image->nseg || eh->entry < start || eh->entry >= end) {
+    return -ENOEXEC;
+  }
+  image->entry = eh->entry;
+  return 0;
+}
+
+static void elf_image_drop(elf_image_t *image) {
+  if (image->data) {
+    kfree(image->data);
+  }
+  image->data = NULL;
+  image->inode = NULL;
+}
+
+// fills image in from file, keeping the segment bytes if they're small enough
+static int elf_image_make(file_t *file, elf_image_t *image) {
+  elf_eheader_t eh;
+  uint32_t i;
+  int ret = elf_read_header(file, &eh);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = elf_read_segments(file, &eh, image);
+  if (ret < 0) {
+    return ret;
+  }
+  image->data = NULL;
+  if (image->data_len <= ELF_CACHE_MAX_DATA) {
+    // no memory only means the bytes come from the file every time
+    image->data = kmalloc(image->data_len ? image->data_len : 1);
+  }
+  if (image->data) {
+    for (i = 0; i < image->nseg; i++) {
+      elf_segment_t *seg = &image->seg[i];
+      if (seg->filesz && (ret = elf_read_at(file, seg->offset, image->data + seg->data, seg->filesz)) < 0) {
+        elf_image_drop(image);
+        return ret;
+      }
+    }
+  }
+  image->inode = file->inode;
+  image->size = file->inode->size;
+  image->hits = 0;
+  return 0;
+}
+
+int elf_image_get(file_t *file, elf_image_t **image) {
+  elf_image_t *victim = &elf_cache[0];
+  uint32_t i;
+  int ret;
+
+  elf_cache_clock++;
+  for (i = 0; i < ELF_CACHE_IMAGES; i++) {
+    elf_image_t *img = &elf_cache[i];
+    if (img->inode == file->inode && img->size == file->inode->size) {
+      img->hits++;
+      img->last_use = elf_cache_clock;
+      *image = img;
+      return 0;
+    }
+    // free slots first, then the least recently used
+    if (victim->inode && (!img->inode || img->last_use < victim->last_use)) {
+      victim = img;
+    }
+  }
+
+  elf_cache_misses++;
+  if (victim->inode) {
+    elf_image_drop(victim);
+  }
+  ret = elf_image_make(file, victim);
+  if (ret < 0) {
+    return ret;
+  }
+  victim->last_use = elf_cache_clock;
+  *image = victim;
+  return 0;
+}
+
+int elf_image_load(const elf_image_t *image, file_t *file) {
+  uint32_t i;
+  int ret;
+  for (i = 0; i < image->nseg; i++) {
+    const elf_segment_t *seg = &image->seg[i];
+    if (image->data) {
+      memcpy((void *)seg->vaddr, image->data + seg->data, seg->filesz);
+    }
+    else if (seg->filesz && (ret = elf_read_at(file, seg->offset, (void *)seg->vaddr, seg->filesz)) < 0) {
+      return ret;
+    }
+    // .bss. The page may have held another program, it isn't zero already
+    memset((void *)(seg->vaddr + seg->filesz), 0, seg->memsz - seg->filesz);
+  }
+  return 0;
+}
+
+/*
+/proc/exec, one line per cached program: its inode, the bytes kept for it
+(0 if it's too big and gets read from the file), and how often exec reused it.
+*/
+static void elf_cache_show(proc_buf_t *pb) {
+  uint32_t i, hits = 0;
+  proc_puts(pb, "inode      bytes       hits\n");
+  for (i = 0; i < ELF_CACHE_IMAGES; i++) {
+    elf_image_t *img = &elf_cache[i];
+    if (!img->inode) {
+      continue;
+    }
+    proc_putnum(pb, img->inode->ino, 5);
+    proc_putnum(pb, img->data ? img->data_len : 0, 11);
+    proc_putnum(pb, img->hits, 11);
+    proc_puts(pb, "\n");
+    hits += img->hits;
+  }
+  proc_puts(pb, "hits ");
+  proc_putnum(pb, hits, 0);
+  proc_puts(pb, " misses ");
+  proc_putnum(pb, elf_cache_misses, 0);
+  proc_puts(pb, "\n");
+}
+
+void elf_cache_flush() {
+  uint32_t i;
+  for (i = 0; i < ELF_CACHE_IMAGES; i++) {
+    if (elf_cache[i].inode) {
+      elf_image_drop(&elf_cache[i]);
+    }
+  }
+}
+
+void elf_cache_init() {
+  procfs_register("exec", elf_cache_show);
+}
+
+int elf_load(int fd, uint32_t *entry) {
+  elf_image_t *image;
+  file_t *file = vfs_fd_get(get_task_in_running_terminal(), fd);
+  int ret;
+  if (!file) {
+    return -EBADF;
+  }
+  ret = elf_image_get(file, &image);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = elf_image_load(image, file);
+  if (ret < 0) {
+    return ret;
+  }
+  *entry = image->entry;
+  return 0;
+}
+
+int elf_sanity(int fd) {
+  elf_eheader_t eh;
+  // straight through the file, sys_read only takes user buffers
+  file_t *file = vfs_fd_get(get_task_in_running_terminal(), fd);
+  if (!file) {
+    return -EBADF;
+  }
+  return elf_read_header(file, &eh);
+}
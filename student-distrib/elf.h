@@ -1,6 +1,15 @@
 #ifndef ELF_H
 #define ELF_H
 
+#include "types.h"
+#include "fs/vfs.h"
+
+#define ELF_PT_LOAD			1			///< program header type of a segment to load
+#define ELF_PF_W			0x2			///< segment is writable
+#define ELF_MAX_PHNUM		16			///< most program headers we look at
+#define ELF_CACHE_IMAGES	8			///< programs the image cache remembers
+#define ELF_CACHE_MAX_DATA	0x40000		///< programs with more segment bytes keep only their layout cached
+
 /**
  *	ELF header. Contains information about the layout of the ELF file
  *  https://en.wikipedia.org/wiki/Executable_and_Linkable_Format
@@ -32,30 +41,100 @@ typedef struct elf_eheader_s {
  *	Program header. Contains information about segments to be loaded
  */
 typedef struct elf_pheader_s {
-	uint32_t type; ///< Segment type. Should be 1 for program contents
+	uint32_t type; ///< Segment type. ELF_PT_LOAD for program contents, the rest is ignored
 	uint32_t offset; ///< File offset of segment in ELF file
 	uint32_t vaddr; ///< Virtual address of segment
 	uint32_t paddr; ///< Physical address of segment. Ignored
-	uint32_t filesz; ///< Segment size
-	uint32_t memsz; ///< Segment size in memory. Ignored
+	uint32_t filesz; ///< Bytes of the segment stored in the file
+	uint32_t memsz; ///< Segment size in memory, past filesz is .bss and zeroed
 	uint32_t flags; ///< Permission bits
 	uint32_t align; ///< Segment alignment information. Should be 4KB or 4MB
 } __attribute__((__packed__)) elf_pheader_t;
 
 /**
- *	Load ELF segments from a file into current process
+ *	Reads the ELF header at the start of file and checks that it's a 32 bit
+ *	little endian x86 executable we can load
  *
- *	@note The existing process page table buffer will be replaced if it exists
- *		  the contents will be copied, but the memory will not be released. If
- *		  the process pages is clean, setting pages to NULL is recommended.
- *		  Otherwise, setting pages to a statically-allocated buffer is
- *		  recommended. If a kmalloc'ed buffer has to be used, you need to keep
- *		  a pointer to it and manually free it after the call.
+ *	@param file: the ELF file opened for reading, its position is moved
+ *	@param eh: filled in with the header
+ *	@return 0 on success, or the negative of an errno on failure.
+ */
+int elf_read_header(file_t *file, elf_eheader_t *eh);
+
+/**
+ *	A PT_LOAD segment, checked to fit in the program page
+ */
+typedef struct elf_segment_s {
+	uint32_t vaddr; ///< Where it goes
+	uint32_t offset; ///< File offset of its bytes
+	uint32_t filesz; ///< Bytes it has in the file
+	uint32_t memsz; ///< Bytes it takes in memory, past filesz is .bss
+	uint32_t data; ///< Offset of its bytes in elf_image_t::data
+} elf_segment_t;
+
+/**
+ *	A program as exec needs it. The shell runs the same few programs over and
+ *	over, so images are kept in a small cache keyed by inode. Loading a cached
+ *	image is a memcpy per segment, no header parsing and no filesystem reads
+ *	(which may have to decompress)
+ */
+typedef struct elf_image_s {
+	inode_t *inode; ///< File the image was made from, NULL if the slot is free
+	uint32_t size; ///< Size of the file when the image was made
+	uint32_t entry; ///< Entry point
+	uint32_t nseg; ///< Segments in seg
+	elf_segment_t seg[ELF_MAX_PHNUM]; ///< The PT_LOAD segments
+	uint8_t *data; ///< File bytes of every segment back to back, NULL if they're read from the file on each load
+	uint32_t data_len; ///< Bytes in data
+	uint32_t hits; ///< Times the image was reused
+	uint32_t last_use; ///< For picking the least recently used slot to reuse
+} elf_image_t;
+
+/**
+ *	Finds the image of file in the cache, or makes it. Programs whose segments
+ *	have more than ELF_CACHE_MAX_DATA bytes only get their layout cached
+ *
+ *	@param file: the ELF file opened for reading
+ *	@param image: set to the image, valid until the next elf_image_get
+ *	@return 0 on success, or the negative of an errno on failure.
+ */
+int elf_image_get(file_t *file, elf_image_t **image);
+
+/**
+ *	Loads an image into the current process' program page, which has to be
+ *	mapped already. Every segment is copied to its vaddr and its .bss zeroed.
+ *	Section headers, symbols and debug info are never read
+ *
+ *	@note Every segment has to fit in the 4MB program page at
+ *		  PROGRAM_IMAGE_VIRTUAL_ADDRESS. That page is mapped user read/write as a
+ *		  whole, so the segment flags can't be applied and even read-only
+ *		  segments get their own copy
+ *
+ *	@param image: from elf_image_get
+ *	@param file: the file it was made from, read if the image has no data
+ *	@return 0 on success, or the negative of an errno on failure.
+ */
+int elf_image_load(const elf_image_t *image, file_t *file);
+
+/**
+ *	Adds /proc/exec, the images in the cache and how often they were reused
+ */
+void elf_cache_init();
+
+/**
+ *	Drops every cached image. Called when filesystems are mounted or
+ *	unmounted, since the inodes the images are keyed by may now be other files
+ */
+void elf_cache_flush();
+
+/**
+ *	Load ELF segments from a file into current process, see elf_image_load
  *
  *	@param fd: the file descriptor of the ELF file opened for reading
+ *	@param entry: set to the entry point of the program
  *	@return 0 on success, or the negative of an errno on failure.
  */
-int elf_load(int fd);
+int elf_load(int fd, uint32_t *entry);
 
 /**
  *	Check ELF sanity
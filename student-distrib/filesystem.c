@@ -1,53 +1,381 @@
 #include "filesystem.h"
 #include "lib.h"
 #include "task.h"
+#include "errno.h"
+#include "mm/kmalloc.h"
+#include "mm/uaccess.h"
+#include "libc/dirent.h"
+#include "drivers/bcache.h"
+#include "fs/vfs.h"
+#include "fs/lz4.h"
 
 #define SIXTY_FOUR_BYTES 0x40
 #define FOUR_KB 0x1000
 
 uint32_t num_directory_entries = 0;
 
-/*
-When successful, the first two calls fill in the dentry t
-block passed as their second argument with the file name, file
-type, and inode number for the file, then return 0
-*/
-uint32_t read_dentry_by_name(const uint8_t *fname, dentry_t *dentry)
+// if set, the image is read off this device through the buffer cache instead
+// of from the multiboot module at filesys_start_address
+static blkdev_t *filesys_dev = NULL;
+
+/**
+ * @brief Copies part of a 4KB block of the filesystem image, wherever the image lives
+ *
+ * @param block index of the block in the image (0 is the boot block)
+ * @param offset byte offset within the block
+ * @param buf destination, may be a user buffer from read()
+ * @param length bytes to copy, offset + length must be <= 4KB
+ * @return int 0 on success, -1 on I/O error or a bad buffer
+ */
+static int fs_read_block(uint32_t block, uint32_t offset, void *buf, uint32_t length)
 {
-  int i;
-  for (i = 0; i < num_directory_entries; i++)
+  if (!filesys_dev)
+  {
+    return __copy_to_user(buf, (void *)(filesys_start_address + block * FOUR_KB + offset), length) ? -1 : 0;
+  }
+
+  bcache_buf_t *b = bcache_read(filesys_dev, block);
+  if (!b)
+  {
+    return -1;
+  }
+  uint32_t left = __copy_to_user(buf, b->data + offset, length);
+  bcache_release(b);
+  return left ? -1 : 0;
+}
+
+/**
+ * @brief Like fs_read_block, but the range may cross block boundaries
+ */
+static int fs_read_span(uint32_t block, uint32_t offset, void *buf, uint32_t length)
+{
+  uint8_t *out = (uint8_t *)buf;
+  block += offset / FOUR_KB;
+  offset %= FOUR_KB;
+  while (length > 0)
   {
-    if (strlen((int8_t*) fname) == MAX_FILE_NAME_LENGTH)
+    uint32_t chunk = FOUR_KB - offset < length ? FOUR_KB - offset : length;
+    if (fs_read_block(block, offset, out, chunk) == -1)
     {
-      // for very long file, we just want to compare first 32 chars
-      // without this it will return -1
-      if (strncmp((int8_t *)directory_entries[i].file_name, (int8_t *)fname, MAX_FILE_NAME_LENGTH) == 0)
-      {
-        strncpy((int8_t *)dentry->file_name, (int8_t *)directory_entries[i].file_name, MAX_FILE_NAME_LENGTH);
-        dentry->file_type = directory_entries[i].file_type;
-        dentry->inode_number = directory_entries[i].inode_number;
-        memcpy(dentry->reserved, directory_entries[i].reserved, BYTES_RESERVED);
-        return 0;
-      }
+      return -1;
+    }
+    out += chunk;
+    length -= chunk;
+    block++;
+    offset = 0;
+  }
+  return 0;
+}
+
+// compressed images, see FS_LZ4_MAGIC. fs_zmap_block is the first block of
+// the block map and fs_zdata_block the first block of the compressed area,
+// both 0 if the image isn't compressed
+static uint32_t fs_zmap_block = 0;
+static uint32_t fs_zdata_block = 0;
+
+fs_zcache_stats_t fs_zcache_stats;
+static uint8_t fs_zcache_data[FS_ZCACHE_SIZE][FOUR_KB];
+static uint32_t fs_zcache_tag[FS_ZCACHE_SIZE];    // data block held, 0xFFFFFFFF if none
+static uint32_t fs_zcache_used[FS_ZCACHE_SIZE];   // fs_zcache_clock when last used
+static uint32_t fs_zcache_clock = 0;
+// compressed bytes of the block being decompressed. Compressed blocks are
+// always smaller than 4KB, bigger ones are stored as is
+static uint8_t fs_zscratch[FOUR_KB];
+
+static void fs_zcache_flush()
+{
+  memset(fs_zcache_tag, 0xFF, sizeof(fs_zcache_tag));
+  memset(fs_zcache_used, 0, sizeof(fs_zcache_used));
+  fs_zcache_clock = 0;
+}
+
+/**
+ * @brief Gets the decompressed contents of a data block, from the cache or by
+ * decompressing it into the least recently used slot
+ *
+ * @return uint8_t* 4KB of data, NULL on I/O error or corrupt block
+ */
+static uint8_t *fs_zcache_get(uint32_t data_block)
+{
+  uint32_t i, victim = 0;
+  fs_zcache_clock++;
+  for (i = 0; i < FS_ZCACHE_SIZE; i++)
+  {
+    if (fs_zcache_tag[i] == data_block)
+    {
+      fs_zcache_stats.hits++;
+      fs_zcache_used[i] = fs_zcache_clock;
+      return fs_zcache_data[i];
     }
-    if (strlen((int8_t*) directory_entries[i].file_name) != strlen((int8_t*) fname))
+    if (fs_zcache_used[i] < fs_zcache_used[victim])
+    {
+      victim = i;
+    }
+  }
+
+  fs_zcache_stats.misses++;
+  uint8_t *out = fs_zcache_data[victim];
+  fs_zmap_entry_t entry;
+  fs_zcache_tag[victim] = 0xFFFFFFFF;
+  fs_zcache_used[victim] = 0;
+  if (fs_read_span(fs_zmap_block, data_block * sizeof(fs_zmap_entry_t), &entry, sizeof(entry)) == -1 ||
+      entry.length > FOUR_KB)
+  {
+    fs_zcache_stats.errors++;
+    return NULL;
+  }
+
+  if (entry.length == FOUR_KB)
+  {
+    // stored uncompressed
+    if (fs_read_span(fs_zdata_block, entry.offset, out, FOUR_KB) == -1)
+    {
+      fs_zcache_stats.errors++;
+      return NULL;
+    }
+  }
+  else if (fs_read_span(fs_zdata_block, entry.offset, fs_zscratch, entry.length) == -1 ||
+           lz4_decompress_block(fs_zscratch, entry.length, out, FOUR_KB) != FOUR_KB)
+  {
+    fs_zcache_stats.errors++;
+    return NULL;
+  }
+  fs_zcache_stats.bytes_in += entry.length;
+  fs_zcache_tag[victim] = data_block;
+  fs_zcache_used[victim] = fs_zcache_clock;
+  return out;
+}
+
+/**
+ * @brief Copies part of a data block (numbered from the first data block),
+ * decompressing it first if the image is compressed
+ */
+static int fs_read_data_block(uint32_t data_block, uint32_t offset, void *buf, uint32_t length)
+{
+  if (!fs_zdata_block)
+  {
+    // data blocks come right after the boot block and the inodes
+    return fs_read_block(num_inodes + 1 + data_block, offset, buf, length);
+  }
+  uint8_t *data = fs_zcache_get(data_block);
+  if (!data)
+  {
+    return -1;
+  }
+  return __copy_to_user(buf, data + offset, length) ? -1 : 0;
+}
+
+dcache_stats_t dcache_stats;
+static dcache_entry_t dcache[DCACHE_SIZE];
+static dcache_entry_t *dcache_hash[DCACHE_HASH_SIZE];
+// next slot to recycle when the cache is full (round robin)
+static uint32_t dcache_victim = 0;
+
+/**
+ * @brief Compares a name stored in a dentry with a path component. Names that
+ * fill all 32 bytes aren't NUL terminated, and components longer than that
+ * never match, like before
+ */
+static int fs_name_match(const uint8_t *entry_name, const char *name, uint32_t len)
+{
+  if (len > MAX_FILE_NAME_LENGTH)
+  {
+    return 0;
+  }
+  if (len == MAX_FILE_NAME_LENGTH)
+  {
+    return strncmp((int8_t *)entry_name, (int8_t *)name, MAX_FILE_NAME_LENGTH) == 0;
+  }
+  return strncmp((int8_t *)entry_name, (int8_t *)name, len) == 0 && entry_name[len] == '\0';
+}
+
+int32_t fs_dir_entry(uint32_t dir, uint32_t index, dentry_t *dentry)
+{
+  if (dir == FS_ROOT_INODE)
+  {
+    if (index >= num_directory_entries)
     {
-      // the two files must have the same length
-      continue;
+      return -1;
     }
-    if (strncmp((int8_t *)directory_entries[i].file_name, (int8_t *)fname, strlen((int8_t *)directory_entries[i].file_name)) == 0)
+    *dentry = directory_entries[index];
+    return 0;
+  }
+  if (dir >= num_inodes || (index + 1) * sizeof(dentry_t) > inodes[dir].length_in_bytes)
+  {
+    return -1;
+  }
+  if (read_data(dir, index * sizeof(dentry_t), (uint8_t *)dentry, sizeof(dentry_t)) != sizeof(dentry_t))
+  {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Looks for a name in a directory the slow way, by reading every entry
+ */
+static int32_t fs_dir_scan(uint32_t dir, const char *name, uint32_t len, dentry_t *dentry)
+{
+  uint32_t i;
+  dentry_t d;
+  for (i = 0; fs_dir_entry(dir, i, &d) == 0; i++)
+  {
+    if (fs_name_match(d.file_name, name, len))
     {
-      // if the same filename, copy file info into the dentry output ptr
-      strcpy((int8_t *)dentry->file_name, (int8_t *)directory_entries[i].file_name);
-      dentry->file_type = directory_entries[i].file_type;
-      dentry->inode_number = directory_entries[i].inode_number;
-      memcpy(dentry->reserved, directory_entries[i].reserved, BYTES_RESERVED);
+      *dentry = d;
       return 0;
     }
   }
   return -1;
 }
 
+static uint32_t dcache_hashfn(uint32_t parent, const char *name, uint32_t len)
+{
+  uint32_t h = parent;
+  uint32_t i;
+  for (i = 0; i < len && i < MAX_FILE_NAME_LENGTH; i++)
+  {
+    h = h * 31 + (uint8_t)name[i];
+  }
+  return h % DCACHE_HASH_SIZE;
+}
+
+/**
+ * @brief Looks up one path component in a directory, going through the dentry cache
+ *
+ * @return int32_t 0 if found, -1 if the directory has no such entry
+ */
+static int32_t fs_dir_lookup(uint32_t dir, const char *name, uint32_t len, dentry_t *dentry)
+{
+  // can't be in any directory, and caching it would shadow its 32 char prefix
+  if (len > MAX_FILE_NAME_LENGTH)
+  {
+    return -1;
+  }
+
+  uint32_t h = dcache_hashfn(dir, name, len);
+  dcache_entry_t *e;
+  for (e = dcache_hash[h]; e; e = e->next)
+  {
+    if (e->parent == dir && fs_name_match(e->name, name, len))
+    {
+      dcache_stats.hits++;
+      if (e->negative)
+      {
+        dcache_stats.negative_hits++;
+        return -1;
+      }
+      *dentry = e->dentry;
+      return 0;
+    }
+  }
+
+  dcache_stats.misses++;
+  int32_t ret = fs_dir_scan(dir, name, len, dentry);
+
+  // recycle a slot, unlinking it from its old chain first
+  e = &dcache[dcache_victim];
+  dcache_victim = (dcache_victim + 1) % DCACHE_SIZE;
+  if (e->in_use)
+  {
+    dcache_entry_t **p = &dcache_hash[e->bucket];
+    while (*p && *p != e)
+    {
+      p = &(*p)->next;
+    }
+    if (*p)
+    {
+      *p = e->next;
+    }
+    dcache_stats.evictions++;
+  }
+
+  e->in_use = 1;
+  e->parent = dir;
+  memset(e->name, 0, MAX_FILE_NAME_LENGTH);
+  strncpy((int8_t *)e->name, (int8_t *)name, len < MAX_FILE_NAME_LENGTH ? len : MAX_FILE_NAME_LENGTH);
+  e->negative = (ret != 0);
+  if (ret == 0)
+  {
+    e->dentry = *dentry;
+  }
+  e->bucket = h;
+  e->next = dcache_hash[h];
+  dcache_hash[h] = e;
+  return ret;
+}
+
+/**
+ * @brief Drops every cached lookup, for when the directory tree underneath changes
+ */
+static void dcache_flush()
+{
+  memset(dcache, 0, sizeof(dcache));
+  memset(dcache_hash, 0, sizeof(dcache_hash));
+  dcache_victim = 0;
+}
+
+/**
+ * @brief Walks a normalized absolute path from the root
+ */
+static int32_t fs_walk(const char *path, dentry_t *dentry)
+{
+  uint32_t dir = FS_ROOT_INODE;
+
+  memset(dentry, 0, sizeof(dentry_t));
+  strcpy((int8_t *)dentry->file_name, (int8_t *)"/");
+  dentry->file_type = FILE_TYPE_DIR;
+  dentry->inode_number = FS_ROOT_INODE;
+
+  while (*path == '/' && path[1])
+  {
+    const char *comp = ++path;
+    while (*path && *path != '/')
+    {
+      path++;
+    }
+    if (dentry->file_type != FILE_TYPE_DIR)
+    {
+      return -ENOTDIR;
+    }
+    if (fs_dir_lookup(dir, comp, path - comp, dentry) != 0)
+    {
+      return -ENOENT;
+    }
+    dir = dentry->inode_number;
+  }
+  return 0;
+}
+
+int32_t fs_lookup_path(const uint8_t *path, dentry_t *dentry)
+{
+  char abs[PATH_MAX_LENGTH];
+  if (!path || !path[0])
+  {
+    return -ENOENT;
+  }
+  int32_t ret = vfs_normalize_path(vfs_cwd(), (const char *)path, abs);
+  if (ret < 0)
+  {
+    return ret;
+  }
+  return fs_walk(abs, dentry);
+}
+
+/*
+When successful, the first two calls fill in the dentry t
+block passed as their second argument with the file name, file
+type, and inode number for the file, then return 0
+*/
+uint32_t read_dentry_by_name(const uint8_t *fname, dentry_t *dentry)
+{
+  if (fs_lookup_path(fname, dentry) != 0)
+  {
+    return -1;
+  }
+  return 0;
+}
+
 uint32_t read_dentry_by_index(uint32_t index, dentry_t *dentry)
 {
   // index out of bounds?
@@ -131,7 +459,6 @@ uint32_t read_data(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t lengt
 
   uint32_t starting_block_idx = offset / FOUR_KB; // for instance, offset 4096 = block 1
   uint32_t offset_within_block = offset % FOUR_KB;
-  uint32_t ptr_to_blocks = filesys_start_address + (num_inodes + 1) * FOUR_KB;
 
   // let's handle the first block then all the later ones
   uint32_t remaining = FOUR_KB - offset_within_block;
@@ -140,15 +467,20 @@ uint32_t read_data(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t lengt
   {
     return -1;
   }
-  uint32_t ptr = ptr_to_blocks + translated_block * FOUR_KB;
   if (length <= remaining)
   {
-    memcpy(bufcopy, (void *)ptr + offset_within_block, length);
+    if (fs_read_data_block(translated_block, offset_within_block, bufcopy, length) == -1)
+    {
+      return -1;
+    }
     return oldlength;
   }
   else
   {
-    memcpy(bufcopy, (void *)ptr + offset_within_block, remaining);
+    if (fs_read_data_block(translated_block, offset_within_block, bufcopy, remaining) == -1)
+    {
+      return -1;
+    }
     length -= remaining;
     bufcopy += remaining;
     starting_block_idx++;
@@ -170,8 +502,10 @@ uint32_t read_data(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t lengt
       {
         return -1;
       }
-      ptr = ptr_to_blocks + translated_block * FOUR_KB;
-      memcpy(bufcopy, (void *)ptr, length);
+      if (fs_read_data_block(translated_block, 0, bufcopy, length) == -1)
+      {
+        return -1;
+      }
       return oldlength;
     }
     else
@@ -183,9 +517,11 @@ uint32_t read_data(uint32_t inode, uint32_t offset, uint8_t *buf, uint32_t lengt
       {
         return -1;
       }
-      ptr = ptr_to_blocks + translated_block * FOUR_KB;
-      memcpy(bufcopy, (void *)ptr, FOUR_KB);
-      ptr += FOUR_KB;
+      if (fs_read_data_block(translated_block, 0, bufcopy, FOUR_KB) == -1)
+      {
+        return -1;
+      }
+      bufcopy += FOUR_KB;
       length -= FOUR_KB;
     }
     starting_block_idx++;
@@ -197,33 +533,65 @@ int32_t get_file_size(uint32_t inode_num)
   return inodes[inode_num].length_in_bytes;
 }
 
-void init_filesystem(uint32_t filesystem_start_address)
+/**
+ * @brief Reads the boot block and the inodes into memory, through fs_read_block
+ */
+static void fs_load_metadata()
 {
-  // each one is 4 Bytes
-  num_directory_entries = *((uint32_t *)filesystem_start_address);
-  num_inodes = *((uint32_t *)(filesystem_start_address + 0x4));
-  num_data_blocks = *((uint32_t *)(filesystem_start_address + 0x8));
-
-  filesys_start_address = filesystem_start_address;
+  // each one is 4 Bytes, the fourth is the first reserved word
+  uint32_t counts[4];
+  fs_read_block(0, 0, counts, sizeof(counts));
+  num_directory_entries = counts[0];
+  num_inodes = counts[1];
+  num_data_blocks = counts[2];
+
+  // compressed images have the block map where the data blocks would start
+  fs_zmap_block = 0;
+  fs_zdata_block = 0;
+  if (counts[3] == FS_LZ4_MAGIC)
+  {
+    fs_zmap_block = num_inodes + 1;
+    fs_zdata_block = fs_zmap_block + (num_data_blocks * sizeof(fs_zmap_entry_t) + FOUR_KB - 1) / FOUR_KB;
+  }
+  fs_zcache_flush();
 
   // 12+52 = 64B later we have x amount of 64B entries, where x = # of directory entries
   int i;
   uint32_t offset = SIXTY_FOUR_BYTES;
   for (i = 0; i < num_directory_entries; i++)
   {
-    directory_entries[i] = *(dentry_t *)(filesystem_start_address + offset);
+    fs_read_block(0, offset, &directory_entries[i], sizeof(dentry_t));
     offset += SIXTY_FOUR_BYTES;
   }
 
-  offset = FOUR_KB;
-  // read in all the inodes
+  // read in all the inodes, one per block after the boot block
   for (i = 0; i < num_inodes; i++)
   {
-    inodes[i] = *(inode_block *)(filesystem_start_address + offset);
-    offset += FOUR_KB;
+    fs_read_block(i + 1, 0, &inodes[i], sizeof(inode_block));
   }
 
-  file_names_idx = 0;
+  dcache_flush();
+}
+
+void init_filesystem(uint32_t filesystem_start_address)
+{
+  filesys_start_address = filesystem_start_address;
+  filesys_dev = NULL;
+  fs_load_metadata();
+}
+
+int init_filesystem_blkdev(blkdev_t *dev)
+{
+  filesys_dev = dev;
+  bcache_buf_t *boot = bcache_read(dev, 0);
+  if (!boot)
+  {
+    filesys_dev = NULL;
+    return -1;
+  }
+  bcache_release(boot);
+  fs_load_metadata();
+  return 0;
 }
 
 // for handin
@@ -242,77 +610,49 @@ uint32_t read_data_by_filename(uint8_t *fname, uint8_t *buf, uint32_t length)
   return ret;
 }
 
-int32_t open_file(const uint8_t *filename)
+int32_t open_file(inode_t *inode, file_t *file)
 {
   return 0;
 }
-int32_t read_file(int32_t fd, void *buf, int32_t nbytes)
+int32_t read_file(file_t *file, void *buf, int32_t nbytes)
 {
-  if (fd < 0 || fd > 7)
-  {
-    return -1;
-  }
-
-  // reset the buf to null values
-  memset((uint8_t *)buf, 0, nbytes);
-
-  task *PCB_data = (task *)get_task();
-
-  // all we have is a file descriptor number but we need an inode to use read_data
-  // we can get that inode by checking what task we're using, since we know inode data
-  // is stored in the file descriptor array for that task
-
-  uint32_t inode_value = PCB_data->fds[fd].inode;
-  uint32_t offset_into_file = PCB_data->fds[fd].file_position;
-  uint32_t num_bytes_read = read_data(inode_value, offset_into_file, buf, nbytes);
-
-  // uint8_t buff[10];
-  // itoa(num_bytes_read, buff, 10);
-  // putc(buff[0]);
-  // putc(buff[1]);
-  // putc(buff[2]);
-  // putc(buff[3]);
-  // putc('\n');
-  // printf("%d %d %d\n", inode_value, offset_into_file, num_bytes_read);
-  // printf(buf);
-  // putc('\n');
+  // the open file knows its inode and where we are in it
+  uint32_t num_bytes_read = read_data(file->inode->ino, file->pos, buf, nbytes);
   if (num_bytes_read == -1)
   {
     return -1;
   }
 
   // increase file position
-  PCB_data->fds[fd].file_position += num_bytes_read;
+  file->pos += num_bytes_read;
   return num_bytes_read;
 }
-int32_t write_file(int32_t fd, const void *buf, int32_t nbytes)
+int32_t write_file(file_t *file, const void *buf, int32_t nbytes)
 {
   return -1; // read only fs
 }
-int32_t close_file(int32_t fd)
+int32_t close_file(inode_t *inode, file_t *file)
 {
   return 0;
 }
 
-int32_t open_dir(const uint8_t *filename)
+int32_t open_dir(inode_t *inode, file_t *file)
 {
   return 0;
 }
-int32_t read_dir(int32_t fd, void *buf, int32_t nbytes)
+int32_t read_dir(file_t *file, void *buf, int32_t nbytes)
 {
-  if (file_names_idx >= num_directory_entries)
+  // the directory this file was opened on, and where we are in it
+  dentry_t entry;
+  if (fs_dir_entry(file->inode->ino, file->pos, &entry) != 0)
   {
-    // if finished reading all the file names
-    file_names_idx = 0;
+    // finished reading all the file names
     return 0;
   }
-  // clear target buffer
-  int i;
-  for (i = 0; i < MAX_FILE_NAME_LENGTH; i++)
-  {
-    ((int8_t *)buf)[i] = '\0';
-  }
-  uint32_t length_of_file_name = strlen((int8_t*) directory_entries[file_names_idx].file_name);
+  // the name goes out zero padded to 32 bytes, buf is the user's so build it here
+  int8_t name[MAX_FILE_NAME_LENGTH];
+  memset(name, 0, MAX_FILE_NAME_LENGTH);
+  uint32_t length_of_file_name = strlen((int8_t*) entry.file_name);
 
   // if you copy more than 32 it will error out, not sure why since its not
   // in the ls source code but whatever, just limit it here
@@ -321,22 +661,170 @@ int32_t read_dir(int32_t fd, void *buf, int32_t nbytes)
     length_of_file_name = MAX_FILE_NAME_LENGTH;
   }
 
-  // int8_t buff[3];
-  // prints out length of the file name, used this to debug
-  // itoa(length_of_file_name, buff, 10);
-  // putc(buff[0]);
-  // putc(buff[1]);
-  // putc(buff[2]);
-
-  strncpy((int8_t *)buf, (int8_t *)&directory_entries[file_names_idx].file_name, length_of_file_name);
-  file_names_idx++;
+  strncpy(name, (int8_t *)entry.file_name, length_of_file_name);
+  if (nbytes < MAX_FILE_NAME_LENGTH)
+  {
+    length_of_file_name = length_of_file_name < nbytes ? length_of_file_name : nbytes;
+  }
+  if (__copy_to_user(buf, name, nbytes < MAX_FILE_NAME_LENGTH ? nbytes : MAX_FILE_NAME_LENGTH))
+  {
+    return -EFAULT;
+  }
+  file->pos++;
   return length_of_file_name;
 }
-int32_t write_dir(int32_t fd, const void *buf, int32_t nbytes)
+
+int32_t read_dir_entries(file_t *file, void *buf, uint32_t count)
+{
+  uint32_t filled = 0;
+  dentry_t entry;
+  while (fs_dir_entry(file->inode->ino, file->pos, &entry) == 0)
+  {
+    // names that fill all 32 bytes have no terminator in the image
+    uint32_t namelen = 0;
+    while (namelen < MAX_FILE_NAME_LENGTH && entry.file_name[namelen])
+    {
+      namelen++;
+    }
+    uint32_t size = (entry.file_type != FILE_TYPE_RTC && entry.inode_number < num_inodes)
+                        ? inodes[entry.inode_number].length_in_bytes
+                        : 0;
+    int32_t err = vfs_put_dirent(buf, count, &filled, entry.inode_number, entry.file_type, size,
+                                 (const char *)entry.file_name, namelen);
+    if (err == -EFAULT)
+    {
+      return err;
+    }
+    if (err != 0)
+    {
+      break;
+    }
+    file->pos++;
+  }
+
+  // there was an entry left but it didn't fit
+  if (filled == 0 && fs_dir_entry(file->inode->ino, file->pos, &entry) == 0)
+  {
+    return -EINVAL;
+  }
+  return filled;
+}
+
+int32_t write_dir(file_t *file, const void *buf, int32_t nbytes)
 {
   return -1; // read only fs
 }
-int32_t close_dir(int32_t fd)
+int32_t close_dir(inode_t *inode, file_t *file)
+{
+  return 0;
+}
+
+/*
+Glue between the VFS and the image. There is only one image, so every mount
+of ece391fs shows the same tree. VFS inodes for the image's inodes live in a
+table parallel to inodes[], the root directory (which has no inode in the
+image) gets its own
+*/
+static file_operations_t ece391fs_file_fops = {
+  .open = open_file,
+  .release = close_file,
+  .read = read_file,
+  .write = write_file,
+};
+
+static file_operations_t ece391fs_dir_fops = {
+  .open = open_dir,
+  .release = close_dir,
+  .read = read_dir,
+  .write = write_dir,
+  .getdents = read_dir_entries,
+};
+
+static int32_t ece391fs_lookup(inode_t *dir, const char *name, uint32_t len, inode_t **result);
+
+static inode_operations_t ece391fs_dir_iops = {
+  .lookup = ece391fs_lookup,
+};
+
+static inode_t ece391fs_inodes[64];
+static inode_t ece391fs_root;
+
+/**
+ * @brief Gets the VFS inode a directory entry points to. Device nodes (type 0)
+ * open whatever character device is registered under their name
+ */
+static int32_t ece391fs_iget(super_block_t *sb, dentry_t *dentry, inode_t **result)
 {
+  if (dentry->file_type == FILE_TYPE_RTC)
+  {
+    uint32_t namelen = 0;
+    while (namelen < MAX_FILE_NAME_LENGTH && dentry->file_name[namelen])
+    {
+      namelen++;
+    }
+    *result = vfs_chrdev_inode((const char *)dentry->file_name, namelen);
+    return *result ? 0 : -ENXIO;
+  }
+  if (dentry->inode_number >= num_inodes)
+  {
+    return -ENOENT;
+  }
+
+  inode_t *inode = &ece391fs_inodes[dentry->inode_number];
+  inode->ino = dentry->inode_number;
+  inode->type = dentry->file_type;
+  inode->size = inodes[dentry->inode_number].length_in_bytes;
+  inode->sb = sb;
+  inode->i_op = dentry->file_type == FILE_TYPE_DIR ? &ece391fs_dir_iops : NULL;
+  inode->f_op = dentry->file_type == FILE_TYPE_DIR ? &ece391fs_dir_fops : &ece391fs_file_fops;
+  *result = inode;
   return 0;
 }
+
+static int32_t ece391fs_lookup(inode_t *dir, const char *name, uint32_t len, inode_t **result)
+{
+  dentry_t dentry;
+  if (fs_dir_lookup(dir->ino, name, len, &dentry) != 0)
+  {
+    return -ENOENT;
+  }
+  return ece391fs_iget(dir->sb, &dentry, result);
+}
+
+/**
+ * @brief The image was loaded at boot. A block device name as source reloads
+ * it from that device first
+ */
+static int32_t ece391fs_mount(super_block_t *sb, const char *source)
+{
+  if (source)
+  {
+    blkdev_t *dev = blkdev_get(source);
+    if (!dev)
+    {
+      return -ENODEV;
+    }
+    if (init_filesystem_blkdev(dev) != 0)
+    {
+      return -EIO;
+    }
+  }
+  ece391fs_root.ino = FS_ROOT_INODE;
+  ece391fs_root.type = FILE_TYPE_DIR;
+  ece391fs_root.size = 0;
+  ece391fs_root.sb = sb;
+  ece391fs_root.i_op = &ece391fs_dir_iops;
+  ece391fs_root.f_op = &ece391fs_dir_fops;
+  sb->root = &ece391fs_root;
+  return 0;
+}
+
+static file_system_t ece391fs_type = {
+  .name = "ece391fs",
+  .mount = ece391fs_mount,
+};
+
+void ece391fs_init()
+{
+  vfs_register_fs(&ece391fs_type);
+}
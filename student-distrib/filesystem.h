@@ -1,6 +1,8 @@
 #ifndef FILESYS_H
 #define FILESYS_H
 #include "types.h"
+#include "drivers/block.h"
+#include "fs/vfs.h"
 
 #define MAX_FILE_NAME_LENGTH 32
 #define BYTES_RESERVED 24
@@ -32,6 +34,62 @@ typedef struct data_block {
   uint8_t data[BYTES_IN_A_DATA_BLOCK];
 } data_block;
 
+// directories. A subdirectory is a type 1 dentry whose inode holds packed
+// dentry_t records (see fstools/mkfs.c). The root directory is the list in the
+// boot block, it has no real inode so we give it this made-up number
+#define FILE_TYPE_RTC 0
+#define FILE_TYPE_DIR 1
+#define FILE_TYPE_FILE 2
+#define FS_ROOT_INODE 0xFFFFFFFF
+
+// dentry cache, maps (directory inode, name) to the dentry found there. Misses
+// are cached too (negative entries) so looking up a missing file doesn't
+// rescan the directory every time
+#define DCACHE_SIZE 128
+#define DCACHE_HASH_SIZE 64
+
+typedef struct dcache_entry {
+  uint32_t parent;                        ///< inode of the directory we looked in
+  uint8_t name[MAX_FILE_NAME_LENGTH];     ///< name we looked up (not NUL terminated if 32 long)
+  uint8_t in_use;                         ///< slot holds a cached lookup
+  uint8_t negative;                       ///< the name does not exist in parent
+  dentry_t dentry;                        ///< result of the lookup, if positive
+  uint32_t bucket;                        ///< hash bucket the entry is chained in
+  struct dcache_entry *next;              ///< hash chain
+} dcache_entry_t;
+
+typedef struct dcache_stats {
+  uint32_t hits;          ///< lookups answered by the cache
+  uint32_t negative_hits; ///< of those, how many were cached misses
+  uint32_t misses;        ///< lookups that had to scan the directory
+  uint32_t evictions;     ///< entries recycled to make room
+} dcache_stats_t;
+
+extern dcache_stats_t dcache_stats;
+
+// compressed images (mkfs -z). The boot block's first reserved word holds
+// FS_LZ4_MAGIC, and the data blocks are replaced by a block map (one
+// fs_zmap_entry_t per data block, padded to whole 4KB blocks) followed by the
+// LZ4 compressed blocks packed back to back. A block that doesn't shrink is
+// stored as is, with a length of 4KB. read_data decompresses blocks on demand
+// into a small cache of FS_ZCACHE_SIZE blocks
+#define FS_LZ4_MAGIC 0x345A4C46   // "FLZ4"
+#define FS_ZCACHE_SIZE 8
+
+typedef struct fs_zmap_entry {
+  uint32_t offset;  ///< byte offset of the block from the start of the compressed area
+  uint32_t length;  ///< compressed size, 4KB if stored uncompressed
+} fs_zmap_entry_t;
+
+typedef struct fs_zcache_stats {
+  uint32_t hits;          ///< data block reads served from the decompressed cache
+  uint32_t misses;        ///< blocks that had to be decompressed
+  uint32_t bytes_in;      ///< compressed bytes read from the image
+  uint32_t errors;        ///< blocks that failed to decompress
+} fs_zcache_stats_t;
+
+extern fs_zcache_stats_t fs_zcache_stats;
+
 // we can kinda cheat and see that we have 0x11 directory entries 0x40 inodes, and 0x3B data blocks
 // ie 17, 64 and 59
 extern uint32_t num_directory_entries;
@@ -47,7 +105,8 @@ dentry_t directory_entries[63];
 // they are randomly assigned though (not chronological)
 inode_block inodes[64]; 
 
-// defined in Appendix A
+// defined in Appendix A. read_dentry_by_name now takes a path, absolute or
+// relative to the working directory of the current task
 uint32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
 uint32_t read_dentry_by_index (uint32_t index, dentry_t* dentry);
 uint32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length);
@@ -56,32 +115,69 @@ uint32_t read_data_by_filename(uint8_t *fname, uint8_t *buf, uint32_t length);
 
 void init_filesystem(uint32_t filesystem_start_address);
 
-// for the syscalls
-int32_t open_file(const uint8_t* filename);
+/**
+ * @brief Mounts the image from a block device instead of the multiboot module.
+ * File data is then read through the buffer cache on demand
+ *
+ * @param dev device holding the image at sector 0
+ * @return int 0 on success, -1 if the boot block can't be read
+ */
+int init_filesystem_blkdev(blkdev_t *dev);
+
+/**
+ * @brief Registers the "ece391fs" filesystem type with the VFS. Mounting it
+ * shows the image loaded by init_filesystem / init_filesystem_blkdev
+ */
+void ece391fs_init();
+
+// file operations of regular files, see ece391fs_file_fops
+int32_t open_file(inode_t* inode, file_t* file);
 
 /* In the case of a file, data should be read to the end of the file or the 
 end of the buffer provided, whichever occurs
 sooner.*/
-int32_t read_file(int32_t fd, void* buf, int32_t nbytes);
+int32_t read_file(file_t* file, void* buf, int32_t nbytes);
 
-int32_t write_file(int32_t fd, const void* buf, int32_t nbytes);
-int32_t close_file(int32_t fd);
+int32_t write_file(file_t* file, const void* buf, int32_t nbytes);
+int32_t close_file(inode_t* inode, file_t* file);
 
-int32_t open_dir(const uint8_t* filename);
+int32_t open_dir(inode_t* inode, file_t* file);
 
 int32_t get_file_size(uint32_t inode_num);
 
-// index for the filenames
-uint32_t file_names_idx;
+/**
+ * @brief Resolves a path in the image one component at a time through the
+ * dentry cache. Doesn't look at the VFS mount table, use vfs_lookup for that
+ *
+ * @param path path, absolute or relative to the current task's working directory
+ * @param dentry filled in with the entry found. "/" gives a made-up dentry
+ * with inode FS_ROOT_INODE
+ * @return int32_t 0 on success, -ENOENT / -ENOTDIR / -ENAMETOOLONG on failure
+ */
+int32_t fs_lookup_path(const uint8_t *path, dentry_t *dentry);
+
+/**
+ * @brief Gets the index-th entry of a directory
+ *
+ * @param dir inode of the directory (FS_ROOT_INODE for the root)
+ * @return int32_t 0 on success, -1 past the last entry
+ */
+int32_t fs_dir_entry(uint32_t dir, uint32_t index, dentry_t *dentry);
+
 /*In the case of reads to the directory, only the filename should be provided 
 (as much as fits, or all 32 bytes), and
 subsequent reads should read from successive directory entries until the last 
 is reached, at which point read should
 repeatedly return 0. */
-int32_t read_dir(int32_t fd, void* buf, int32_t nbytes);
+int32_t read_dir(file_t* file, void* buf, int32_t nbytes);
 
+/**
+ * @brief getdents of a directory in the image, see sys_getdents. Shares the
+ * file position with read_dir
+ */
+int32_t read_dir_entries(file_t* file, void* buf, uint32_t count);
 
-int32_t write_dir(int32_t fd, const void* buf, int32_t nbytes);
-int32_t close_dir(int32_t fd);
+int32_t write_dir(file_t* file, const void* buf, int32_t nbytes);
+int32_t close_dir(inode_t* inode, file_t* file);
 
 #endif
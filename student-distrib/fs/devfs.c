@@ -0,0 +1,66 @@
+#include "vfs.h"
+#include "../lib.h"
+#include "../errno.h"
+
+// devfs has nothing of its own, its root directory lists the registered
+// character devices, so a new driver shows up in /dev as soon as it registers
+
+static int32_t devfs_lookup(inode_t *dir, const char *name, uint32_t len, inode_t **result) {
+  inode_t *inode = vfs_chrdev_inode(name, len);
+  if (!inode) {
+    return -ENOENT;
+  }
+  *result = inode;
+  return 0;
+}
+
+static int32_t devfs_getdents(file_t *file, void *buf, uint32_t count) {
+  uint32_t filled = 0;
+  inode_t *dev;
+  while ((dev = vfs_chrdev_at(file->pos)) != NULL) {
+    const char *name = (const char *)dev->private_data;
+    int32_t err = vfs_put_dirent(buf, count, &filled, dev->ino, dev->type, 0, name, strlen((int8_t *)name));
+    if (err == -EFAULT) {
+      return err;
+    }
+    if (err != 0) {
+      break;
+    }
+    file->pos++;
+  }
+  // there was an entry left but it didn't fit
+  if (filled == 0 && dev) {
+    return -EINVAL;
+  }
+  return filled;
+}
+
+static inode_operations_t devfs_dir_iops = {
+  .lookup = devfs_lookup,
+};
+
+static file_operations_t devfs_dir_fops = {
+  .getdents = devfs_getdents,
+};
+
+static inode_t devfs_root;
+
+static int32_t devfs_mount(super_block_t *sb, const char *source) {
+  devfs_root.ino = 0;
+  devfs_root.type = DT_DIR;
+  devfs_root.size = 0;
+  devfs_root.sb = sb;
+  devfs_root.i_op = &devfs_dir_iops;
+  devfs_root.f_op = &devfs_dir_fops;
+  sb->root = &devfs_root;
+  return 0;
+}
+
+static file_system_t devfs_type = {
+  .name = "devfs",
+  .mount = devfs_mount,
+};
+
+void devfs_init() {
+  vfs_register_fs(&devfs_type);
+}
@@ -0,0 +1,81 @@
+#include "lz4.h"
+#include "../lib.h"
+
+// https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+// Each sequence is a token (literal length << 4 | match length - 4), the
+// literals, then a 2 byte little endian match offset and the rest of the
+// match length. Lengths of 15 continue in the following bytes, each 255
+// meaning "keep adding". The last sequence has literals only
+#define LZ4_MIN_MATCH 4
+
+/**
+ * @brief Reads the extra length bytes after a length nibble of 15
+ * @return int 0 on success, -1 if the input ends first
+ */
+static int lz4_read_length(const uint8_t **ip, const uint8_t *iend, uint32_t *len) {
+  uint8_t b;
+  do {
+    if (*ip >= iend) {
+      return -1;
+    }
+    b = *(*ip)++;
+    *len += b;
+  } while (b == 255);
+  return 0;
+}
+
+int32_t lz4_decompress_block(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len) {
+  const uint8_t *ip = src;
+  const uint8_t *iend = src + src_len;
+  uint8_t *op = dst;
+  uint8_t *oend = dst + dst_len;
+
+  while (ip < iend) {
+    uint32_t token = *ip++;
+
+    // literals
+    uint32_t len = token >> 4;
+    if (len == 15 && lz4_read_length(&ip, iend, &len) != 0) {
+      return -1;
+    }
+    if (len > (uint32_t)(iend - ip) || len > (uint32_t)(oend - op)) {
+      return -1;
+    }
+    memcpy(op, ip, len);
+    op += len;
+    ip += len;
+    if (ip == iend) {
+      // the last sequence stops after its literals
+      break;
+    }
+
+    // match
+    if (iend - ip < 2) {
+      return -1;
+    }
+    uint32_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > (uint32_t)(op - dst)) {
+      return -1;
+    }
+    len = token & 0xF;
+    if (len == 15 && lz4_read_length(&ip, iend, &len) != 0) {
+      return -1;
+    }
+    len += LZ4_MIN_MATCH;
+    if (len > (uint32_t)(oend - op)) {
+      return -1;
+    }
+    // a match closer than its length repeats a pattern. Everything between
+    // match and op is whole periods of it, so copying that much at a time
+    // never overlaps and doubles the chunk every round
+    const uint8_t *match = op - offset;
+    while (len > 0) {
+      uint32_t chunk = (uint32_t)(op - match) < len ? (uint32_t)(op - match) : len;
+      memcpy(op, match, chunk);
+      op += chunk;
+      len -= chunk;
+    }
+  }
+  return op - dst;
+}
@@ -0,0 +1,24 @@
+/**
+ * @file lz4.h
+ * @brief Decoder for the LZ4 block format (no frame header, no checksums).
+ * Compressed filesystem images store each 4KB data block this way, see
+ * fstools/mkfs.c for the encoder
+ */
+#ifndef LZ4_H
+#define LZ4_H
+
+#include "../types.h"
+
+/**
+ * @brief Decompresses one LZ4 block. Never reads past src + src_len or writes
+ * past dst + dst_len, however corrupt the input is
+ *
+ * @param src compressed data
+ * @param src_len size of the compressed data
+ * @param dst output buffer
+ * @param dst_len size of the output buffer
+ * @return int32_t number of bytes written to dst, or -1 if the input is malformed
+ */
+int32_t lz4_decompress_block(const uint8_t *src, uint32_t src_len, uint8_t *dst, uint32_t dst_len);
+
+#endif
@@ -0,0 +1,240 @@
+#include "pipe.h"
+#include "../lib.h"
+#include "../task.h"
+#include "../errno.h"
+#include "../mm/kmalloc.h"
+#include "../mm/uaccess.h"
+
+static int32_t pipe_read(file_t *file, void *buf, int32_t nbytes);
+static int32_t pipe_write(file_t *file, const void *buf, int32_t nbytes);
+static int32_t pipe_release(inode_t *inode, file_t *file);
+
+static file_operations_t pipe_fops = {
+  .read = pipe_read,
+  .write = pipe_write,
+  .release = pipe_release,
+};
+
+static void pipe_free(pipe_t *p) {
+  pipe_page_t *pg, *next;
+  for (pg = p->first; pg; pg = next) {
+    next = pg->next;
+    kfree(pg);
+  }
+  if (p->spare) {
+    kfree(p->spare);
+  }
+  kfree(p);
+}
+
+// Everything that looks at or changes the counters runs with interrupts off,
+// which on one CPU is all the locking the two ends need. Copying stops at a
+// page boundary, so each copy touches one page
+
+// a page for the writer, the spare if there is one
+static pipe_page_t *pipe_page_get(pipe_t *p) {
+  pipe_page_t *pg = p->spare;
+  if (pg) {
+    p->spare = NULL;
+    return pg;
+  }
+  return kmalloc(sizeof(pipe_page_t));
+}
+
+// keeps one drained page around, so a pipe that's read as fast as it's
+// written doesn't go to kmalloc for every page
+static void pipe_page_put(pipe_t *p, pipe_page_t *pg) {
+  if (p->spare) {
+    kfree(pg);
+  } else {
+    p->spare = pg;
+  }
+}
+
+static int32_t pipe_read(file_t *file, void *buf, int32_t nbytes) {
+  pipe_t *p = (pipe_t *)file->private_data;
+  int32_t done = 0, ret;
+  uint32_t flags;
+
+  if (nbytes == 0) {
+    return 0;
+  }
+  cli_and_save(flags);
+  // from now on the writer waits for us instead of growing the pipe
+  p->reading = 1;
+  // empty with no writers left is the end of the pipe
+  wait_event(&p->rd_wait, p->head != p->tail || p->writers == 0, ret);
+  if (ret < 0) {
+    restore_flags(flags);
+    return ret;
+  }
+  while (done < nbytes && p->tail != p->head) {
+    uint32_t off = p->tail % PIPE_PAGE_SIZE;
+    uint32_t n = PIPE_PAGE_SIZE - off;
+    if (n > p->head - p->tail) {
+      n = p->head - p->tail;
+    }
+    if (n > (uint32_t)(nbytes - done)) {
+      n = nbytes - done;
+    }
+    if (__copy_to_user((uint8_t *)buf + done, p->first->data + off, n)) {
+      if (!done) {
+        done = -EFAULT;
+      }
+      break;
+    }
+    p->tail += n;
+    done += n;
+    // that page is drained, the writer is on the next one (or will start one)
+    if (p->tail % PIPE_PAGE_SIZE == 0) {
+      pipe_page_t *pg = p->first;
+      p->first = pg->next;
+      if (!p->first) {
+        p->last = NULL;
+      }
+      pipe_page_put(p, pg);
+    }
+  }
+  wake_up(&p->wr_wait);
+  restore_flags(flags);
+  return done;
+}
+
+static int32_t pipe_write(file_t *file, const void *buf, int32_t nbytes) {
+  pipe_t *p = (pipe_t *)file->private_data;
+  int32_t done = 0, ret = 0;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  while (done < nbytes) {
+    // nobody has read yet: the reader may be the next pipeline stage, which
+    // only starts once we're done, so waiting for room would never end
+    wait_event(&p->wr_wait, p->head - p->tail < PIPE_SIZE || !p->reading || p->readers == 0, ret);
+    if (ret < 0) {
+      break;
+    }
+    if (p->readers == 0) {
+      ret = -EPIPE;
+      break;
+    }
+    // nobody to wait for, so past the cap all we can do is fail
+    uint32_t limit = p->reading ? PIPE_SIZE : PIPE_UNREAD_SIZE;
+    if (p->head - p->tail >= limit) {
+      ret = -ENOMEM;
+      break;
+    }
+    pipe_page_t *pg = p->last;
+    uint32_t off = p->head % PIPE_PAGE_SIZE;
+    uint32_t n = PIPE_PAGE_SIZE - off;
+    if (n > limit - (p->head - p->tail)) {
+      n = limit - (p->head - p->tail);
+    }
+    if (n > (uint32_t)(nbytes - done)) {
+      n = nbytes - done;
+    }
+    // head is at a page boundary, the last page is full (or there is none)
+    if (off == 0 && !(pg = pipe_page_get(p))) {
+      ret = -ENOMEM;
+      break;
+    }
+    if (__copy_from_user(pg->data + off, (const uint8_t *)buf + done, n)) {
+      if (off == 0) {
+        pipe_page_put(p, pg);
+      }
+      ret = -EFAULT;
+      break;
+    }
+    // only queued once it has something in it
+    if (off == 0) {
+      pg->next = NULL;
+      if (p->last) {
+        p->last->next = pg;
+      } else {
+        p->first = pg;
+      }
+      p->last = pg;
+    }
+    p->head += n;
+    done += n;
+    // a reader can start on this while we wait for more room
+    wake_up(&p->rd_wait);
+  }
+  restore_flags(flags);
+  return done ? done : ret;
+}
+
+static int32_t pipe_release(inode_t *inode, file_t *file) {
+  pipe_t *p = (pipe_t *)file->private_data;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  if (file->flags & FD_READ_PERMS) {
+    p->readers--;
+  } else {
+    p->writers--;
+  }
+  // the other end sees EOF or EPIPE
+  wake_up(&p->rd_wait);
+  wake_up(&p->wr_wait);
+  if (p->readers == 0 && p->writers == 0) {
+    pipe_free(p);
+  }
+  restore_flags(flags);
+  return 0;
+}
+
+int32_t sys_pipe(int32_t *fds) {
+  task *t = get_task_in_running_terminal();
+  pipe_t *p;
+  file_t *rd, *wr;
+  int32_t kfds[2], ret;
+
+  if (!access_ok(fds, sizeof(kfds))) {
+    return -EFAULT;
+  }
+  if (!(p = kmalloc(sizeof(pipe_t)))) {
+    return -ENOMEM;
+  }
+  memset(p, 0, sizeof(pipe_t));
+  wait_queue_init(&p->rd_wait);
+  wait_queue_init(&p->wr_wait);
+  p->inode.type = DT_FIFO;
+  p->inode.f_op = &pipe_fops;
+  p->inode.private_data = p;
+
+  if ((ret = vfs_open_inode(&p->inode, FD_READ_PERMS, &rd)) < 0) {
+    kfree(p);
+    return ret;
+  }
+  rd->private_data = p;
+  p->readers = 1;
+  if ((ret = vfs_open_inode(&p->inode, FD_WRITE_PERMS, &wr)) < 0) {
+    vfs_file_put(rd);
+    return ret;
+  }
+  wr->private_data = p;
+  p->writers = 1;
+
+  if ((kfds[0] = vfs_fd_install(t, rd)) < 0) {
+    ret = kfds[0];
+    goto fail;
+  }
+  if ((kfds[1] = vfs_fd_install(t, wr)) < 0) {
+    t->files[kfds[0]] = NULL;
+    ret = kfds[1];
+    goto fail;
+  }
+  if (copy_to_user(fds, kfds, sizeof(kfds))) {
+    t->files[kfds[0]] = NULL;
+    t->files[kfds[1]] = NULL;
+    ret = -EFAULT;
+    goto fail;
+  }
+  return 0;
+
+fail:
+  // dropping both ends frees the pipe
+  vfs_file_put(rd);
+  vfs_file_put(wr);
+  return ret;
+}
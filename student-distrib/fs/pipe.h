@@ -0,0 +1,57 @@
+/**
+ * @file pipe.h
+ * @brief Pipes. A pipe is a queue of page sized buffers: the writer fills the
+ * page at the head, the reader drains the page at the tail, and a page is
+ * handed from one to the other whole, so data is copied once on the way in
+ * and once on the way out. Pages are allocated as the pipe fills and freed
+ * as it drains. Once somebody has read from the pipe, writers sleep while it
+ * holds PIPE_SIZE until a reader makes room. Before that it grows up to
+ * PIPE_UNREAD_SIZE, and writes past that fail with -ENOMEM: the shell runs
+ * "a | b" one stage after the other, so b can't start reading until a has
+ * written everything, and waiting for it would never end.
+ * Readers sleep while the pipe is empty and somebody can still write to it.
+ */
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "vfs.h"
+#include "../wait.h"
+
+#define PIPE_PAGE_SIZE		4096
+#define PIPE_MAX_PAGES		16		///< most a pipe holds once it's being read, 64KB
+#define PIPE_SIZE			(PIPE_PAGE_SIZE * PIPE_MAX_PAGES)
+#define PIPE_UNREAD_SIZE	(PIPE_SIZE * 16)	///< most a pipe nobody has read yet holds, 1MB
+
+typedef struct pipe_page {
+	struct pipe_page *next;			///< the page written after this one
+	uint8_t data[PIPE_PAGE_SIZE];
+} pipe_page_t;
+
+/**
+ *	Both ends of a pipe. Counters only ever count up, so head - tail is how
+ *	much is in the pipe and pos % PIPE_PAGE_SIZE is where a byte lives in its
+ *	page. The queue has a page for every one that head and tail span
+ */
+typedef struct pipe {
+	pipe_page_t *first;				///< page tail is in, NULL if the pipe has none
+	pipe_page_t *last;				///< page head is in
+	pipe_page_t *spare;				///< a drained page kept for the next one the writer needs
+	uint32_t head;					///< bytes written
+	uint32_t tail;					///< bytes read
+	uint32_t reading;				///< somebody has called read, so writers can wait for room
+	uint32_t readers;				///< open read ends
+	uint32_t writers;				///< open write ends
+	wait_queue_t rd_wait;			///< readers waiting for data
+	wait_queue_t wr_wait;			///< writers waiting for room
+	inode_t inode;					///< both ends are opens of this
+} pipe_t;
+
+/**
+ * @brief Makes a pipe and puts its read end in fds[0], write end in fds[1]
+ * https://man7.org/linux/man-pages/man2/pipe.2.html
+ * @param fds user array of two ints
+ * @return int32_t 0, -EFAULT, -EMFILE, -ENFILE or -ENOMEM
+ */
+int32_t sys_pipe(int32_t *fds);
+
+#endif
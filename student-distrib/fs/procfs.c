@@ -0,0 +1,173 @@
+#include "procfs.h"
+#include "vfs.h"
+#include "../lib.h"
+#include "../errno.h"
+#include "../libc/sys/types.h"
+#include "../mm/kmalloc.h"
+#include "../mm/uaccess.h"
+
+// like devfs, procfs is one directory of files that other code registers.
+// Each open gets its own kmalloc'd copy of the text
+
+typedef struct procfs_entry {
+  char name[VFS_NAME_LEN];
+  procfs_show_t show;
+  inode_t inode;
+} procfs_entry_t;
+
+static procfs_entry_t procfs_entries[PROCFS_MAX_FILES];
+static uint32_t procfs_num_entries = 0;
+
+void proc_puts(proc_buf_t *pb, const char *s) {
+  while (*s && pb->len < pb->size) {
+    pb->buf[pb->len++] = *s++;
+  }
+}
+
+void proc_putpad(proc_buf_t *pb, const char *s, uint32_t width) {
+  uint32_t len = strlen((int8_t *)s);
+  proc_puts(pb, s);
+  while (len++ < width) {
+    proc_puts(pb, " ");
+  }
+}
+
+void proc_putnum(proc_buf_t *pb, uint64_t value, uint32_t width) {
+  int8_t num[24];
+  uint32_t len;
+  itoa64(value, num);
+  for (len = strlen(num); len < width; len++) {
+    proc_puts(pb, " ");
+  }
+  proc_puts(pb, (char *)num);
+}
+
+static int32_t procfs_open(inode_t *inode, file_t *file) {
+  procfs_entry_t *e = (procfs_entry_t *)inode->private_data;
+  proc_buf_t *pb = kmalloc(sizeof(proc_buf_t) + PROCFS_FILE_SIZE);
+  if (!pb) {
+    return -ENOMEM;
+  }
+  pb->buf = (char *)(pb + 1);
+  pb->len = 0;
+  pb->size = PROCFS_FILE_SIZE;
+  e->show(pb);
+  file->private_data = pb;
+  return 0;
+}
+
+static int32_t procfs_release(inode_t *inode, file_t *file) {
+  kfree(file->private_data);
+  return 0;
+}
+
+static int32_t procfs_read(file_t *file, void *buf, int32_t nbytes) {
+  proc_buf_t *pb = (proc_buf_t *)file->private_data;
+  uint32_t n;
+  if (file->pos >= pb->len) {
+    return 0;
+  }
+  n = pb->len - file->pos;
+  if (n > (uint32_t)nbytes) {
+    n = nbytes;
+  }
+  if (__copy_to_user(buf, pb->buf + file->pos, n)) {
+    return -EFAULT;
+  }
+  file->pos += n;
+  return n;
+}
+
+static file_operations_t procfs_file_fops = {
+  .open = procfs_open,
+  .release = procfs_release,
+  .read = procfs_read,
+};
+
+static int32_t procfs_lookup(inode_t *dir, const char *name, uint32_t len, inode_t **result) {
+  uint32_t i;
+  for (i = 0; i < procfs_num_entries; i++) {
+    procfs_entry_t *e = &procfs_entries[i];
+    if (strlen((int8_t *)e->name) == len && strncmp((int8_t *)e->name, (int8_t *)name, len) == 0) {
+      *result = &e->inode;
+      return 0;
+    }
+  }
+  return -ENOENT;
+}
+
+static int32_t procfs_getdents(file_t *file, void *buf, uint32_t count) {
+  uint32_t filled = 0;
+  while (file->pos < procfs_num_entries) {
+    procfs_entry_t *e = &procfs_entries[file->pos];
+    int32_t err = vfs_put_dirent(buf, count, &filled, e->inode.ino, DT_REG, 0, e->name, strlen((int8_t *)e->name));
+    if (err == -EFAULT) {
+      return err;
+    }
+    if (err != 0) {
+      break;
+    }
+    file->pos++;
+  }
+  // there was an entry left but it didn't fit
+  if (filled == 0 && file->pos < procfs_num_entries) {
+    return -EINVAL;
+  }
+  return filled;
+}
+
+static inode_operations_t procfs_dir_iops = {
+  .lookup = procfs_lookup,
+};
+
+static file_operations_t procfs_dir_fops = {
+  .getdents = procfs_getdents,
+};
+
+static inode_t procfs_root;
+static super_block_t *procfs_sb = NULL;
+
+int32_t procfs_register(const char *name, procfs_show_t show) {
+  procfs_entry_t *e;
+  if (procfs_num_entries == PROCFS_MAX_FILES) {
+    return -ENOMEM;
+  }
+  e = &procfs_entries[procfs_num_entries];
+  strncpy((int8_t *)e->name, (int8_t *)name, VFS_NAME_LEN - 1);
+  e->name[VFS_NAME_LEN - 1] = '\0';
+  e->show = show;
+  e->inode.ino = procfs_num_entries + 1;
+  e->inode.type = DT_REG;
+  e->inode.size = 0; // not known until it's generated
+  e->inode.sb = procfs_sb;
+  e->inode.i_op = NULL;
+  e->inode.f_op = &procfs_file_fops;
+  e->inode.private_data = e;
+  procfs_num_entries++;
+  return 0;
+}
+
+static int32_t procfs_mount(super_block_t *sb, const char *source) {
+  uint32_t i;
+  procfs_sb = sb;
+  for (i = 0; i < procfs_num_entries; i++) {
+    procfs_entries[i].inode.sb = sb;
+  }
+  procfs_root.ino = 0;
+  procfs_root.type = DT_DIR;
+  procfs_root.size = 0;
+  procfs_root.sb = sb;
+  procfs_root.i_op = &procfs_dir_iops;
+  procfs_root.f_op = &procfs_dir_fops;
+  sb->root = &procfs_root;
+  return 0;
+}
+
+static file_system_t procfs_type = {
+  .name = "procfs",
+  .mount = procfs_mount,
+};
+
+void procfs_init() {
+  vfs_register_fs(&procfs_type);
+}
@@ -0,0 +1,54 @@
+/**
+ * @file procfs.h
+ * @brief A read-only filesystem of generated text files, mounted on /proc.
+ * A subsystem registers a name and a function that writes the file's
+ * contents. The text is generated once when the file is opened, so one
+ * open sees a consistent snapshot however it's read.
+ */
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include "../types.h"
+
+#define PROCFS_MAX_FILES 	8		///< files in /proc
+#define PROCFS_FILE_SIZE 	4096	///< longest a generated file can be
+
+/**
+ *	Where a show function writes. Output past size is dropped
+ */
+typedef struct proc_buf {
+	char *buf;
+	uint32_t len;
+	uint32_t size;
+} proc_buf_t;
+
+typedef void (*procfs_show_t)(proc_buf_t *pb);
+
+/**
+ * @brief Registers the procfs filesystem type
+ */
+void procfs_init();
+
+/**
+ * @brief Adds /proc/name, whose contents are whatever show writes
+ * @return int32_t 0 on success, -ENOMEM if /proc is full
+ */
+int32_t procfs_register(const char *name, procfs_show_t show);
+
+/**
+ * @brief Appends a string
+ */
+void proc_puts(proc_buf_t *pb, const char *s);
+
+/**
+ * @brief Appends a number in decimal, right aligned in width columns
+ * (0 for no padding)
+ */
+void proc_putnum(proc_buf_t *pb, uint64_t value, uint32_t width);
+
+/**
+ * @brief Appends s, padded with spaces to width columns
+ */
+void proc_putpad(proc_buf_t *pb, const char *s, uint32_t width);
+
+#endif
@@ -0,0 +1,78 @@
+#include "signalfd.h"
+#include "../lib.h"
+#include "../task.h"
+#include "../signal.h"
+#include "../errno.h"
+#include "../mm/uaccess.h"
+
+static int32_t signalfd_read(file_t *file, void *buf, int32_t nbytes);
+
+static file_operations_t signalfd_fops = {
+  .read = signalfd_read,
+};
+
+// every signalfd is an open of this, the mask is in file->private_data
+static inode_t signalfd_inode = {
+  .type = DT_CHR,
+  .f_op = &signalfd_fops,
+};
+
+// reads the signals of whoever reads, like sigpending. Waits for one, then
+// takes as many as fit in buf
+static int32_t signalfd_read(file_t *file, void *buf, int32_t nbytes) {
+  task *t = &tasks[get_task()->pid];
+  sigset_t mask = (sigset_t)file->private_data;
+  siginfo_t info;
+  int32_t done = 0, ret;
+  uint32_t flags;
+
+  if (nbytes < (int32_t)sizeof(siginfo_t)) {
+    return -EINVAL;
+  }
+  cli_and_save(flags);
+  wait_event(&t->signal_wait, t->pending_signals & mask, ret);
+  if (ret < 0) {
+    restore_flags(flags);
+    return ret;
+  }
+  while (nbytes - done >= (int32_t)sizeof(siginfo_t) && (t->pending_signals & mask)) {
+    signal_dequeue(t, ffs(t->pending_signals & mask) - 1, &info);
+    if (__copy_to_user((uint8_t *)buf + done, &info, sizeof(siginfo_t))) {
+      if (!done) {
+        done = -EFAULT;
+      }
+      break;
+    }
+    done += sizeof(siginfo_t);
+  }
+  restore_flags(flags);
+  return done;
+}
+
+int32_t sys_signalfd(int32_t fd, uint32_t mask) {
+  task *t = get_task_in_running_terminal();
+  file_t *file;
+  int32_t ret;
+
+  sigdelset(&mask, SIGKILL);
+  sigdelset(&mask, SIGSTOP);
+  if (fd != -1) {
+    if (!(file = vfs_fd_get(t, fd))) {
+      return -EBADF;
+    }
+    if (file->f_op != &signalfd_fops) {
+      return -EINVAL;
+    }
+    file->private_data = (void *)mask;
+    return fd;
+  }
+
+  if ((ret = vfs_open_inode(&signalfd_inode, FD_READ_PERMS, &file)) < 0) {
+    return ret;
+  }
+  file->private_data = (void *)mask;
+  if ((fd = vfs_fd_install(t, file)) < 0) {
+    vfs_file_put(file);
+  }
+  return fd;
+}
@@ -0,0 +1,24 @@
+/**
+ * @file signalfd.h
+ * @brief Signals read from a file descriptor. A read returns the siginfo_t of
+ * pending signals in the fd's mask, taking them like delivery would but
+ * without running a handler, so an event loop can wait for signals with the
+ * rest of its input. The signals should be blocked with sigprocmask, or they
+ * may be delivered to a handler first.
+ */
+#ifndef SIGNALFD_H
+#define SIGNALFD_H
+
+#include "vfs.h"
+
+/**
+ * @brief Makes a signalfd for the signals in mask, or changes the mask of
+ * the signalfd fd. SIGKILL and SIGSTOP are never read
+ * https://man7.org/linux/man-pages/man2/signalfd.2.html
+ * @param fd -1 for a new one
+ * @return int32_t the fd, -EBADF, -EINVAL if fd isn't a signalfd, -EMFILE,
+ * -ENFILE
+ */
+int32_t sys_signalfd(int32_t fd, uint32_t mask);
+
+#endif
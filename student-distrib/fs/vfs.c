@@ -0,0 +1,592 @@
+#include "vfs.h"
+#include "../lib.h"
+#include "../task.h"
+#include "../errno.h"
+#include "../mm/kmalloc.h"
+#include "../mm/uaccess.h"
+#include "../elf.h"
+
+/**
+ *	A registered character device
+ */
+typedef struct s_vfs_chrdev {
+  char name[VFS_NAME_LEN + 1];
+  inode_t inode;
+} vfs_chrdev_t;
+
+/**
+ *	An entry of the mount table
+ */
+typedef struct s_vfs_mount {
+  uint8_t in_use;
+  char path[PATH_MAX_LENGTH];   ///< normalized absolute mount point
+  uint32_t path_len;
+  super_block_t sb;
+} vfs_mount_t;
+
+static file_t vfs_files[VFS_MAX_FILES];
+static file_system_t *vfs_filesystems[VFS_MAX_FILESYSTEMS];
+static vfs_mount_t vfs_mounts[VFS_MAX_MOUNTS];
+static vfs_chrdev_t vfs_chrdevs[VFS_MAX_CHRDEVS];
+static uint32_t vfs_num_chrdevs = 0;
+
+void vfs_init() {
+  memset(vfs_files, 0, sizeof(vfs_files));
+  memset(vfs_filesystems, 0, sizeof(vfs_filesystems));
+  memset(vfs_mounts, 0, sizeof(vfs_mounts));
+  memset(vfs_chrdevs, 0, sizeof(vfs_chrdevs));
+  vfs_num_chrdevs = 0;
+}
+
+int32_t vfs_register_fs(file_system_t *fs) {
+  int i;
+  for (i = 0; i < VFS_MAX_FILESYSTEMS; i++) {
+    if (!vfs_filesystems[i]) {
+      vfs_filesystems[i] = fs;
+      return 0;
+    }
+  }
+  return -ENOMEM;
+}
+
+static file_system_t *vfs_get_fs(const char *name) {
+  int i;
+  for (i = 0; i < VFS_MAX_FILESYSTEMS; i++) {
+    if (vfs_filesystems[i] && strncmp((int8_t *)vfs_filesystems[i]->name, (int8_t *)name, VFS_NAME_LEN) == 0) {
+      return vfs_filesystems[i];
+    }
+  }
+  return NULL;
+}
+
+inode_t *vfs_chrdev_inode(const char *name, uint32_t len) {
+  uint32_t i;
+  if (len > VFS_NAME_LEN) {
+    return NULL;
+  }
+  for (i = 0; i < vfs_num_chrdevs; i++) {
+    if (strncmp((int8_t *)vfs_chrdevs[i].name, (int8_t *)name, len) == 0 && vfs_chrdevs[i].name[len] == '\0') {
+      return &vfs_chrdevs[i].inode;
+    }
+  }
+  return NULL;
+}
+
+inode_t *vfs_chrdev_at(uint32_t index) {
+  return index < vfs_num_chrdevs ? &vfs_chrdevs[index].inode : NULL;
+}
+
+int32_t vfs_register_chrdev(const char *name, file_operations_t *fops) {
+  uint32_t len = strlen((int8_t *)name);
+  if (len == 0 || len > VFS_NAME_LEN) {
+    return -EINVAL;
+  }
+  if (vfs_chrdev_inode(name, len)) {
+    return -EEXIST;
+  }
+  if (vfs_num_chrdevs == VFS_MAX_CHRDEVS) {
+    return -ENOMEM;
+  }
+  vfs_chrdev_t *dev = &vfs_chrdevs[vfs_num_chrdevs];
+  strcpy((int8_t *)dev->name, (int8_t *)name);
+  dev->inode.ino = vfs_num_chrdevs;
+  dev->inode.type = DT_CHR;
+  dev->inode.size = 0;
+  dev->inode.sb = NULL;
+  dev->inode.i_op = NULL;
+  dev->inode.f_op = fops;
+  dev->inode.private_data = dev->name;
+  vfs_num_chrdevs++;
+  return 0;
+}
+
+int32_t vfs_normalize_path(const char *cwd, const char *path, char *out) {
+  uint32_t out_len = 0;
+  int pass;
+  out[0] = '\0';
+
+  // first walk the working directory (for relative paths), then the path itself
+  for (pass = 0; pass < 2; pass++) {
+    const char *p = pass == 0 ? cwd : path;
+    if (pass == 0 && (path[0] == '/' || !cwd)) {
+      continue;
+    }
+    while (*p) {
+      while (*p == '/') {
+        p++;
+      }
+      const char *comp = p;
+      while (*p && *p != '/') {
+        p++;
+      }
+      uint32_t len = p - comp;
+      if (len == 0 || (len == 1 && comp[0] == '.')) {
+        continue;
+      }
+      if (len == 2 && comp[0] == '.' && comp[1] == '.') {
+        // drop the last component, ".." of the root is the root
+        while (out_len > 0 && out[out_len - 1] != '/') {
+          out_len--;
+        }
+        if (out_len > 0) {
+          out_len--;
+        }
+        out[out_len] = '\0';
+        continue;
+      }
+      if (out_len + 1 + len >= PATH_MAX_LENGTH) {
+        return -ENAMETOOLONG;
+      }
+      out[out_len++] = '/';
+      memcpy(out + out_len, comp, len);
+      out_len += len;
+      out[out_len] = '\0';
+    }
+  }
+
+  if (out_len == 0) {
+    strcpy((int8_t *)out, (int8_t *)"/");
+  }
+  return 0;
+}
+
+const char *vfs_cwd() {
+  task *t = get_task();
+  return (t && t->wd) ? t->wd : "/";
+}
+
+/**
+ * @brief Finds the mount an absolute path lives in: the longest mount point
+ * that is the path itself or a whole-component prefix of it
+ *
+ * @param rest set to the part of the path below the mount point ("" or "/...")
+ */
+static vfs_mount_t *vfs_find_mount(const char *abs, const char **rest) {
+  vfs_mount_t *best = NULL;
+  int i;
+  for (i = 0; i < VFS_MAX_MOUNTS; i++) {
+    vfs_mount_t *m = &vfs_mounts[i];
+    if (!m->in_use || (best && m->path_len <= best->path_len)) {
+      continue;
+    }
+    // "/" is a prefix of everything
+    if (m->path_len == 1) {
+      best = m;
+      continue;
+    }
+    if (strncmp((int8_t *)m->path, (int8_t *)abs, m->path_len) == 0 &&
+        (abs[m->path_len] == '\0' || abs[m->path_len] == '/')) {
+      best = m;
+    }
+  }
+  if (best) {
+    *rest = best->path_len == 1 ? abs : abs + best->path_len;
+  }
+  return best;
+}
+
+/**
+ * @brief Walks a normalized absolute path
+ */
+static int32_t vfs_walk(const char *abs, inode_t **result) {
+  const char *path;
+  vfs_mount_t *m = vfs_find_mount(abs, &path);
+  if (!m) {
+    return -ENOENT;
+  }
+  inode_t *inode = m->sb.root;
+
+  while (*path == '/' && path[1]) {
+    const char *comp = ++path;
+    while (*path && *path != '/') {
+      path++;
+    }
+    if (inode->type != DT_DIR || !inode->i_op || !inode->i_op->lookup) {
+      return -ENOTDIR;
+    }
+    int32_t ret = inode->i_op->lookup(inode, comp, path - comp, &inode);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  *result = inode;
+  return 0;
+}
+
+int32_t vfs_lookup(const char *path, inode_t **inode) {
+  char abs[PATH_MAX_LENGTH];
+  if (!path || !path[0]) {
+    return -ENOENT;
+  }
+  int32_t ret = vfs_normalize_path(vfs_cwd(), path, abs);
+  if (ret < 0) {
+    return ret;
+  }
+  return vfs_walk(abs, inode);
+}
+
+int32_t vfs_mount(const char *source, const char *target, const char *fstype) {
+  char abs[PATH_MAX_LENGTH];
+  vfs_mount_t *m = NULL;
+  int i;
+  if (!target || target[0] != '/' || !fstype) {
+    return -EINVAL;
+  }
+  file_system_t *fs = vfs_get_fs(fstype);
+  if (!fs) {
+    return -ENODEV;
+  }
+  int32_t ret = vfs_normalize_path(NULL, target, abs);
+  if (ret < 0) {
+    return ret;
+  }
+  for (i = 0; i < VFS_MAX_MOUNTS; i++) {
+    if (vfs_mounts[i].in_use && strncmp((int8_t *)vfs_mounts[i].path, (int8_t *)abs, PATH_MAX_LENGTH) == 0) {
+      return -EBUSY;
+    }
+    if (!vfs_mounts[i].in_use && !m) {
+      m = &vfs_mounts[i];
+    }
+  }
+  if (!m) {
+    return -ENOMEM;
+  }
+
+  memset(&m->sb, 0, sizeof(super_block_t));
+  m->sb.fs = fs;
+  ret = fs->mount(&m->sb, source);
+  // the exec cache knows programs by inode, and a filesystem may hand out
+  // the inodes it had before for different files (ece391fs swaps its image
+  // under its static inodes), even if the mount then failed
+  elf_cache_flush();
+  if (ret < 0) {
+    return ret;
+  }
+  strcpy((int8_t *)m->path, (int8_t *)abs);
+  m->path_len = strlen((int8_t *)abs);
+  m->in_use = 1;
+  return 0;
+}
+
+int32_t vfs_umount(const char *target) {
+  char abs[PATH_MAX_LENGTH];
+  int i;
+  if (!target || vfs_normalize_path(vfs_cwd(), target, abs) < 0) {
+    return -EINVAL;
+  }
+  for (i = 0; i < VFS_MAX_MOUNTS; i++) {
+    vfs_mount_t *m = &vfs_mounts[i];
+    if (!m->in_use || strncmp((int8_t *)m->path, (int8_t *)abs, PATH_MAX_LENGTH) != 0) {
+      continue;
+    }
+    // the root filesystem always has something open (the programs)
+    if (m->path_len == 1) {
+      return -EBUSY;
+    }
+    int j;
+    for (j = 0; j < VFS_MAX_FILES; j++) {
+      if (vfs_files[j].refcount && vfs_files[j].inode->sb == &m->sb) {
+        return -EBUSY;
+      }
+    }
+    m->in_use = 0;
+    elf_cache_flush();
+    return 0;
+  }
+  return -EINVAL;
+}
+
+int32_t vfs_open_inode(inode_t *inode, uint32_t flags, file_t **file) {
+  int i;
+  for (i = 0; i < VFS_MAX_FILES; i++) {
+    if (vfs_files[i].refcount == 0) {
+      break;
+    }
+  }
+  if (i == VFS_MAX_FILES) {
+    return -ENFILE;
+  }
+
+  file_t *f = &vfs_files[i];
+  f->inode = inode;
+  f->f_op = inode->f_op;
+  f->pos = 0;
+  f->flags = flags;
+  f->private_data = NULL;
+  f->refcount = 1;
+  if (f->f_op && f->f_op->open) {
+    int32_t ret = f->f_op->open(inode, f);
+    if (ret < 0) {
+      f->refcount = 0;
+      return ret;
+    }
+  }
+  *file = f;
+  return 0;
+}
+
+int32_t vfs_open(const char *path, uint32_t flags, file_t **file) {
+  inode_t *inode;
+  int32_t ret = vfs_lookup(path, &inode);
+  if (ret < 0) {
+    return ret;
+  }
+  return vfs_open_inode(inode, flags, file);
+}
+
+file_t *vfs_file_get(file_t *file) {
+  file->refcount++;
+  return file;
+}
+
+void vfs_file_put(file_t *file) {
+  if (file->refcount == 0) {
+    return;
+  }
+  if (--file->refcount == 0 && file->f_op && file->f_op->release) {
+    file->f_op->release(file->inode, file);
+  }
+}
+
+file_t *vfs_fd_get(struct task_t *t, int32_t fd) {
+  if (!t || fd < 0 || fd >= MAX_OPEN_FILES) {
+    return NULL;
+  }
+  return t->files[fd];
+}
+
+int32_t vfs_fd_install(struct task_t *t, file_t *file) {
+  int32_t fd;
+  for (fd = 0; fd < MAX_OPEN_FILES; fd++) {
+    if (!t->files[fd]) {
+      t->files[fd] = file;
+      return fd;
+    }
+  }
+  return -EMFILE;
+}
+
+int32_t vfs_fd_close(struct task_t *t, int32_t fd) {
+  file_t *file = vfs_fd_get(t, fd);
+  if (!file) {
+    return -EBADF;
+  }
+  t->files[fd] = NULL;
+  vfs_file_put(file);
+  return 0;
+}
+
+void vfs_fd_share_all(struct task_t *t) {
+  int i;
+  for (i = 0; i < MAX_OPEN_FILES; i++) {
+    if (t->files[i]) {
+      vfs_file_get(t->files[i]);
+    }
+  }
+}
+
+int32_t vfs_put_dirent(void *buf, uint32_t count, uint32_t *filled, uint32_t ino,
+                       uint32_t type, uint32_t size, const char *name, uint32_t namelen) {
+  // buf is the user's, so the record is put together here and copied out
+  uint32_t rec[DIRENT_RECLEN(VFS_NAME_LEN) / sizeof(uint32_t)];
+  struct dirent *d = (struct dirent *)rec;
+  if (namelen > VFS_NAME_LEN) {
+    namelen = VFS_NAME_LEN;
+  }
+  uint32_t reclen = DIRENT_RECLEN(namelen);
+  if (*filled + reclen > count) {
+    return -1;
+  }
+  d->d_ino = ino;
+  d->d_type = type;
+  d->d_pad = 0;
+  d->d_reclen = reclen;
+  d->d_size = size;
+  memcpy(d->d_name, name, namelen);
+  memset(d->d_name + namelen, 0, reclen - sizeof(struct dirent) - namelen);
+  if (__copy_to_user((uint8_t *)buf + *filled, d, reclen)) {
+    return -EFAULT;
+  }
+  *filled += reclen;
+  return 0;
+}
+
+/**
+ * @brief Copies a path argument of a syscall into the kernel
+ * @param out buffer of PATH_MAX_LENGTH bytes
+ * @return int32_t 0, -EFAULT or -ENAMETOOLONG
+ */
+static int32_t vfs_getname(const char *path, char *out) {
+  int32_t len = strncpy_from_user((int8_t *)out, (const int8_t *)path, PATH_MAX_LENGTH);
+  if (len < 0) {
+    return len;
+  }
+  if (len == PATH_MAX_LENGTH) {
+    return -ENAMETOOLONG;
+  }
+  return 0;
+}
+
+int32_t sys_dup(int32_t fd) {
+  task *t = get_task_in_running_terminal();
+  file_t *file = vfs_fd_get(t, fd);
+  if (!file) {
+    return -EBADF;
+  }
+  int32_t new_fd = vfs_fd_install(t, file);
+  if (new_fd >= 0) {
+    vfs_file_get(file);
+  }
+  return new_fd;
+}
+
+int32_t sys_dup2(int32_t oldfd, int32_t newfd) {
+  task *t = get_task_in_running_terminal();
+  file_t *file = vfs_fd_get(t, oldfd);
+  if (!file || newfd < 0 || newfd >= MAX_OPEN_FILES) {
+    return -EBADF;
+  }
+  if (newfd == oldfd) {
+    return newfd;
+  }
+  // take the reference first, closing newfd might drop the last one otherwise
+  vfs_file_get(file);
+  if (t->files[newfd]) {
+    vfs_fd_close(t, newfd);
+  }
+  t->files[newfd] = file;
+  return newfd;
+}
+
+int32_t sys_ioctl(int32_t fd, uint32_t request, uint32_t arg) {
+  file_t *file = vfs_fd_get(get_task_in_running_terminal(), fd);
+  if (!file) {
+    return -EBADF;
+  }
+  if (!file->f_op || !file->f_op->ioctl) {
+    return -ENOTTY;
+  }
+  return file->f_op->ioctl(file, request, arg);
+}
+
+int32_t sys_mount(const char *source, const char *target, const char *fstype) {
+  char ksource[PATH_MAX_LENGTH], ktarget[PATH_MAX_LENGTH], kfstype[PATH_MAX_LENGTH];
+  int32_t ret;
+  if (source && (ret = vfs_getname(source, ksource)) < 0) {
+    return ret;
+  }
+  if ((ret = vfs_getname(target, ktarget)) < 0 || (ret = vfs_getname(fstype, kfstype)) < 0) {
+    return ret;
+  }
+  return vfs_mount(source ? ksource : NULL, ktarget, kfstype);
+}
+
+int32_t sys_umount(const char *target) {
+  char ktarget[PATH_MAX_LENGTH];
+  int32_t ret = vfs_getname(target, ktarget);
+  if (ret < 0) {
+    return ret;
+  }
+  return vfs_umount(ktarget);
+}
+
+int32_t sys_getdents(int32_t fd, void *buf, uint32_t count) {
+  file_t *file = vfs_fd_get(get_task(), fd);
+  if (!file) {
+    return -EBADF;
+  }
+  if (file->inode->type != DT_DIR || !file->f_op || !file->f_op->getdents) {
+    return -ENOTDIR;
+  }
+  if (!buf) {
+    return -EINVAL;
+  }
+  if (!access_ok(buf, count)) {
+    return -EFAULT;
+  }
+  return file->f_op->getdents(file, buf, count);
+}
+
+int32_t sys_chdir(const char *path) {
+  char kpath[PATH_MAX_LENGTH];
+  char abs[PATH_MAX_LENGTH];
+  inode_t *inode;
+  task *t = get_task();
+  if (!path) {
+    return -EINVAL;
+  }
+  int32_t ret = vfs_getname(path, kpath);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = vfs_normalize_path(vfs_cwd(), kpath, abs);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = vfs_walk(abs, &inode);
+  if (ret < 0) {
+    return ret;
+  }
+  if (inode->type != DT_DIR) {
+    return -ENOTDIR;
+  }
+  if (!t->wd) {
+    t->wd = kmalloc(PATH_MAX_LENGTH);
+  }
+  strcpy((int8_t *)t->wd, (int8_t *)abs);
+  return 0;
+}
+
+int32_t sys_getcwd(char *buf, uint32_t size) {
+  const char *cwd = vfs_cwd();
+  uint32_t len = strlen((int8_t *)cwd);
+  if (!buf) {
+    return -EINVAL;
+  }
+  if (len + 1 > size) {
+    return -ERANGE;
+  }
+  if (copy_to_user(buf, cwd, len + 1)) {
+    return -EFAULT;
+  }
+  return len;
+}
+
+int32_t sys_mkdir(const char *path, int mode) {
+  char kpath[PATH_MAX_LENGTH];
+  char abs[PATH_MAX_LENGTH];
+  inode_t *inode;
+  if (!path) {
+    return -EINVAL;
+  }
+  int32_t ret = vfs_getname(path, kpath);
+  if (ret < 0) {
+    return ret;
+  }
+  ret = vfs_normalize_path(vfs_cwd(), kpath, abs);
+  if (ret < 0) {
+    return ret;
+  }
+  if (vfs_walk(abs, &inode) == 0) {
+    return -EEXIST;
+  }
+
+  // the parent has to exist and be a directory
+  char *slash = abs + strlen((int8_t *)abs);
+  while (*slash != '/') {
+    slash--;
+  }
+  const char *name = slash + 1;
+  *slash = '\0';
+  ret = vfs_walk(slash == abs ? "/" : abs, &inode);
+  if (ret < 0) {
+    return ret;
+  }
+  if (inode->type != DT_DIR) {
+    return -ENOTDIR;
+  }
+  if (!inode->i_op || !inode->i_op->mkdir) {
+    return -EROFS;
+  }
+  return inode->i_op->mkdir(inode, name, strlen((int8_t *)name), mode);
+}
@@ -0,0 +1,306 @@
+/**
+ * @file vfs.h
+ * @brief Virtual filesystem layer. Filesystems register a type and get
+ * mounted on a path, each of their inodes carries the operation tables used
+ * to look names up in it and to read/write it once opened. Character devices
+ * register a file_operations_t under a name and show up wherever a filesystem
+ * has a device node of that name (and in /dev).
+ *
+ * An open file is a refcounted file_t shared by every fd pointing at it, so
+ * fork and dup only take another reference and share the file position.
+ */
+#ifndef VFS_H
+#define VFS_H
+
+#include "../types.h"
+#include "../libc/dirent.h"
+
+#define VFS_MAX_FILES 			64		///< open files in the whole system
+#define VFS_MAX_FILESYSTEMS 	4		///< registered filesystem types
+#define VFS_MAX_MOUNTS 			8		///< mounted filesystems
+#define VFS_MAX_CHRDEVS 		8		///< registered character devices
+#define VFS_NAME_LEN 			32		///< longest device or filesystem name
+
+// file_t flags. An fd can only be read from / written to if it was opened
+// with the matching permission, stdin is read only and stdout write only
+#define FD_READ_PERMS 			0x2
+#define FD_WRITE_PERMS 			0x4
+
+struct task_t;
+typedef struct s_inode inode_t;
+typedef struct s_file file_t;
+typedef struct s_super_block super_block_t;
+
+/**
+ *	What can be done with an open file. Any of these may be NULL
+ */
+typedef struct s_file_operations {
+	int32_t (*open)(inode_t *inode, file_t *file);				///< file was just opened, 0 or -errno
+	int32_t (*release)(inode_t *inode, file_t *file);			///< last reference to the file went away
+	int32_t (*read)(file_t *file, void *buf, int32_t nbytes);	///< like read(2), advances file->pos
+	int32_t (*write)(file_t *file, const void *buf, int32_t nbytes);
+	int32_t (*getdents)(file_t *file, void *buf, uint32_t count);	///< see sys_getdents
+	int32_t (*ioctl)(file_t *file, uint32_t request, uint32_t arg);	///< see sys_ioctl
+} file_operations_t;
+
+/**
+ *	What can be done with a directory inode
+ */
+typedef struct s_inode_operations {
+	/// finds `name` (`len` chars, not NUL terminated) in dir, 0 or -errno
+	int32_t (*lookup)(inode_t *dir, const char *name, uint32_t len, inode_t **result);
+	/// makes a directory, NULL if the filesystem is read-only
+	int32_t (*mkdir)(inode_t *dir, const char *name, uint32_t len, int mode);
+} inode_operations_t;
+
+/**
+ *	An inode, owned by its filesystem. The filesystems here have a fixed number
+ *	of inodes, so they are kept in static tables and never freed
+ */
+struct s_inode {
+	uint32_t ino;					///< inode number within the filesystem
+	uint32_t type;					///< DT_* type
+	uint32_t size;					///< size in bytes
+	super_block_t *sb;				///< filesystem the inode belongs to, NULL for devices
+	inode_operations_t *i_op;		///< directory operations, NULL for non-directories
+	file_operations_t *f_op;		///< operations of files opened on this inode
+	void *private_data;				///< whatever the filesystem wants
+};
+
+/**
+ *	An open file
+ */
+struct s_file {
+	inode_t *inode;					///< what was opened
+	file_operations_t *f_op;		///< copied from the inode on open
+	uint32_t pos;					///< byte offset, or entry index for directories
+	uint32_t flags;					///< FD_*_PERMS
+	uint32_t refcount;				///< fds (in any task) pointing here, 0 if the slot is free
+	void *private_data;				///< whatever the driver wants
+};
+
+/**
+ *	A filesystem type, like "ece391fs"
+ */
+typedef struct s_file_system {
+	const char *name;
+	/// fills in sb->root, `source` is filesystem specific (a device name, or NULL)
+	int32_t (*mount)(super_block_t *sb, const char *source);
+} file_system_t;
+
+/**
+ *	A mounted filesystem
+ */
+struct s_super_block {
+	file_system_t *fs;				///< type of the filesystem
+	inode_t *root;					///< root directory
+	void *private_data;				///< whatever the filesystem wants
+};
+
+/**
+ * @brief Clears every table, call once at boot before anything registers
+ */
+void vfs_init();
+
+/**
+ * @brief Makes a filesystem type available to vfs_mount
+ * @return int32_t 0 on success, -ENOMEM if the table is full
+ */
+int32_t vfs_register_fs(file_system_t *fs);
+
+/**
+ * @brief Registers a character device. Device nodes with this name (and
+ * /dev/name once devfs is mounted) open to these operations
+ * @return int32_t 0 on success, -EEXIST or -ENOMEM
+ */
+int32_t vfs_register_chrdev(const char *name, file_operations_t *fops);
+
+/**
+ * @brief Gets the inode of a registered character device
+ * @param len length of name, which doesn't have to be NUL terminated
+ * @return inode_t* the inode, NULL if there's no such device
+ */
+inode_t *vfs_chrdev_inode(const char *name, uint32_t len);
+
+/**
+ * @brief Gets the index-th registered character device, for devfs
+ * @return inode_t* the inode (its private_data is the name), NULL past the last one
+ */
+inode_t *vfs_chrdev_at(uint32_t index);
+
+/**
+ * @brief Mounts a filesystem. The mount point doesn't have to exist in the
+ * filesystem underneath, paths below it simply resolve in the new one
+ *
+ * @param source filesystem specific, may be NULL
+ * @param target absolute path
+ * @param fstype registered filesystem name
+ * @return int32_t 0 on success, -ENODEV / -EBUSY / -ENOMEM / -EINVAL
+ */
+int32_t vfs_mount(const char *source, const char *target, const char *fstype);
+
+/**
+ * @brief Unmounts the filesystem mounted on target
+ * @return int32_t 0 on success, -EINVAL if nothing is mounted there, -EBUSY if files are open in it
+ */
+int32_t vfs_umount(const char *target);
+
+/**
+ * @brief Turns a path into a normalized absolute one: no ".", "..", empty
+ * components or trailing slash. Relative paths are taken relative to cwd
+ *
+ * @param cwd absolute working directory (ignored if path starts with '/')
+ * @param path the path
+ * @param out buffer of PATH_MAX_LENGTH bytes
+ * @return int32_t 0 on success, -ENAMETOOLONG if the result doesn't fit
+ */
+int32_t vfs_normalize_path(const char *cwd, const char *path, char *out);
+
+/**
+ * @brief Working directory of the current task, "/" if it doesn't have one yet
+ */
+const char *vfs_cwd();
+
+/**
+ * @brief Resolves a path through the mount table and the inode lookups
+ *
+ * @param path absolute or relative to the current task's working directory
+ * @param inode filled in with the inode found
+ * @return int32_t 0 on success, -ENOENT / -ENOTDIR / -ENAMETOOLONG on failure
+ */
+int32_t vfs_lookup(const char *path, inode_t **inode);
+
+/**
+ * @brief Opens an inode, the new file has a refcount of 1
+ *
+ * @param flags FD_*_PERMS
+ * @param file filled in with the open file
+ * @return int32_t 0 on success, -ENFILE if the file table is full, or whatever f_op->open returned
+ */
+int32_t vfs_open_inode(inode_t *inode, uint32_t flags, file_t **file);
+
+/**
+ * @brief vfs_lookup followed by vfs_open_inode
+ */
+int32_t vfs_open(const char *path, uint32_t flags, file_t **file);
+
+/**
+ * @brief Takes another reference to an open file
+ */
+file_t *vfs_file_get(file_t *file);
+
+/**
+ * @brief Drops a reference, releasing the file when it was the last one
+ */
+void vfs_file_put(file_t *file);
+
+/**
+ * @brief Gets the open file behind an fd of a task
+ * @return file_t* the file, NULL if fd is out of range or not open
+ */
+file_t *vfs_fd_get(struct task_t *t, int32_t fd);
+
+/**
+ * @brief Finds the lowest free fd of a task and points it at file (the
+ * caller's reference moves to the fd)
+ * @return int32_t the fd, or -EMFILE
+ */
+int32_t vfs_fd_install(struct task_t *t, file_t *file);
+
+/**
+ * @brief Closes an fd of a task, any fd including stdin/stdout
+ * @return int32_t 0 on success, -EBADF if it wasn't open
+ */
+int32_t vfs_fd_close(struct task_t *t, int32_t fd);
+
+/**
+ * @brief Takes a reference on every open file of t, for a task that was just
+ * copied from another one
+ */
+void vfs_fd_share_all(struct task_t *t);
+
+/**
+ * @brief Appends one struct dirent to a getdents buffer
+ *
+ * @param buf user buffer, checked by sys_getdents
+ * @param filled bytes of buf already used, advanced past the new record
+ * @return int32_t 0 on success, -1 if the record doesn't fit in count bytes,
+ * -EFAULT if buf is bad
+ */
+int32_t vfs_put_dirent(void *buf, uint32_t count, uint32_t *filled, uint32_t ino,
+                       uint32_t type, uint32_t size, const char *name, uint32_t namelen);
+
+/**
+ * @brief Makes a new fd pointing at the same open file as fd
+ * https://man7.org/linux/man-pages/man2/dup.2.html
+ * @return int32_t the new fd, -EBADF or -EMFILE
+ */
+int32_t sys_dup(int32_t fd);
+
+/**
+ * @brief Makes newfd point at the same open file as oldfd, closing whatever
+ * newfd had open first
+ * https://man7.org/linux/man-pages/man2/dup2.2.html
+ * @return int32_t newfd, or -EBADF
+ */
+int32_t sys_dup2(int32_t oldfd, int32_t newfd);
+
+/**
+ * @brief Device specific request on fd, see TTY_IOCTL_* for the terminal
+ * https://man7.org/linux/man-pages/man2/ioctl.2.html
+ * @return int32_t whatever the device returns, -EBADF, or -ENOTTY if the
+ * file doesn't take requests
+ */
+int32_t sys_ioctl(int32_t fd, uint32_t request, uint32_t arg);
+
+/**
+ * @brief https://man7.org/linux/man-pages/man2/mount.2.html
+ */
+int32_t sys_mount(const char *source, const char *target, const char *fstype);
+
+/**
+ * @brief https://man7.org/linux/man-pages/man2/umount.2.html
+ */
+int32_t sys_umount(const char *target);
+
+/**
+ * @brief Reads as many directory entries as fit into buf, packed as
+ * struct dirent (see libc/dirent.h). The cursor is the file position, shared
+ * with read() on the directory
+ * https://man7.org/linux/man-pages/man2/getdents.2.html
+ *
+ * @param fd a directory fd
+ * @param buf user buffer
+ * @param count size of buf in bytes
+ * @return int32_t bytes filled in, 0 at the end of the directory, -EBADF,
+ * -ENOTDIR, or -EINVAL if not even one entry fits
+ */
+int32_t sys_getdents(int32_t fd, void *buf, uint32_t count);
+
+/**
+ * @brief Changes the working directory of the calling task
+ * https://man7.org/linux/man-pages/man2/chdir.2.html
+ */
+int32_t sys_chdir(const char *path);
+
+/**
+ * @brief Copies the working directory of the calling task into buf
+ * https://man7.org/linux/man-pages/man2/getcwd.2.html
+ * @return int32_t length of the path on success, -ERANGE if buf is too small
+ */
+int32_t sys_getcwd(char *buf, uint32_t size);
+
+/**
+ * @brief Makes a directory through the parent's inode operations
+ * @return int32_t 0 on success, -EEXIST, -ENOENT, -ENOTDIR, or -EROFS if the
+ * filesystem can't make directories
+ */
+int32_t sys_mkdir(const char *path, int mode);
+
+/**
+ * @brief Registers the devfs filesystem type, which lists every character
+ * device. Mounted on /dev at boot
+ */
+void devfs_init();
+
+#endif
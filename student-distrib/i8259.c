@@ -1,5 +1,7 @@
 #include "i8259.h"
 #include "lib.h"
+#include "irqstat.h"
+#include "fs/procfs.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 /* Use these interrupt masks to determine which interrupts are enabled and disabled. 
@@ -7,6 +9,51 @@ Let 1 mean interrupt disabled, 0 means enabled */
 uint8_t master_mask; /* IRQs 0-7  */
 uint8_t slave_mask;  /* IRQs 8-15 */
 #define SLAVE_PIC_LINE 0x2
+#define SPURIOUS_BIT 0x80 // IRQ7 / IRQ15 in their PIC's ISR
+#define PIC_TICK_HZ 100 // the PIT, see scheduler.c
+#define PIT_VECTOR 0x20
+
+// what /proc/pic reports. Every outb to a PIC after init goes through
+// pic_outb so port_writes has all of them
+static struct {
+  uint32_t port_writes;
+  uint32_t mask_writes;
+  uint32_t mask_skipped;  // enable / disable_irq that found the mask as asked
+  uint32_t eoi_writes;
+  uint32_t spurious7;
+  uint32_t spurious15;
+  uint32_t last_writes;   // port_writes and PIT ticks when /proc/pic was last read
+  uint32_t last_ticks;
+} pic_stats;
+
+static void pic_outb(uint8_t data, uint16_t port) {
+  pic_stats.port_writes++;
+  outb(data, port);
+}
+
+// the mask of whichever PIC irq_num is on, NULL if it's not an IRQ
+static uint8_t *pic_mask(uint32_t irq_num, uint16_t *port) {
+  if (irq_num < 8) {
+    *port = MASTER_8259_PORT + 1;
+    return &master_mask;
+  }
+  if (irq_num <= 15) {
+    *port = SLAVE_8259_PORT + 1;
+    return &slave_mask;
+  }
+  return NULL;
+}
+
+// writes a PIC's mask, unless the cached one is already new_mask
+static void pic_set_mask(uint8_t *mask, uint16_t port, uint8_t new_mask) {
+  if (*mask == new_mask) {
+    pic_stats.mask_skipped++;
+    return;
+  }
+  *mask = new_mask;
+  pic_stats.mask_writes++;
+  pic_outb(new_mask, port);
+}
 
 /* Initialize the 8259 PIC */
 void i8259_init(void) {
@@ -18,20 +65,23 @@ void i8259_init(void) {
   outb(ICW1, MASTER_8259_PORT);
   outb(ICW2_MASTER, MASTER_8259_PORT + 1);
   outb(ICW3_MASTER, MASTER_8259_PORT + 1);
-  outb(ICW4, MASTER_8259_PORT + 1);
+  outb(I8259_AEOI ? ICW4 | ICW4_AEOI : ICW4, MASTER_8259_PORT + 1);
 
   outb(ICW1, SLAVE_8259_PORT);
   outb(ICW2_SLAVE, SLAVE_8259_PORT + 1);
   outb(ICW3_SLAVE, SLAVE_8259_PORT + 1);
-  outb(ICW4, SLAVE_8259_PORT + 1);
+  outb(I8259_AEOI ? ICW4 | ICW4_AEOI : ICW4, SLAVE_8259_PORT + 1);
 
   // sti(); // turn on interrupts again
   // restore_flags(flags); // restore EFLAGS
 
   // also initialize the master_mask and slave_mask variables
   // start all interrupts disabled because we have no devices, will enable them one by one as suggested in the spec
+  // ICW1 clears the mask registers, so write these out once to match
   master_mask = 0xFF;
   slave_mask = 0xFF;
+  outb(master_mask, MASTER_8259_PORT + 1);
+  outb(slave_mask, SLAVE_8259_PORT + 1);
 
   // enable IRQ2 on master PIC which is where slave PIC connects
   enable_irq(SLAVE_PIC_LINE);
@@ -65,46 +115,20 @@ void enable_irq(uint32_t irq_num) {
   // (inhibited), M = 0 indicates the channel is enabled.
 
 
-  if (irq_num < 8) {
-    // master
-    unsigned int masked = master_mask & (1 << irq_num);
-    if (masked > 0) {
-      // then its currently masked, but we want it set to 0 to indicate unmasked
-      master_mask = turn_bit_to_zero(master_mask, irq_num);
-      outb(master_mask, MASTER_8259_PORT + 1);
-    }
-  }
-  else if (irq_num >= 8 && irq_num <= 15) {
-    // slave
-    irq_num -= 8;
-    unsigned int masked = slave_mask & (1 << irq_num);
-    if (masked > 0) {
-
-      slave_mask = turn_bit_to_zero(slave_mask, irq_num);
-      outb(slave_mask, SLAVE_8259_PORT + 1);
-    }    
+  // the masks are cached, so asking for what's already there costs no write
+  uint16_t port;
+  uint8_t *mask = pic_mask(irq_num, &port);
+  if (mask) {
+    pic_set_mask(mask, port, turn_bit_to_zero(*mask, irq_num & 7));
   }
 }
 
 /* Disable (mask) the specified IRQ */
 void disable_irq(uint32_t irq_num) {
-  if (irq_num < 8) {
-    // master
-    unsigned int masked = master_mask & (1 << irq_num);
-    if (masked == 0) {
-      // then its currently not masked, but we want it masked
-      master_mask = turn_bit_to_one(master_mask, irq_num);
-      outb(master_mask, MASTER_8259_PORT + 1);
-    }
-  }
-  else if (irq_num >= 8 && irq_num <= 15) {
-    // slave
-    irq_num -= 8;
-    unsigned int masked = slave_mask & (1 << irq_num);
-    if (masked == 0) {
-      slave_mask = turn_bit_to_one(slave_mask, irq_num);
-      outb(slave_mask, SLAVE_8259_PORT + 1);
-    }    
+  uint16_t port;
+  uint8_t *mask = pic_mask(irq_num, &port);
+  if (mask) {
+    pic_set_mask(mask, port, turn_bit_to_one(*mask, irq_num & 7));
   }
 }
 
@@ -117,14 +141,109 @@ void send_eoi(uint32_t irq_num) {
   uint32_t val = EOI | irq_num;
   uint32_t val_slave = EOI | (irq_num - 8);
 
+  // in AEOI mode the PICs already did it when the CPU took the interrupt
+  if (I8259_AEOI) {
+    return;
+  }
+
   if (irq_num < 8)
   {
     // master
-    outb(val, MASTER_8259_PORT);
+    pic_stats.eoi_writes++;
+    pic_outb(val, MASTER_8259_PORT);
   }
   else if (irq_num >= 8 && irq_num <= 15) {
     // slave, then send to both slave + master
-    outb(val_slave, SLAVE_8259_PORT);
-    outb(EOI + SLAVE_PIC_LINE, MASTER_8259_PORT); // send 0x60 + 0x02, since slave is IRQ 2
+    pic_stats.eoi_writes += 2;
+    pic_outb(val_slave, SLAVE_8259_PORT);
+    pic_outb(EOI + SLAVE_PIC_LINE, MASTER_8259_PORT); // send 0x60 + 0x02, since slave is IRQ 2
   }
 }
+
+// the In-Service Register of the PIC at port
+static uint8_t pic_read_isr(uint16_t port) {
+  pic_outb(OCW3_READ_ISR, port);
+  return inb(port);
+}
+
+/*
+A PIC that sees an IRQ line drop before the CPU acknowledges it still has to
+hand over a vector, and gives the lowest priority one it has: IRQ7 for the
+master, IRQ15 for the slave. A real IRQ7 / IRQ15 is in service by then, a
+spurious one isn't, and must not be EOI'd or it ends whatever really is in
+service. A spurious IRQ15 did come through the master on IRQ2 though, so the
+master still needs its EOI.
+In AEOI mode the ISR bit is already gone when we look, so anything on these
+two lines counts as spurious, which is all that comes in on them anyway.
+*/
+void i8259_irq7_handler(void) {
+  if (pic_read_isr(MASTER_8259_PORT) & SPURIOUS_BIT) {
+    send_eoi(7);
+    return;
+  }
+  pic_stats.spurious7++;
+}
+
+void i8259_irq15_handler(void) {
+  if (pic_read_isr(SLAVE_8259_PORT) & SPURIOUS_BIT) {
+    send_eoi(15);
+    return;
+  }
+  pic_stats.spurious15++;
+  send_eoi(SLAVE_PIC_LINE);
+}
+
+// IRQ7 first, like the register
+static void pic_putmask(proc_buf_t *pb, uint8_t mask) {
+  char bits[9];
+  int i;
+  for (i = 0; i < 8; i++) {
+    bits[i] = (mask & (0x80 >> i)) ? '1' : '0';
+  }
+  bits[8] = '\0';
+  proc_puts(pb, bits);
+}
+
+/*
+/proc/pic: the masks (1 = masked, IRQ7 / IRQ15 first), the PIC port writes
+since boot and per second since /proc/pic was last read, split into mask
+writes and EOIs, the mask changes that were skipped because the cached mask
+already matched, and the spurious IRQ7s and IRQ15s. Reading it before and
+after some load gives the writes per second under that load.
+*/
+static void i8259_show(proc_buf_t *pb) {
+  uint32_t ticks = irq_count[PIT_VECTOR];
+  uint32_t writes = pic_stats.port_writes;
+  uint32_t rate = 0;
+  if (ticks != pic_stats.last_ticks) {
+    rate = (writes - pic_stats.last_writes) * PIC_TICK_HZ / (ticks - pic_stats.last_ticks);
+  }
+  pic_stats.last_writes = writes;
+  pic_stats.last_ticks = ticks;
+
+  proc_puts(pb, "master mask   ");
+  pic_putmask(pb, master_mask);
+  proc_puts(pb, "\nslave mask    ");
+  pic_putmask(pb, slave_mask);
+  proc_puts(pb, "\naeoi          ");
+  proc_puts(pb, I8259_AEOI ? "on" : "off");
+  proc_puts(pb, "\nport writes   ");
+  proc_putnum(pb, writes, 0);
+  proc_puts(pb, "\nwrites/sec    ");
+  proc_putnum(pb, rate, 0);
+  proc_puts(pb, "\nmask writes   ");
+  proc_putnum(pb, pic_stats.mask_writes, 0);
+  proc_puts(pb, "\nmask skipped  ");
+  proc_putnum(pb, pic_stats.mask_skipped, 0);
+  proc_puts(pb, "\neoi writes    ");
+  proc_putnum(pb, pic_stats.eoi_writes, 0);
+  proc_puts(pb, "\nspurious irq7 ");
+  proc_putnum(pb, pic_stats.spurious7, 0);
+  proc_puts(pb, "\nspurious irq15 ");
+  proc_putnum(pb, pic_stats.spurious15, 0);
+  proc_puts(pb, "\n");
+}
+
+void i8259_stats_init(void) {
+  procfs_register("pic", i8259_show);
+}
@@ -21,6 +21,18 @@
 #define ICW3_MASTER         0x04
 #define ICW3_SLAVE          0x02
 #define ICW4                0x01
+#define ICW4_AEOI           0x02
+
+/* Build with -DI8259_AEOI=1 to have both PICs end every interrupt themselves
+ * when the CPU acknowledges it (Automatic EOI). send_eoi then writes nothing,
+ * but an IRQ can come again while its handler is still running */
+#ifndef I8259_AEOI
+#define I8259_AEOI          0
+#endif
+
+/* OCW3 that makes the next read of the command port return the
+ * In-Service Register */
+#define OCW3_READ_ISR       0x0B
 
 /* End-of-interrupt byte.  This gets OR'd with
  * the interrupt number and sent out to the PIC
@@ -37,5 +49,11 @@ void enable_irq(uint32_t irq_num);
 void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num);
+/* Handlers for IRQ7 and IRQ15, which nothing uses, so all that comes
+ * in on them are spurious interrupts */
+void i8259_irq7_handler(void);
+void i8259_irq15_handler(void);
+/* Registers /proc/pic */
+void i8259_stats_init(void);
 
 #endif /* _I8259_H */
@@ -8,6 +8,9 @@
 #define TIMER_CHIP_INTERRUPT_VECTOR 0x20
 #define KEYBOARD_INTERRUPT_VECTOR 0x21 
 #define RTC_INTERRUPT_VECTOR 0x28
+#define ATA_INTERRUPT_VECTOR 0x2E // IRQ14, primary IDE channel
+#define IRQ7_INTERRUPT_VECTOR 0x27 // nothing on it but spurious interrupts from the master PIC
+#define IRQ15_INTERRUPT_VECTOR 0x2F // same for the slave
 #define SYSCALL_INTERRUPT_VECTOR 0x80 // INT 0x80
 
 // use a macro to mass produce a bunch of functions
@@ -115,6 +118,9 @@ void add_interrupt_handler_functions(idt_desc_t *idt) {
   idt_make_interrupt(idt + TIMER_CHIP_INTERRUPT_VECTOR, pit_handler_wrapper, IDT_DPL_KERNEL);
   idt_make_interrupt(idt + KEYBOARD_INTERRUPT_VECTOR, keyboard_handler_wrapper, IDT_DPL_KERNEL);
   idt_make_interrupt(idt + RTC_INTERRUPT_VECTOR, rtc_handler_wrapper, IDT_DPL_KERNEL);
+  idt_make_interrupt(idt + ATA_INTERRUPT_VECTOR, ata_handler_wrapper, IDT_DPL_KERNEL);
+  idt_make_interrupt(idt + IRQ7_INTERRUPT_VECTOR, irq7_handler_wrapper, IDT_DPL_KERNEL);
+  idt_make_interrupt(idt + IRQ15_INTERRUPT_VECTOR, irq15_handler_wrapper, IDT_DPL_KERNEL);
 
   // Generic syscall handler 0x80
   idt_make_interrupt(idt + SYSCALL_INTERRUPT_VECTOR, syscall_handler_wrapper, IDT_DPL_USER);
@@ -87,6 +87,12 @@ void rtc_handler_wrapper();
 
 void pit_handler_wrapper();
 
+void ata_handler_wrapper();
+
+void irq7_handler_wrapper();
+
+void irq15_handler_wrapper();
+
 // for bluescreens
 void print_exception_info();
 
@@ -0,0 +1,45 @@
+#include "irqstat.h"
+#include "lib.h"
+#include "errno.h"
+#include "mm/uaccess.h"
+
+uint32_t irq_count[IRQSTAT_VECTORS];
+
+// count and avg_cycles are filled in when they're asked for
+static irqstat_t irq_stats[IRQSTAT_VECTORS];
+
+void irq_stat_record(uint32_t vector, uint64_t cycles) {
+  irqstat_t *st = &irq_stats[vector];
+  uint32_t c = cycles > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)cycles;
+  if (!st->timed || c < st->min_cycles) {
+    st->min_cycles = c;
+  }
+  if (c > st->max_cycles) {
+    st->max_cycles = c;
+  }
+  st->total_cycles += cycles;
+  st->timed++;
+}
+
+int32_t sys_irqstat(irqstat_t *buf, uint32_t n) {
+  irqstat_t st;
+  uint32_t i, flags;
+  if (n > IRQSTAT_VECTORS) {
+    n = IRQSTAT_VECTORS;
+  }
+  if (!access_ok(buf, n * sizeof(irqstat_t))) {
+    return -EFAULT;
+  }
+  for (i = 0; i < n; i++) {
+    // one vector at a time, an IRQ could be halfway through updating it
+    cli_and_save(flags);
+    st = irq_stats[i];
+    st.count = irq_count[i];
+    restore_flags(flags);
+    st.avg_cycles = st.timed ? div64_32(st.total_cycles, st.timed) : 0;
+    if (copy_to_user(buf + i, &st, sizeof(irqstat_t))) {
+      return -EFAULT;
+    }
+  }
+  return n;
+}
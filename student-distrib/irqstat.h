@@ -0,0 +1,47 @@
+/**
+ * @file irqstat.h
+ * @brief Per vector interrupt statistics. The entry code in
+ * interrupt_wrapper.S counts every exception, IRQ and INT 0x80 in irq_count,
+ * and times IRQ handlers with the TSC. sys_irqstat hands them to user space.
+ */
+#ifndef IRQSTAT_H
+#define IRQSTAT_H
+
+#include "types.h"
+
+#define IRQSTAT_VECTORS		256			///< one entry per IDT vector
+
+/**
+ *	What sys_irqstat hands back for a vector. The cycles only cover the
+ *	entries whose handler came back to the wrapper: exceptions and system
+ *	calls aren't timed (/proc/syscalls has those), and neither is a timer
+ *	tick that switched to another task
+ */
+typedef struct s_irqstat {
+	uint32_t count;				///< times the vector was entered
+	uint32_t timed;				///< entries the cycles are over
+	uint64_t total_cycles;		///< TSC cycles spent in the handler
+	uint32_t min_cycles;
+	uint32_t max_cycles;
+	uint32_t avg_cycles;		///< total_cycles / timed, so user space doesn't need 64-bit division
+} irqstat_t;
+
+// bumped by the entry code
+extern uint32_t irq_count[IRQSTAT_VECTORS];
+
+/**
+ * @brief Called by the IRQ wrappers when the handler of vector comes back,
+ * with how long it took
+ */
+void irq_stat_record(uint32_t vector, uint64_t cycles);
+
+/**
+ * @brief Copies the stats of vectors 0 up to n - 1 to buf
+ *
+ * @param buf user array of n irqstat_t
+ * @param n entries in buf, more than IRQSTAT_VECTORS is cut down
+ * @return int32_t entries filled in, -EFAULT
+ */
+int32_t sys_irqstat(irqstat_t *buf, uint32_t n);
+
+#endif
@@ -16,6 +16,14 @@
 #include "filesystem.h"
 #include "scheduler.h"
 #include "terminal.h"
+#include "drivers/ata.h"
+#include "drivers/bcache.h"
+#include "drivers/tty.h"
+#include "fs/vfs.h"
+#include "fs/procfs.h"
+#include "system_calls.h"
+#include "elf.h"
+#include "mm/zeropage.h"
 
 // #define RUN_TESTS
 
@@ -23,6 +31,19 @@
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
+/* Check if the multiboot command line contains OPT (like "root=hda") */
+static int cmdline_has(multiboot_info_t *mbi, const char *opt) {
+    if (!CHECK_FLAG(mbi->flags, 2))
+        return 0;
+    char *cmdline = (char *)mbi->cmdline;
+    uint32_t len = strlen((int8_t *)opt);
+    for (; *cmdline; cmdline++) {
+        if (strncmp((int8_t *)cmdline, (int8_t *)opt, len) == 0)
+            return 1;
+    }
+    return 0;
+}
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
@@ -161,6 +182,9 @@ void entry(unsigned long magic, unsigned long addr) {
         ltr(KERNEL_TSS);
     }
 
+    // pick memcpy / memset paths for this CPU, before the big copies start
+    mem_init();
+
     // populate the interrupt descriptor table
     printf("Populating IDT with descriptors");
 
@@ -169,6 +193,10 @@ void entry(unsigned long magic, unsigned long addr) {
     // initiate filesystem
     printf("Init Filesystem");
     module_t* mod = (module_t*)mbi->mods_addr;
+    vfs_init();
+    ece391fs_init();
+    devfs_init();
+    procfs_init();
     init_filesystem(mod->mod_start);
 
     /* Init the PIC + all exception handlers */
@@ -179,16 +207,36 @@ void entry(unsigned long magic, unsigned long addr) {
 
     // devices (Keyboard + RTC)
     printf("Initializing Keyboard\n");
+    tty_init();
     init_keyboard();
     printf("Initializing RTC\n");
-    open_RTC((uint8_t*) "rtc");
+    init_RTC();
+    vfs_register_chrdev("rtc", &rtc_fops);
+
+    // disk. The module stays the root filesystem unless we're told to use the drive
+    printf("Initializing ATA\n");
+    bcache_init();
+    if (ata_init() == 0 && cmdline_has(mbi, "root=hda")) {
+        printf("Mounting filesystem from hda\n");
+        if (init_filesystem_blkdev(blkdev_get("hda")) != 0)
+            init_filesystem(mod->mod_start);
+    }
+    vfs_mount(NULL, "/", "ece391fs");
+    vfs_mount(NULL, "/dev", "devfs");
+    vfs_mount(NULL, "/proc", "procfs");
+    syscall_stats_init();
+    elf_cache_init();
+    zeropage_init();
+    i8259_stats_init();
 
 
     // paging
     printf("Initializing Paging\n");
     setup_paging();
     signals_init();
+    sysenter_init();
     init_tasks();
+    vfs_register_chrdev("tty", &terminal_fops);
     init_terminal();
 
     printf("Initializing PIT\n");
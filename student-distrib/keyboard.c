@@ -4,6 +4,7 @@
 #include "RTC.h"
 #include "system_calls.h"
 #include "terminal.h"
+#include "drivers/tty.h"
 
 #define KEYBOARD_PORT 0x60
 
@@ -86,6 +87,8 @@
 #define ARROW_RIGHT 0x4D
 #define ARROW_DOWN 0x50
 #define ARROW_UP 0x48
+#define KEY_PAGEUP 0x49
+#define KEY_PAGEDOWN 0x51
 // #define KEY_KP7			71
 // #define KEY_KP8			72
 // #define KEY_KP9			73
@@ -202,13 +205,13 @@ void keyboard_INT()
   // send eoi immediately so PIC can service other hardware interrupts.
   send_eoi(KEYBOARD_IRQ);
 
-  // disable this IRQ line from sending info to the CPU for a second
-  disable_irq(KEYBOARD_IRQ);
-
-  // no more processor interrupts (extra keypresses disabled)
+  // no more processor interrupts (extra keypresses disabled). The interrupt
+  // gate already has them off, and that keeps IRQ1 out too, so masking it
+  // here would only cost two port writes a key
   cli();
 
-  terminal_t *terminal = &terminals[cur_terminal_displayed];
+  // keys go to the terminal on screen
+  tty_t *tty = tty_get(cur_terminal_displayed);
 
   uint8_t keycode = 0; // keycodes range from 0x0-0x60 ish, let's use 0 which is error code normally to indicate we haven't received anything
   keycode = inb(KEYBOARD_PORT);
@@ -246,15 +249,8 @@ void keyboard_INT()
   }
   else if (keycode == KEY_BACKSPACE)
   {
-    // also delete the character from the buffer if the buffer isn't empty
-    if (terminal->line_buffer_idx != 0)
-    {
-      terminal->line_buffer[terminal->line_buffer_idx] = '\0';
-      terminal->line_buffer_idx--;
-
-      // move cursor too
-      do_backspace();
-    }
+    // the tty takes it off the line (and the screen)
+    tty_receive(tty, '\b');
   }
   else if (keycode == ARROW_UP || keycode == ARROW_DOWN ||
            keycode == ARROW_LEFT || keycode == ARROW_RIGHT)
@@ -277,6 +273,11 @@ void keyboard_INT()
       break;
     }
   }
+  else if (is_shift_key_pressed && (keycode == KEY_PAGEUP || keycode == KEY_PAGEDOWN))
+  {
+    // half a screen at a time so there's some context left
+    scrollback_scroll(keycode == KEY_PAGEUP ? NUM_ROWS / 2 : -(NUM_ROWS / 2));
+  }
   else
   {
     if (keycode <= NUM_KEYS)
@@ -289,6 +290,7 @@ void keyboard_INT()
       {
         // CTRL + L, then we will reset cursor to top left
         // and also clear screen
+        scrollback_reset();
         clear();
         change_write_head(0, 0);
         printf("391OS>");
@@ -350,29 +352,14 @@ void keyboard_INT()
         key_char = keys[keycode].uppercase_char;
       }
 
-      // try adding to the line buffer (minus 1 because newline is at end)
-      if (terminal->line_buffer_idx < LINE_BUFFER_MAX_SIZE - 1)
-      {
-        // then add it to the line buffer and print the char out
-        if (keycode != KEY_ENTER)
-        {
-          terminal->line_buffer[terminal->line_buffer_idx] = key_char;
-          terminal->line_buffer_idx++;
-        }
-        putc(key_char);
-      }
-      if (keycode == KEY_ENTER)
-      {
-        // notify the terminal that a newline has been received
-        terminal->newline_received = 1;
-      }
-      // otherwise nothing happens
+      // the tty puts it on the line and echoes it, or hands it straight to
+      // a reader in raw mode
+      tty_receive(tty, key_char);
     }
   }
 
 done:
-  // re-enable interrupts and also interrupt controller keyboard vector
-  enable_irq(KEYBOARD_IRQ);
+  // re-enable interrupts
   sti();
 }
 
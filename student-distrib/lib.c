@@ -297,41 +297,45 @@ void change_blinking_cursor_pos(int32_t x, int32_t y) {
 }
 
 
-void scroll_up() {
-    int i, j;
-    change_write_head(0, NUM_ROWS - 1);
-    for (i = 0; i < NUM_ROWS - 1; i++)
-    {
-        // move everything one line up
-        for (j = 0; j < NUM_COLS; j++) {
-            uint32_t idx = i * NUM_COLS + j;
-            uint32_t one_down = idx + NUM_COLS;
-            *(uint8_t *)(video_mem + (idx << 1)) = *(uint8_t *)(video_mem + (one_down << 1));
-        }
-    }
-    // bottom line should be clear
-    for (i = 0; i < NUM_COLS; i++) {
-        uint32_t idx = NUM_COLS * (NUM_ROWS - 1) + i;
-        *(uint8_t *)(video_mem + (idx << 1)) = ' ';
+/* Scrolling works on whole cells (character + attribute, 16 bits), so the
+ * attributes move with the characters. The screen itself is shifted with one
+ * memmove. A terminal's backing page is a ring of rows instead: row_offset is
+ * the row that's on top, so scrolling it just moves row_offset down one and
+ * blanks the row that wrapped around to the bottom. rewrite_video_state puts
+ * the rows back in order when the terminal gets displayed again */
+#define BLANK_CELL  ((ATTRIB << 8) | ' ')
+
+/* uint16_t* backing_row(uint32_t term, uint32_t y);
+ * Inputs: term = terminal, y = row on its screen
+ * Return Value: the first cell of row y in term's backing page */
+uint16_t* backing_row(uint32_t term, uint32_t y) {
+    terminal_t *t = &terminals[term];
+    uint32_t row = t->row_offset + y;
+    if (row >= NUM_ROWS) {
+        row -= NUM_ROWS;
     }
+    return (uint16_t *)t->video_mem_start + row * NUM_COLS;
 }
-void scroll_up_mem() {
-    int i, j;
-    uint32_t vid_addr = terminals[cur_terminal_running].video_mem_start;
-    for (i = 0; i < NUM_ROWS - 1; i++)
-    {
-        // move everything one line up
-        for (j = 0; j < NUM_COLS; j++) {
-            uint32_t idx = i * NUM_COLS + j;
-            uint32_t one_down = idx + NUM_COLS;
-            *(uint8_t *)(vid_addr + (idx << 1)) = *(uint8_t *)(vid_addr + (one_down << 1));
-        }
-    }
-    // bottom line should be clear
-    for (i = 0; i < NUM_COLS; i++) {
-        uint32_t idx = NUM_COLS * (NUM_ROWS - 1) + i;
-        *(uint8_t *)(vid_addr + (idx << 1)) = ' ';
+
+/* void scroll_up(void);
+ * Function: Moves the screen up one line and blanks the bottom one. Leaves
+ *           the write head alone */
+void scroll_up() {
+    uint16_t *cells = (uint16_t *)video_mem;
+    scrollback_push(cur_terminal_displayed, cells);
+    memmove(cells, cells + NUM_COLS, (NUM_ROWS - 1) * NUM_COLS * sizeof(uint16_t));
+    memset_word(cells + (NUM_ROWS - 1) * NUM_COLS, BLANK_CELL, NUM_COLS);
+}
+
+/* void scroll_up_mem(uint32_t term);
+ * Function: Moves term's backing page up one line and blanks the bottom one */
+void scroll_up_mem(uint32_t term) {
+    terminal_t *t = &terminals[term];
+    scrollback_push(term, backing_row(term, 0));
+    if (++t->row_offset == NUM_ROWS) {
+        t->row_offset = 0;
     }
+    memset_word(backing_row(term, NUM_ROWS - 1), BLANK_CELL, NUM_COLS);
 }
 
 /* void putc(uint8_t c);
@@ -339,6 +343,7 @@ void scroll_up_mem() {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
+    scrollback_reset();
     if(c == '\n' || c == '\r') {
         if (screen_y == NUM_ROWS - 1) {
             // then we were at last line, scroll up
@@ -346,14 +351,15 @@ void putc(uint8_t c) {
         }
         else {
             screen_y++;
-            screen_x = 0;
         }
+        screen_x = 0;
     } else {
         *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
         *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
         if (screen_x == NUM_COLS - 1 && screen_y == NUM_ROWS - 1) {
             // if we are in bottom right corner then scroll up
             scroll_up();
+            screen_x = 0;
         }
         else {
             // this handles case where we are at rightmost column
@@ -376,28 +382,28 @@ void putc(uint8_t c) {
 }
 
 void putc_mem(uint8_t c) {
-    uint32_t vid_addr = terminals[cur_terminal_running].video_mem_start;
+    uint32_t term = cur_terminal_running;
     // where is the cursor in this off-screen terminal?
-    int mem_y = terminals[cur_terminal_running].screen_y;
-    int mem_x = terminals[cur_terminal_running].screen_x;
+    int mem_y = terminals[term].screen_y;
+    int mem_x = terminals[term].screen_x;
     if (c == '\n' || c == '\r')
     {
         if (mem_y == NUM_ROWS - 1) {
             // then we were at last line, scroll up
-            scroll_up_mem();
+            scroll_up_mem(term);
         }
         else {
             mem_y++;
-            mem_x = 0;
         }
+        mem_x = 0;
     }
     else
     {
-        *(uint8_t *)(vid_addr + ((NUM_COLS * mem_y + mem_x) << 1)) = c;
-        *(uint8_t *)(vid_addr + ((NUM_COLS * mem_y + mem_x) << 1) + 1) = ATTRIB;
+        backing_row(term, mem_y)[mem_x] = (ATTRIB << 8) | c;
         if (mem_x == NUM_COLS - 1 && mem_y == NUM_ROWS - 1) {
             // if we are in bottom right corner then scroll up
-            scroll_up_mem();
+            scroll_up_mem(term);
+            mem_x = 0;
         }
         else {
             // this handles case where we are at rightmost column
@@ -412,8 +418,8 @@ void putc_mem(uint8_t c) {
         }
     }
     // save new cursor position into terminal as well
-    terminals[cur_terminal_displayed].screen_x = mem_x;
-    terminals[cur_terminal_displayed].screen_y = mem_y;
+    terminals[term].screen_x = mem_x;
+    terminals[term].screen_y = mem_y;
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
@@ -454,6 +460,31 @@ int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix) {
     return strrev(buf);
 }
 
+/* int8_t* itoa64(uint64_t value, int8_t* buf);
+ * Inputs: uint64_t value = number to convert
+ *            int8_t* buf = buffer of at least 21 bytes
+ * Return Value: buf
+ * Function: itoa in base 10 for 64 bit values (cycle counts). There's no
+ * libgcc for __udivdi3, so each digit divides the high half first and then
+ * the remainder:low half, which always fits a single divl */
+int8_t* itoa64(uint64_t value, int8_t* buf) {
+    uint32_t hi = (uint32_t)(value >> 32);
+    uint32_t lo = (uint32_t)value;
+    uint32_t rem;
+    int8_t *newbuf = buf;
+
+    do {
+        rem = hi % 10;
+        hi /= 10;
+        asm ("divl %2" : "=a"(lo), "=d"(rem) : "r"(10), "0"(lo), "1"(rem) : "cc");
+        *newbuf = '0' + rem;
+        newbuf++;
+    } while (hi || lo);
+
+    *newbuf = '\0';
+    return strrev(buf);
+}
+
 /* int8_t* strrev(int8_t* s);
  * Inputs: int8_t* s = string to reverse
  * Return Value: reversed string
@@ -557,6 +588,7 @@ void parse_command(int8_t* program_name, int8_t* arguments, int8_t* command) {
 }
 
 void do_backspace() {
+    scrollback_reset();
     // find the new position of the cursor- 2 cases
     if (screen_x == 0) {
         // go back to previous line if we are on leftmost column
@@ -579,48 +611,6 @@ void do_backspace() {
     change_blinking_cursor_pos(screen_x, screen_y);
 }
 
-/* void* memset(void* s, int32_t c, uint32_t n);
- * Inputs:    void* s = pointer to memory
- *          int32_t c = value to set memory to
- *         uint32_t n = number of bytes to set
- * Return Value: new string
- * Function: set n consecutive bytes of pointer s to value c */
-void* memset(void* s, int32_t c, uint32_t n) {
-    c &= 0xFF;
-    asm volatile ("                 \n\
-            .memset_top:            \n\
-            testl   %%ecx, %%ecx    \n\
-            jz      .memset_done    \n\
-            testl   $0x3, %%edi     \n\
-            jz      .memset_aligned \n\
-            movb    %%al, (%%edi)   \n\
-            addl    $1, %%edi       \n\
-            subl    $1, %%ecx       \n\
-            jmp     .memset_top     \n\
-            .memset_aligned:        \n\
-            movw    %%ds, %%dx      \n\
-            movw    %%dx, %%es      \n\
-            movl    %%ecx, %%edx    \n\
-            shrl    $2, %%ecx       \n\
-            andl    $0x3, %%edx     \n\
-            cld                     \n\
-            rep     stosl           \n\
-            .memset_bottom:         \n\
-            testl   %%edx, %%edx    \n\
-            jz      .memset_done    \n\
-            movb    %%al, (%%edi)   \n\
-            addl    $1, %%edi       \n\
-            subl    $1, %%edx       \n\
-            jmp     .memset_bottom  \n\
-            .memset_done:           \n\
-            "
-            :
-            : "a"(c << 24 | c << 16 | c << 8 | c), "D"(s), "c"(n)
-            : "edx", "memory", "cc"
-    );
-    return s;
-}
-
 /* void* memset_word(void* s, int32_t c, uint32_t n);
  * Description: Optimized memset_word
  * Inputs:    void* s = pointer to memory
@@ -662,51 +652,6 @@ void* memset_dword(void* s, int32_t c, uint32_t n) {
     return s;
 }
 
-/* void* memcpy(void* dest, const void* src, uint32_t n);
- * Inputs:      void* dest = destination of copy
- *         const void* src = source of copy
- *              uint32_t n = number of byets to copy
- * Return Value: pointer to dest
- * Function: copy n bytes of src to dest */
-void* memcpy(void* dest, const void* src, uint32_t n) {
-    asm volatile ("                 \n\
-            .memcpy_top:            \n\
-            testl   %%ecx, %%ecx    \n\
-            jz      .memcpy_done    \n\
-            testl   $0x3, %%edi     \n\
-            jz      .memcpy_aligned \n\
-            movb    (%%esi), %%al   \n\
-            movb    %%al, (%%edi)   \n\
-            addl    $1, %%edi       \n\
-            addl    $1, %%esi       \n\
-            subl    $1, %%ecx       \n\
-            jmp     .memcpy_top     \n\
-            .memcpy_aligned:        \n\
-            movw    %%ds, %%dx      \n\
-            movw    %%dx, %%es      \n\
-            movl    %%ecx, %%edx    \n\
-            shrl    $2, %%ecx       \n\
-            andl    $0x3, %%edx     \n\
-            cld                     \n\
-            rep     movsl           \n\
-            .memcpy_bottom:         \n\
-            testl   %%edx, %%edx    \n\
-            jz      .memcpy_done    \n\
-            movb    (%%esi), %%al   \n\
-            movb    %%al, (%%edi)   \n\
-            addl    $1, %%edi       \n\
-            addl    $1, %%esi       \n\
-            subl    $1, %%edx       \n\
-            jmp     .memcpy_bottom  \n\
-            .memcpy_done:           \n\
-            "
-            :
-            : "S"(src), "D"(dest), "c"(n)
-            : "eax", "edx", "memory", "cc"
-    );
-    return dest;
-}
-
 /* void* memmove(void* dest, const void* src, uint32_t n);
  * Description: Optimized memmove (used for overlapping memory areas)
  * Inputs:      void* dest = destination of move
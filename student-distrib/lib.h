@@ -34,10 +34,17 @@ void putc_mem(uint8_t c);
 int32_t puts(int8_t *s);
 int32_t puts_mem(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
+int8_t *itoa64(uint64_t value, int8_t* buf);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
 void clear(void);
 
+// what memcpy / memset may use, from CPUID (memcpy.c)
+#define MEM_FEAT_ERMS   0x1     // fast rep movsb / stosb
+#define MEM_FEAT_NT     0x2     // SSE2 movnti, for copies bigger than the cache
+void mem_init(void);
+uint32_t mem_get_features(void);
+
 void* memset(void* s, int32_t c, uint32_t n);
 void* memset_word(void* s, int32_t c, uint32_t n);
 void* memset_dword(void* s, int32_t c, uint32_t n);
@@ -55,6 +62,15 @@ int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 // text mode reference: https://wiki.osdev.org/Printing_To_Screen
 void change_write_head(int8_t new_x, int8_t new_y);
 
+// moves the hardware cursor only (four port writes)
+void change_blinking_cursor_pos(int32_t x, int32_t y);
+
+// scroll the screen / a terminal's backing page up a line
+void scroll_up();
+void scroll_up_mem(uint32_t term);
+// row y of a terminal's backing page, which is a ring of rows
+uint16_t* backing_row(uint32_t term, uint32_t y);
+
 // this is like puts except without change write head which is annoying sometimes
 void print_at_coordinates(int8_t *buf, int8_t new_x, int8_t new_y);
 void bluescreen();
@@ -82,6 +98,55 @@ static inline void flush_tlb() {
     );
 }
 
+/* Read the processor's time-stamp counter. Used for cycle-level latency
+ * stats (block I/O, syscalls, interrupts) */
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/* Find first set, like ffs(3): 1 + the index of the lowest set bit, 0 if
+ * there is none. One bsf instead of a loop over the bits */
+static inline int32_t ffs(uint32_t x) {
+    int32_t bit;
+    if (!x) {
+        return 0;
+    }
+    asm ("bsfl %1, %0" : "=r"(bit) : "rm"(x) : "cc");
+    return bit + 1;
+}
+
+/* Execute CPUID for the given leaf (subleaf 0) */
+static inline void cpuid(uint32_t leaf, uint32_t *a, uint32_t *b, uint32_t *c, uint32_t *d) {
+    asm volatile ("cpuid" : "=a"(*a), "=b"(*b), "=c"(*c), "=d"(*d) : "0"(leaf), "2"(0));
+}
+
+/* Model specific register access */
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    asm volatile ("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t val) {
+    asm volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)val), "d"((uint32_t)(val >> 32)));
+}
+
+/* Divide a 64-bit value by a 32-bit one with a single divl, since we don't
+ * link libgcc and so can't use __udivdi3. Saturates instead of raising #DE
+ * if the quotient doesn't fit in 32 bits */
+static inline uint32_t div64_32(uint64_t n, uint32_t d) {
+    uint32_t lo = (uint32_t)n;
+    uint32_t hi = (uint32_t)(n >> 32);
+    uint32_t q;
+    if (d == 0 || hi >= d) {
+        return 0xFFFFFFFF;
+    }
+    asm ("divl %2" : "=a"(q), "=d"(hi) : "r"(d), "0"(lo), "1"(hi) : "cc");
+    return q;
+}
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
@@ -149,7 +214,7 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %k1, (%w0)"     \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
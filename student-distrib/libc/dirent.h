@@ -0,0 +1,35 @@
+/**
+ *	@file dirent.h
+ *
+ *	Directory entries as returned by the getdents syscall
+ */
+#ifndef DIRENT_H
+#define DIRENT_H
+
+#include "../types.h"
+
+#define DT_CHR		0	///< character device (the RTC)
+#define DT_DIR		1	///< directory
+#define DT_REG		2	///< regular file
+#define DT_FIFO		3	///< pipe
+
+/**
+ *	One directory entry. Entries are packed back to back in the user buffer,
+ *	use `d_reclen` to step from one to the next. Every field is at an offset
+ *	of its own size, so the layout is the same for any compiler: d_name
+ *	starts at 12, right where sizeof(struct dirent) ends
+ */
+struct dirent {
+	uint32_t d_ino;		///< inode number
+	uint32_t d_size;	///< size of the file in bytes
+	uint16_t d_reclen;	///< length of this record, a multiple of 4
+	uint8_t d_type;		///< DT_* type of the file
+	uint8_t d_pad;		///< always 0
+	char d_name[];		///< NUL terminated name
+};
+
+/// bytes taken by a record holding a name of `namelen` characters
+#define DIRENT_RECLEN(namelen) \
+	((sizeof(struct dirent) + (namelen) + 1 + 3) & ~3)
+
+#endif
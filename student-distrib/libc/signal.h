@@ -82,6 +82,22 @@ struct sigaction {
 
 typedef struct sigaction sigaction_t;
 
+// si_code, who sent a signal
+#define SI_USER		0		///< kill
+#define SI_QUEUE	-1		///< sigqueue
+#define SI_KERNEL	0x80	///< the kernel, or the info was lost
+
+/**
+ *	What a signal carries. A handler installed with SA_SIGINFO gets a pointer
+ *	to it as its second argument, reads from a signalfd return them
+ */
+typedef struct siginfo {
+	int32_t si_signo;	///< signal number
+	int32_t si_code;	///< SI_*
+	int32_t si_pid;		///< process that sent it
+	int32_t si_value;	///< value given to sigqueue, 0 otherwise
+} siginfo_t;
+
 #endif // ASM
 
 #endif
\ No newline at end of file
@@ -0,0 +1,24 @@
+/**
+ *	@file sys/uio.h
+ *
+ *	Vectored I/O
+ *
+ *	Reference: http://pubs.opengroup.org/onlinepubs/7908799/xsh/sysuio.h.html
+ */
+#ifndef SYS_UIO_H
+#define SYS_UIO_H
+
+#include "types.h"
+
+/// Most buffers one readv / writev call takes
+#define IOV_MAX		16
+
+/**
+ *	One buffer of a readv / writev
+ */
+struct iovec {
+	void	*iov_base;	///< start of the buffer
+	size_t	iov_len;	///< its length in bytes
+};
+
+#endif
@@ -0,0 +1,294 @@
+/* memcpy.c - memcpy and memset, picked by size and by what the CPU has
+ * vim:ts=4 noexpandtab
+ *
+ * Most calls are small (structs, a line of text) and a rep instruction's
+ * startup costs more than the copy, so those get a plain dword loop. Medium
+ * sizes use rep movsb / stosb when the CPU has ERMS (fast short rep strings,
+ * CPUID 7 EBX bit 9), which is as fast as anything else there, or rep movsl
+ * otherwise. Copies of MEM_NT_MIN and up (4MB pages in fork, zeroing a
+ * program's page) don't fit in the cache anyway, so they use movnti stores
+ * that skip it instead of pushing out everything else.
+ *
+ * Only lib.h is needed, so a host program can link this file to benchmark it
+ * (tools/membench.c).
+ */
+
+#include "lib.h"
+
+#define MEM_SMALL       64              // below this, no rep instruction
+#define MEM_NT_MIN      (256 * 1024)    // from this on, non-temporal stores
+
+#define CPUID_EDX_SSE2      (1 << 26)   // leaf 1, movnti and sfence
+#define CPUID_EBX_ERMS      (1 << 9)    // leaf 7
+
+static uint32_t mem_features;
+
+/* void mem_init(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: checks the CPU for ERMS and SSE2. Until then the copies only use
+ *           what every i386 has */
+void mem_init(void) {
+    uint32_t a, b, c, d, max;
+    cpuid(0, &max, &b, &c, &d);
+    cpuid(1, &a, &b, &c, &d);
+    if (d & CPUID_EDX_SSE2) {
+        mem_features |= MEM_FEAT_NT;
+    }
+    if (max >= 7) {
+        cpuid(7, &a, &b, &c, &d);
+        if (b & CPUID_EBX_ERMS) {
+            mem_features |= MEM_FEAT_ERMS;
+        }
+    }
+}
+
+/* uint32_t mem_get_features(void);
+ * Return Value: the MEM_FEAT_* mem_init found */
+uint32_t mem_get_features(void) {
+    return mem_features;
+}
+
+// n < MEM_SMALL: dwords, then the last bytes
+static void memcpy_small(void* dest, const void* src, uint32_t n) {
+    uint32_t tail;
+    asm volatile ("                     \n\
+            movl    %%ecx, %%edx        \n\
+            shrl    $2, %%ecx           \n\
+            jz      2f                  \n\
+            1:                          \n\
+            movl    (%%esi), %%eax      \n\
+            movl    %%eax, (%%edi)      \n\
+            addl    $4, %%esi           \n\
+            addl    $4, %%edi           \n\
+            decl    %%ecx               \n\
+            jnz     1b                  \n\
+            2:                          \n\
+            andl    $0x3, %%edx         \n\
+            jz      4f                  \n\
+            3:                          \n\
+            movb    (%%esi), %%al       \n\
+            movb    %%al, (%%edi)       \n\
+            incl    %%esi               \n\
+            incl    %%edi               \n\
+            decl    %%edx               \n\
+            jnz     3b                  \n\
+            4:                          \n\
+            "
+            : "+S"(src), "+D"(dest), "+c"(n), "=&d"(tail)
+            :
+            : "eax", "memory", "cc"
+    );
+}
+
+// aligns dest to a dword with single bytes, then rep movsl
+static void memcpy_dwords(void* dest, const void* src, uint32_t n) {
+    uint32_t tail;
+    asm volatile ("                     \n\
+            1:                          \n\
+            testl   %%ecx, %%ecx        \n\
+            jz      3f                  \n\
+            testl   $0x3, %%edi         \n\
+            jz      2f                  \n\
+            movb    (%%esi), %%al       \n\
+            movb    %%al, (%%edi)       \n\
+            incl    %%esi               \n\
+            incl    %%edi               \n\
+            decl    %%ecx               \n\
+            jmp     1b                  \n\
+            2:                          \n\
+            movw    %%ds, %%dx          \n\
+            movw    %%dx, %%es          \n\
+            movl    %%ecx, %%edx        \n\
+            shrl    $2, %%ecx           \n\
+            andl    $0x3, %%edx         \n\
+            rep     movsl               \n\
+            movl    %%edx, %%ecx        \n\
+            rep     movsb               \n\
+            3:                          \n\
+            "
+            : "+S"(src), "+D"(dest), "+c"(n), "=&d"(tail)
+            :
+            : "eax", "memory", "cc"
+    );
+}
+
+static void memcpy_erms(void* dest, const void* src, uint32_t n) {
+    uint32_t seg;
+    asm volatile ("                     \n\
+            movw    %%ds, %%dx          \n\
+            movw    %%dx, %%es          \n\
+            rep     movsb               \n\
+            "
+            : "+S"(src), "+D"(dest), "+c"(n), "=&d"(seg)
+            :
+            : "memory", "cc"
+    );
+}
+
+// 16 bytes a round with movnti, which writes around the cache. The sfence
+// orders them with whatever stores come after
+static void memcpy_nt(void* dest, const void* src, uint32_t n) {
+    uint32_t head = -(uint32_t)dest & 0x3;
+    uint32_t rounds, tmp;
+    memcpy_small(dest, src, head);
+    dest = (uint8_t*)dest + head;
+    src = (const uint8_t*)src + head;
+    n -= head;
+    rounds = n >> 4;
+    asm volatile ("                     \n\
+            1:                          \n\
+            movl    (%%esi), %%eax      \n\
+            movl    4(%%esi), %%edx     \n\
+            movnti  %%eax, (%%edi)      \n\
+            movnti  %%edx, 4(%%edi)     \n\
+            movl    8(%%esi), %%eax     \n\
+            movl    12(%%esi), %%edx    \n\
+            movnti  %%eax, 8(%%edi)     \n\
+            movnti  %%edx, 12(%%edi)    \n\
+            addl    $16, %%esi          \n\
+            addl    $16, %%edi          \n\
+            decl    %%ecx               \n\
+            jnz     1b                  \n\
+            sfence                      \n\
+            "
+            : "+S"(src), "+D"(dest), "+c"(rounds), "=&d"(tmp)
+            :
+            : "eax", "memory", "cc"
+    );
+    memcpy_small(dest, src, n & 0xF);
+}
+
+/* void* memcpy(void* dest, const void* src, uint32_t n);
+ * Inputs:      void* dest = destination of copy
+ *         const void* src = source of copy
+ *              uint32_t n = number of byets to copy
+ * Return Value: pointer to dest
+ * Function: copy n bytes of src to dest */
+void* memcpy(void* dest, const void* src, uint32_t n) {
+    if (n < MEM_SMALL) {
+        memcpy_small(dest, src, n);
+    } else if (n >= MEM_NT_MIN && (mem_features & MEM_FEAT_NT)) {
+        memcpy_nt(dest, src, n);
+    } else if (mem_features & MEM_FEAT_ERMS) {
+        memcpy_erms(dest, src, n);
+    } else {
+        memcpy_dwords(dest, src, n);
+    }
+    return dest;
+}
+
+// n < MEM_SMALL, c already in all four bytes
+static void memset_small(void* s, uint32_t c, uint32_t n) {
+    uint32_t tail;
+    asm volatile ("                     \n\
+            movl    %%ecx, %%edx        \n\
+            shrl    $2, %%ecx           \n\
+            jz      2f                  \n\
+            1:                          \n\
+            movl    %%eax, (%%edi)      \n\
+            addl    $4, %%edi           \n\
+            decl    %%ecx               \n\
+            jnz     1b                  \n\
+            2:                          \n\
+            andl    $0x3, %%edx         \n\
+            jz      4f                  \n\
+            3:                          \n\
+            movb    %%al, (%%edi)       \n\
+            incl    %%edi               \n\
+            decl    %%edx               \n\
+            jnz     3b                  \n\
+            4:                          \n\
+            "
+            : "+D"(s), "+c"(n), "=&d"(tail)
+            : "a"(c)
+            : "memory", "cc"
+    );
+}
+
+static void memset_dwords(void* s, uint32_t c, uint32_t n) {
+    uint32_t tail;
+    asm volatile ("                     \n\
+            1:                          \n\
+            testl   %%ecx, %%ecx        \n\
+            jz      3f                  \n\
+            testl   $0x3, %%edi         \n\
+            jz      2f                  \n\
+            movb    %%al, (%%edi)       \n\
+            incl    %%edi               \n\
+            decl    %%ecx               \n\
+            jmp     1b                  \n\
+            2:                          \n\
+            movw    %%ds, %%dx          \n\
+            movw    %%dx, %%es          \n\
+            movl    %%ecx, %%edx        \n\
+            shrl    $2, %%ecx           \n\
+            andl    $0x3, %%edx         \n\
+            rep     stosl               \n\
+            movl    %%edx, %%ecx        \n\
+            rep     stosb               \n\
+            3:                          \n\
+            "
+            : "+D"(s), "+c"(n), "=&d"(tail)
+            : "a"(c)
+            : "memory", "cc"
+    );
+}
+
+static void memset_erms(void* s, uint32_t c, uint32_t n) {
+    uint32_t seg;
+    asm volatile ("                     \n\
+            movw    %%ds, %%dx          \n\
+            movw    %%dx, %%es          \n\
+            rep     stosb               \n\
+            "
+            : "+D"(s), "+c"(n), "=&d"(seg)
+            : "a"(c)
+            : "memory", "cc"
+    );
+}
+
+static void memset_nt(void* s, uint32_t c, uint32_t n) {
+    uint32_t head = -(uint32_t)s & 0x3;
+    uint32_t rounds;
+    memset_small(s, c, head);
+    s = (uint8_t*)s + head;
+    n -= head;
+    rounds = n >> 4;
+    asm volatile ("                     \n\
+            1:                          \n\
+            movnti  %%eax, (%%edi)      \n\
+            movnti  %%eax, 4(%%edi)     \n\
+            movnti  %%eax, 8(%%edi)     \n\
+            movnti  %%eax, 12(%%edi)    \n\
+            addl    $16, %%edi          \n\
+            decl    %%ecx               \n\
+            jnz     1b                  \n\
+            sfence                      \n\
+            "
+            : "+D"(s), "+c"(rounds)
+            : "a"(c)
+            : "memory", "cc"
+    );
+    memset_small(s, c, n & 0xF);
+}
+
+/* void* memset(void* s, int32_t c, uint32_t n);
+ * Inputs:    void* s = pointer to memory
+ *          int32_t c = value to set memory to
+ *         uint32_t n = number of bytes to set
+ * Return Value: new string
+ * Function: set n consecutive bytes of pointer s to value c */
+void* memset(void* s, int32_t c, uint32_t n) {
+    uint32_t fill = (c & 0xFF) * 0x01010101;
+    if (n < MEM_SMALL) {
+        memset_small(s, fill, n);
+    } else if (n >= MEM_NT_MIN && (mem_features & MEM_FEAT_NT)) {
+        memset_nt(s, fill, n);
+    } else if (mem_features & MEM_FEAT_ERMS) {
+        memset_erms(s, fill, n);
+    } else {
+        memset_dwords(s, fill, n);
+    }
+    return s;
+}
@@ -0,0 +1,161 @@
+#include "uaccess.h"
+#include "../lib.h"
+#include "../errno.h"
+#include "../paging.h"
+
+// An instruction that touches user memory gets an entry in the __ex_table
+// section saying where to continue if it faults. The linker collects the
+// entries and defines __start/__stop for the section since its name is a
+// valid C identifier
+typedef struct exception_table_entry {
+  uint32_t insn;    ///< address of the instruction allowed to fault
+  uint32_t fixup;   ///< where to resume if it does
+} exception_table_entry_t;
+
+extern exception_table_entry_t __start___ex_table[];
+extern exception_table_entry_t __stop___ex_table[];
+
+#define EX_TABLE(from, to)          \
+  ".section __ex_table,\"a\"\n"     \
+  ".align 4\n"                      \
+  ".long " #from ", " #to "\n"      \
+  ".previous\n"
+
+uint32_t search_exception_table(uint32_t eip) {
+  exception_table_entry_t *e;
+  for (e = __start___ex_table; e < __stop___ex_table; e++) {
+    if (e->insn == eip) {
+      return e->fixup;
+    }
+  }
+  return 0;
+}
+
+// how many of the size bytes at a are in present user pages, counting from
+// a up to the first page that isn't
+static uint32_t user_bytes(uint32_t a, uint32_t size) {
+  uint32_t start = a, end = a + size, next;
+  uint32_t pde, *pt;
+  // a page at a time, or 4MB at a time where the directory maps a 4MB page
+  while (a < end) {
+    pde = page_directory[a / FOURMB];
+    if ((pde & (PRESENT_BIT | USER_BIT)) != (PRESENT_BIT | USER_BIT)) {
+      break;
+    }
+    if (pde & PAGE_SIZE_BIT) {
+      next = (a & FIRST_TEN_BITS_MASK) + FOURMB;
+    }
+    else {
+      pt = (uint32_t *)(pde & FIRST_TWENTY_BITS);
+      if ((pt[(a & NEXT_TEN_BITS) / FOURKB] & (PRESENT_BIT | USER_BIT)) != (PRESENT_BIT | USER_BIT)) {
+        break;
+      }
+      next = (a & FIRST_TWENTY_BITS) + FOURKB;
+    }
+    // next == 0 is the end of the address space
+    if (next == 0 || next >= end) {
+      return size;
+    }
+    a = next;
+  }
+  return a - start;
+}
+
+int access_ok(const void *addr, uint32_t size) {
+  uint32_t a = (uint32_t)addr;
+  if (a < USER_MEM_START || a + size < a) {
+    return 0;
+  }
+  return user_bytes(a, size) == size;
+}
+
+// rep movsl for the bulk and rep movsb for the tail. If either faults ecx
+// still says how much was left, so the fixups just turn that into bytes.
+static inline uint32_t copy_user_generic(void *to, const void *from, uint32_t n) {
+  uint32_t d0, d1;
+  asm volatile (
+    "0: rep movsl\n"
+    "   movl %3, %0\n"
+    "1: rep movsb\n"
+    "   jmp 3f\n"
+    "2: leal (%3, %0, 4), %0\n"
+    "3:\n"
+    EX_TABLE(0b, 2b)
+    EX_TABLE(1b, 3b)
+    : "=&c"(n), "=&D"(d0), "=&S"(d1)
+    : "r"(n & 3), "0"(n >> 2), "1"(to), "2"(from)
+    : "memory"
+  );
+  return n;
+}
+
+uint32_t __copy_to_user(void *to, const void *from, uint32_t n) {
+  return copy_user_generic(to, from, n);
+}
+
+uint32_t __copy_from_user(void *to, const void *from, uint32_t n) {
+  uint32_t left = copy_user_generic(to, from, n);
+  if (left) {
+    // don't hand the caller whatever was on its stack
+    memset((uint8_t *)to + (n - left), 0, left);
+  }
+  return left;
+}
+
+uint32_t copy_to_user(void *to, const void *from, uint32_t n) {
+  if (!access_ok(to, n)) {
+    return n;
+  }
+  return copy_user_generic(to, from, n);
+}
+
+uint32_t copy_from_user(void *to, const void *from, uint32_t n) {
+  if (!access_ok(from, n)) {
+    memset(to, 0, n);
+    return n;
+  }
+  return __copy_from_user(to, from, n);
+}
+
+int32_t strncpy_from_user(int8_t *dst, const int8_t *src, int32_t count) {
+  int32_t res;
+  uint32_t d0, d1, d2;
+  int32_t avail;
+  if (count <= 0) {
+    return 0;
+  }
+  if ((uint32_t)src < USER_MEM_START) {
+    return -EFAULT;
+  }
+  // a short string can sit right below the end of the user mapping, so only
+  // copy as far as the mapping goes and see whether the NUL came before that
+  if ((uint32_t)count > -(uint32_t)src) {
+    count = -(uint32_t)src;
+  }
+  avail = user_bytes((uint32_t)src, count);
+  if (avail == 0) {
+    return -EFAULT;
+  }
+  // res - count at the end is how many bytes came before the NUL
+  asm volatile (
+    "0: lodsb\n"
+    "   stosb\n"
+    "   testb %%al, %%al\n"
+    "   jz 1f\n"
+    "   decl %1\n"
+    "   jnz 0b\n"
+    "1: subl %1, %0\n"
+    "   jmp 3f\n"
+    "2: movl %5, %0\n"
+    "3:\n"
+    EX_TABLE(0b, 2b)
+    : "=&d"(res), "=&c"(count), "=&a"(d0), "=&S"(d1), "=&D"(d2)
+    : "i"(-EFAULT), "0"(avail), "1"(avail), "3"(src), "4"(dst)
+    : "memory"
+  );
+  // no NUL before the mapping ended
+  if (res == avail && avail < count) {
+    return -EFAULT;
+  }
+  return res;
+}
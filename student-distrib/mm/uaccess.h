@@ -0,0 +1,62 @@
+/**
+ * @file uaccess.h
+ * @brief Copying to and from user memory. The copies run at full speed with
+ * no per-byte checks. If a user pointer turns out to be bad, the page fault
+ * handler finds the faulting instruction in the exception table and resumes
+ * at its fixup, so the copy stops and returns instead of crashing the kernel.
+ */
+#ifndef UACCESS_H
+#define UACCESS_H
+
+#include "../types.h"
+
+// everything below this is the kernel's own memory (identity mapped), user
+// programs, their stacks, vidmap and the signal page all live above it
+#define USER_MEM_START 0x08000000
+
+/**
+ * @brief Checks that [addr, addr + size) is in user space and that every page
+ * of it is present and mapped with USER_BIT. The kernel's own pages up there
+ * (the kmalloc heap, the zeropage window) are supervisor only, and the copies
+ * run in ring 0 so they wouldn't fault on them
+ * @return int 1 if the task may touch the range, 0 if not
+ */
+int access_ok(const void *addr, uint32_t size);
+
+/**
+ * @brief Copies n bytes to user memory
+ * @return uint32_t number of bytes that could NOT be copied, 0 on success
+ */
+uint32_t copy_to_user(void *to, const void *from, uint32_t n);
+
+/**
+ * @brief Copies n bytes from user memory
+ * @return uint32_t number of bytes that could NOT be copied, 0 on success. The
+ * part of the kernel buffer that wasn't copied is zeroed
+ */
+uint32_t copy_from_user(void *to, const void *from, uint32_t n);
+
+/**
+ * @brief Copies a NUL terminated string from user memory, at most count bytes
+ * including the NUL
+ * @return int32_t length of the string (without the NUL), count if there was
+ * no NUL in the first count bytes (dst isn't terminated then), or -EFAULT
+ */
+int32_t strncpy_from_user(int8_t *dst, const int8_t *src, int32_t count);
+
+/**
+ * @brief copy_to_user / copy_from_user without the access_ok check. For file
+ * operations, whose buffer was checked by sys_read / sys_write and which the
+ * kernel also calls with its own buffers
+ */
+uint32_t __copy_to_user(void *to, const void *from, uint32_t n);
+uint32_t __copy_from_user(void *to, const void *from, uint32_t n);
+
+/**
+ * @brief Looks up the fixup for a faulting kernel instruction
+ * @param eip address of the instruction that faulted
+ * @return uint32_t address to resume at, 0 if the fault wasn't expected
+ */
+uint32_t search_exception_table(uint32_t eip);
+
+#endif
@@ -0,0 +1,189 @@
+#include "zeropage.h"
+#include "../paging.h"
+#include "../lib.h"
+#include "../errno.h"
+#include "../fs/procfs.h"
+
+typedef struct s_zeropool {
+	const char	*name;
+	uint32_t	*pages;		///< physical addresses of the zeroed pages, a stack
+	uint32_t	count;		///< pages ready
+	uint32_t	max;
+	uint32_t	page_size;
+	uint32_t	hits;		///< allocations the pool had a page for
+	uint32_t	misses;		///< allocations that had to zero a page themselves
+	uint32_t	filling;	///< page zeropage_idle is zeroing, 0 if none
+	uint32_t	filled;		///< bytes of it zeroed so far
+	uint32_t	refilling;	///< zeropage_idle is allocating, don't reclaim from under it
+	uint32_t	reclaimed;	///< pages given back because the allocator ran out
+} zeropool_t;
+
+static uint32_t pages_4kb[ZEROPAGE_POOL_4KB];
+static uint32_t pages_4mb[ZEROPAGE_POOL_4MB];
+
+static zeropool_t pool_4kb = { "4KB", pages_4kb, 0, ZEROPAGE_POOL_4KB, FOURKB };
+static zeropool_t pool_4mb = { "4MB", pages_4mb, 0, ZEROPAGE_POOL_4MB, FOURMB };
+
+// small frames first, they're what a fault needs
+static zeropool_t *pools[] = { &pool_4kb, &pool_4mb };
+
+static inline void invlpg(uint32_t addr) {
+  asm volatile ("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+// the windows are only touched with interrupts off, so one of each is enough
+static void *zeropage_map(zeropool_t *pool, uint32_t phys) {
+  if (pool->page_size == FOURKB) {
+    page_table[ZEROPAGE_WINDOW_4KB / FOURKB] = phys | PRESENT_BIT | READ_WRITE_BIT;
+    invlpg(ZEROPAGE_WINDOW_4KB);
+    return (void *)ZEROPAGE_WINDOW_4KB;
+  }
+  page_directory[ZEROPAGE_WINDOW_4MB / FOURMB] = phys | PRESENT_BIT | READ_WRITE_BIT | PAGE_SIZE_BIT;
+  invlpg(ZEROPAGE_WINDOW_4MB);
+  return (void *)ZEROPAGE_WINDOW_4MB;
+}
+
+// zeroes len bytes at off in the page at phys, back to not present after
+static void zeropage_clear(zeropool_t *pool, uint32_t phys, uint32_t off, uint32_t len) {
+  uint8_t *page = zeropage_map(pool, phys);
+  memset(page + off, 0, len);
+  if (pool->page_size == FOURKB) {
+    page_table[ZEROPAGE_WINDOW_4KB / FOURKB] = READ_WRITE_BIT;
+  }
+  else {
+    page_directory[ZEROPAGE_WINDOW_4MB / FOURMB] = READ_WRITE_BIT;
+  }
+  invlpg((uint32_t)page);
+}
+
+static int32_t zeropage_get_free(zeropool_t *pool, uint32_t *phys) {
+  *phys = 0;
+  return pool->page_size == FOURKB ? alloc_4kb_mem(phys) : alloc_4mb_mem(phys);
+}
+
+static int32_t zeropage_alloc(zeropool_t *pool, uint32_t *phys_addr) {
+  uint32_t flags;
+  int32_t ret = 0;
+  cli_and_save(flags);
+  if (pool->count) {
+    *phys_addr = pool->pages[--pool->count];
+    pool->hits++;
+  }
+  else {
+    // zeroing a 4MB page here holds interrupts off for a while, but it only
+    // happens when the tasks haven't been idle enough to keep up
+    pool->misses++;
+    ret = zeropage_get_free(pool, phys_addr);
+    if (ret == 0) {
+      zeropage_clear(pool, *phys_addr, 0, pool->page_size);
+    }
+  }
+  restore_flags(flags);
+  return ret;
+}
+
+// gives a page back to the allocator, the half zeroed one first since it has
+// the least work in it
+static int32_t zeropage_reclaim(zeropool_t *pool) {
+  uint32_t flags, phys;
+  cli_and_save(flags);
+  if (pool->refilling) {
+    restore_flags(flags);
+    return -ENOMEM;
+  }
+  if (pool->filling) {
+    phys = pool->filling;
+    pool->filling = 0;
+    pool->filled = 0;
+  }
+  else if (pool->count) {
+    phys = pool->pages[--pool->count];
+  }
+  else {
+    restore_flags(flags);
+    return -ENOMEM;
+  }
+  if (pool->page_size == FOURKB) {
+    page_alloc_free_4KB(phys);
+  }
+  else {
+    page_alloc_free_4MB(phys);
+  }
+  pool->reclaimed++;
+  restore_flags(flags);
+  return 0;
+}
+
+int32_t zeropage_reclaim_4kb() {
+  return zeropage_reclaim(&pool_4kb);
+}
+
+int32_t zeropage_reclaim_4mb() {
+  return zeropage_reclaim(&pool_4mb);
+}
+
+int32_t zeropage_alloc_4kb(uint32_t *phys_addr) {
+  return zeropage_alloc(&pool_4kb, phys_addr);
+}
+
+int32_t zeropage_alloc_4mb(uint32_t *phys_addr) {
+  return zeropage_alloc(&pool_4mb, phys_addr);
+}
+
+int32_t zeropage_idle() {
+  uint32_t i, len;
+  for (i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+    zeropool_t *pool = pools[i];
+    if (pool->count == pool->max) {
+      continue;
+    }
+    if (!pool->filling) {
+      // out of memory, don't keep what's left from everyone else (and
+      // don't take it out of our own pool either)
+      pool->refilling = 1;
+      if (zeropage_get_free(pool, &pool->filling) < 0) {
+        pool->filling = 0;
+      }
+      pool->refilling = 0;
+      if (!pool->filling) {
+        continue;
+      }
+    }
+    len = pool->page_size - pool->filled;
+    if (len > ZEROPAGE_STEP) {
+      len = ZEROPAGE_STEP;
+    }
+    zeropage_clear(pool, pool->filling, pool->filled, len);
+    pool->filled += len;
+    if (pool->filled == pool->page_size) {
+      pool->pages[pool->count++] = pool->filling;
+      pool->filling = 0;
+      pool->filled = 0;
+    }
+    return 1;
+  }
+  return 0;
+}
+
+/*
+/proc/zeropool, one line per page size: zeroed pages ready out of the most
+kept, how many allocations found one ready (hits) or had to zero their
+own (misses), and how many pages went back because memory ran out.
+*/
+static void zeropage_show(proc_buf_t *pb) {
+  uint32_t i;
+  proc_puts(pb, "size  ready   max       hits     misses  reclaimed\n");
+  for (i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+    proc_putpad(pb, pools[i]->name, 4);
+    proc_putnum(pb, pools[i]->count, 7);
+    proc_putnum(pb, pools[i]->max, 6);
+    proc_putnum(pb, pools[i]->hits, 11);
+    proc_putnum(pb, pools[i]->misses, 11);
+    proc_putnum(pb, pools[i]->reclaimed, 11);
+    proc_puts(pb, "\n");
+  }
+}
+
+void zeropage_init() {
+  procfs_register("zeropool", zeropage_show);
+}
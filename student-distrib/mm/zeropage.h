@@ -0,0 +1,63 @@
+/**
+ * @file zeropage.h
+ * @brief Pools of physical pages that are already zeroed. Tasks that sleep
+ * in the kernel spend the time zeroing free pages a step at a time
+ * (zeropage_idle), so a 4KB frame or a 4MB page that has to start out empty,
+ * like a new program's stack, is usually ready to go, and so does the kernel
+ * task's idle loop on every timer tick it gets. When a pool is empty the page
+ * is allocated and zeroed on the spot instead. The pools are only a cache:
+ * when the allocator runs out it takes their pages back (zeropage_reclaim_*).
+ */
+#ifndef ZEROPAGE_H
+#define ZEROPAGE_H
+
+#include "../types.h"
+
+#define ZEROPAGE_POOL_4KB	32				///< zeroed 4KB frames kept ready
+#define ZEROPAGE_POOL_4MB	2				///< zeroed 4MB pages kept ready
+#define ZEROPAGE_STEP		0x10000			///< bytes zeroed per idle step
+
+#define ZEROPAGE_WINDOW_4KB	0x003FF000		///< where a frame is mapped to zero it, last entry of the first page table
+#define ZEROPAGE_WINDOW_4MB	0xC0800000		///< where a 4MB page is mapped to zero it
+
+/**
+ * @brief Registers /proc/zeropool
+ */
+void zeropage_init();
+
+/**
+ * @brief Allocates a 4KB frame full of zeroes, like alloc_4kb_mem
+ * @param phys_addr where the frame's physical address goes
+ * @return int32_t 0 on success, -ENOMEM
+ */
+int32_t zeropage_alloc_4kb(uint32_t *phys_addr);
+
+/**
+ * @brief Allocates a 4MB page full of zeroes, like alloc_4mb_mem
+ * @param phys_addr where the page's physical address goes
+ * @return int32_t 0 on success, -ENOMEM
+ */
+int32_t zeropage_alloc_4mb(uint32_t *phys_addr);
+
+/**
+ * @brief Gives one 4KB frame from the pool back to the allocator. Called by
+ * alloc_4kb_mem when it runs out
+ * @return int32_t 0 if a frame was freed, -ENOMEM if the pool is empty
+ */
+int32_t zeropage_reclaim_4kb();
+
+/**
+ * @brief Gives one 4MB page from the pool back to the allocator. Called by
+ * alloc_4mb_mem when it runs out
+ * @return int32_t 0 if a page was freed, -ENOMEM if the pool is empty
+ */
+int32_t zeropage_reclaim_4mb();
+
+/**
+ * @brief Zeroes up to ZEROPAGE_STEP bytes toward a pool that isn't full.
+ * Called with interrupts off by a task that has nothing else to do
+ * @return int32_t 1 if there was work, 0 if the pools are full (or memory is)
+ */
+int32_t zeropage_idle();
+
+#endif
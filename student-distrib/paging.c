@@ -2,6 +2,7 @@
 #include "lib.h"
 #include "task.h"
 #include "errno.h"
+#include "mm/zeropage.h"
 
 // -------------------------------- BEGIN IMPORTANT STUFF --------------------------------------------------------------- //
 
@@ -250,10 +251,15 @@ int32_t alloc_4mb_mem(uint32_t* phys_addr) {
     return -EINVAL;
   }
   if (*phys_addr != 0) {
-    increase_4mb_refcount(*phys_addr);
+    return increase_4mb_refcount(*phys_addr);
   }
   else {
-    uint32_t ret = alloc_empty_4mb_mem();
+    // signed, so -ENOMEM doesn't pass for an address
+    int32_t ret = alloc_empty_4mb_mem();
+    // the zeroed page pool holds on to pages nobody asked for yet
+    if (ret == -ENOMEM && zeropage_reclaim_4mb() == 0) {
+      ret = alloc_empty_4mb_mem();
+    }
     if (ret > 0) {
       *phys_addr = ret;
       return 0;
@@ -295,10 +301,14 @@ int32_t alloc_4kb_mem(uint32_t* phys_addr) {
     return -EINVAL;
   }
   if (*phys_addr != 0) {
-    increase_4kb_refcount(*phys_addr);
+    return increase_4kb_refcount(*phys_addr);
   }
   else {
-    uint32_t ret = alloc_empty_4kb_mem();
+    // signed, so -ENOMEM doesn't pass for an address
+    int32_t ret = alloc_empty_4kb_mem();
+    if (ret == -ENOMEM && zeropage_reclaim_4kb() == 0) {
+      ret = alloc_empty_4kb_mem();
+    }
     if (ret > 0) {
       *phys_addr = ret;
       return 0;
@@ -0,0 +1,142 @@
+#include "ring.h"
+#include "task.h"
+#include "lib.h"
+#include "errno.h"
+#include "system_calls.h"
+#include "x86_desc.h"
+#include "fs/vfs.h"
+#include "mm/uaccess.h"
+
+int32_t sys_ring_setup(ring_t *ring, uint32_t flags) {
+  task *t = get_task_in_running_terminal();
+  uint32_t zero[4] = {0, 0, 0, 0};
+
+  if (!ring) {
+    t->ring = NULL;
+    t->ring_flags = 0;
+    return 0;
+  }
+  if (((uint32_t)ring & 3) || (flags & ~RING_SETUP_POLL)) {
+    return -EINVAL;
+  }
+  if (!access_ok(ring, sizeof(ring_t))) {
+    return -EFAULT;
+  }
+  // the indices, sq_head .. cq_tail
+  if (copy_to_user(ring, zero, sizeof(zero))) {
+    return -EFAULT;
+  }
+  t->ring = ring;
+  t->ring_flags = flags;
+  return 0;
+}
+
+/**
+ * @brief Whether an entry can run from the timer tick. Anything that might
+ * wait on the keyboard or another device is left for SYSCALL_ENTER_RING
+ */
+static int ring_op_pollable(task *t, ring_sqe_t *sqe) {
+  file_t *file;
+  switch (sqe->opcode) {
+    case RING_OP_READ:
+    case RING_OP_WRITE:
+      file = vfs_fd_get(t, sqe->fd);
+      return !file || file->inode->type == DT_REG;
+    default:
+      return 1;
+  }
+}
+
+static int32_t ring_do_op(ring_sqe_t *sqe) {
+  switch (sqe->opcode) {
+    case RING_OP_NOP:
+      return 0;
+    case RING_OP_READ:
+      return sys_read(sqe->fd, (void *)sqe->addr, sqe->len);
+    case RING_OP_WRITE:
+      return sys_write(sqe->fd, (const void *)sqe->addr, sqe->len);
+    case RING_OP_OPEN:
+      return sys_open((const uint8_t *)sqe->addr);
+    case RING_OP_CLOSE:
+      return sys_close(sqe->fd);
+    default:
+      return -EINVAL;
+  }
+}
+
+/**
+ * @brief Runs up to max entries of t's ring, which must be mapped (t is the
+ * current task)
+ * @return int32_t entries run, or -errno
+ */
+static int32_t ring_run(task *t, uint32_t max, int polled) {
+  ring_t *ring = t->ring;
+  uint32_t idx[4]; // sq_head, sq_tail, cq_head, cq_tail
+  uint32_t done = 0;
+  ring_sqe_t sqe;
+  ring_cqe_t cqe;
+
+  if (copy_from_user(idx, ring, sizeof(idx))) {
+    return -EFAULT;
+  }
+  if (idx[1] - idx[0] > RING_ENTRIES || idx[3] - idx[2] > RING_ENTRIES) {
+    return -EINVAL;
+  }
+
+  while (done < max && idx[0] != idx[1] && idx[3] - idx[2] < RING_ENTRIES) {
+    if (copy_from_user(&sqe, &ring->sq[idx[0] & RING_MASK], sizeof(sqe))) {
+      return -EFAULT;
+    }
+    if (polled && !ring_op_pollable(t, &sqe)) {
+      break;
+    }
+    cqe.user_data = sqe.user_data;
+    cqe.res = ring_do_op(&sqe);
+    // the completion has to be there before the program can see cq_tail move
+    if (copy_to_user(&ring->cq[idx[3] & RING_MASK], &cqe, sizeof(cqe))) {
+      return -EFAULT;
+    }
+    idx[0]++;
+    idx[3]++;
+    done++;
+    if (copy_to_user((void *)&ring->sq_head, &idx[0], sizeof(uint32_t)) ||
+        copy_to_user((void *)&ring->cq_tail, &idx[3], sizeof(uint32_t))) {
+      return -EFAULT;
+    }
+  }
+  return done;
+}
+
+int32_t sys_enter_ring(uint32_t to_submit) {
+  task *t = get_task_in_running_terminal();
+  if (!t->ring) {
+    return -ENXIO;
+  }
+  return ring_run(t, to_submit, 0);
+}
+
+/*
+The tick doesn't run anything itself, it's an interrupt handler and the
+entries are system calls. It only marks a program it caught in user mode,
+and the entries run on the program's next way out of the kernel (the end of
+this tick, or the next interrupt or system call if the scheduler switched
+away), the same place signals get delivered.
+*/
+void ring_poll_tick() {
+  task *t = tasks + get_task()->pid;
+
+  if (t->ring && (t->ring_flags & RING_SETUP_POLL) && (t->regs.cs & 3) == 3) {
+    t->work |= TASK_WORK_RING;
+  }
+}
+
+void ring_exit_work(task *t) {
+  t->work &= ~TASK_WORK_RING;
+  if (!t->ring) {
+    return;
+  }
+  // a file read may have to wait for the disk
+  sti();
+  ring_run(t, RING_POLL_BUDGET, 1);
+  cli();
+}
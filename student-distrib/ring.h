@@ -0,0 +1,98 @@
+/**
+ * @file ring.h
+ * @brief Batched system calls through a submission / completion ring in the
+ * program's own memory, like Linux's io_uring. The program fills in
+ * submission entries and bumps sq_tail, then one SYSCALL_ENTER_RING runs
+ * all of them and posts a completion (user_data + result) for each. With
+ * RING_SETUP_POLL a timer tick that interrupts the program marks it, and a
+ * few entries run on its next way back to user mode, so a program that can
+ * wait doesn't have to enter the kernel at all.
+ *
+ * The ring is registered with SYSCALL_RING_SETUP and lives in the task's
+ * program page, which the scheduler maps in whenever the task runs, so the
+ * kernel reaches it through the normal user access functions.
+ */
+#ifndef RING_H
+#define RING_H
+
+#include "types.h"
+#include "task.h"
+
+#define RING_ENTRIES		32		///< size of both queues, a power of two
+#define RING_MASK			(RING_ENTRIES - 1)
+#define RING_POLL_BUDGET	8		///< most entries one return to user mode runs
+
+// ring_setup flags
+#define RING_SETUP_POLL		0x1		///< drain the ring after timer ticks too
+
+// opcodes, the arguments are the same as the matching system call's
+#define RING_OP_NOP			0
+#define RING_OP_READ		1		///< fd, addr = buffer, len
+#define RING_OP_WRITE		2		///< fd, addr = buffer, len
+#define RING_OP_OPEN		3		///< addr = path
+#define RING_OP_CLOSE		4		///< fd
+
+/**
+ *	One queued operation
+ */
+typedef struct ring_sqe {
+	uint8_t opcode;			///< RING_OP_*
+	uint8_t pad[3];
+	int32_t fd;
+	uint32_t addr;			///< user buffer or path
+	uint32_t len;
+	uint32_t user_data;		///< copied into the completion as is
+} ring_sqe_t;
+
+/**
+ *	One finished operation
+ */
+typedef struct ring_cqe {
+	uint32_t user_data;		///< from the submission
+	int32_t res;			///< what the system call returned
+} ring_cqe_t;
+
+/**
+ *	The shared ring. Indices only ever count up and are masked on use, the
+ *	program owns sq_tail and cq_head, the kernel sq_head and cq_tail
+ */
+typedef struct ring {
+	volatile uint32_t sq_head;	///< next submission the kernel runs
+	volatile uint32_t sq_tail;	///< one past the last submission queued
+	volatile uint32_t cq_head;	///< next completion the program reads
+	volatile uint32_t cq_tail;	///< one past the last completion posted
+	ring_sqe_t sq[RING_ENTRIES];
+	ring_cqe_t cq[RING_ENTRIES];
+} ring_t;
+
+/**
+ * @brief Registers ring (in the caller's memory) for this task and resets
+ * its indices. A NULL ring unregisters
+ * @param flags RING_SETUP_*
+ * @return int32_t 0, -EINVAL for a misaligned ring or unknown flags, -EFAULT
+ */
+int32_t sys_ring_setup(ring_t *ring, uint32_t flags);
+
+/**
+ * @brief Runs up to to_submit queued entries. Stops early when the queue
+ * is empty or the completion queue is full
+ * @return int32_t number of entries run, -ENXIO without a ring, -EFAULT,
+ * -EINVAL if the indices make no sense
+ */
+int32_t sys_enter_ring(uint32_t to_submit);
+
+/**
+ * @brief Called from the timer tick. If it interrupted a program with a
+ * polled ring, sets TASK_WORK_RING so the ring is drained on the program's
+ * way out of the kernel
+ */
+void ring_poll_tick();
+
+/**
+ * @brief TASK_WORK_RING, called by exit_to_user with interrupts off. Runs up
+ * to RING_POLL_BUDGET entries of t's ring with interrupts on, like a system
+ * call would, and returns with them off again
+ */
+void ring_exit_work(task *t);
+
+#endif
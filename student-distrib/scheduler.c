@@ -6,6 +6,9 @@
 #include "signal.h"
 #include "x86_desc.h"
 #include "system_calls.h"
+#include "ring.h"
+#include "drivers/ata.h"
+#include "mm/zeropage.h"
 
 int scheduling_on_flag = 0;
 static int scheduler_idx = 0; // static, meaning seen only in this file
@@ -39,7 +42,14 @@ void init_PIT() {
 }
 
 void pit_interrupt_handler() {
+  ata_timer_tick();
   if (scheduling_on_flag) {
+    // the kernel task only spins in user mode, its ticks go to the zeroed
+    // page pools
+    if (get_task()->pid == TASK_INIT_PID) {
+      zeropage_idle();
+    }
+    ring_poll_tick();
     next_scheduled_task();
   }
   send_eoi(TIMER_IRQ_NUM);
@@ -57,25 +67,13 @@ void scheduler_change_task(task* from, task* to) {
   map_process_mem(next_task_pid);
   
   task *to_pcb = &tasks[to->pid];
-  // check for pending signals on the process we are switching TO
-  if (to_pcb->pending_signals) {
-    // mask out the blocked signals
-    sigset_t signals_pending = to_pcb->pending_signals & (~to_pcb->signal_mask);
-    int i;
-
-    // check ALL pending signals and run corresponding handlers
-    for (i = 1; i < SIG_MAX; i++) {
-      if (sigismember(&signals_pending, i)) {
-        // mark this signal as ran
-        sigdelset(&to_pcb->pending_signals, i);
-
-        // now run the handler. this will run either default handler or custom handler
-        signal_exec(to_pcb, i);
-
-        // now the scheduler will tick below, and start execution at newly modified registers from signal_exec, which will run the handler
-        // or run a syscall to exit or something like that
-      }
-    }
+  // signals sent to a task while it wasn't running. The ones sent to the
+  // running task were delivered on its way out of the kernel already
+  if ((to_pcb->work & TASK_WORK_SIGNAL) && (to_pcb->regs.cs & 3) == 3) {
+    // the scheduler will iret below and start execution at the registers
+    // signal_deliver modified, which will run the handler or run a syscall
+    // to exit or something like that
+    signal_deliver(to_pcb, -1);
   }
   
   // change tss to reflect values of new task
@@ -102,7 +100,7 @@ void next_scheduled_task() {
         break;
       case TASK_ST_SLEEP:
         // if it has a signal pending and it isn't masked out then we will run it
-        if (tasks[scheduler_idx].pending_signals && (~tasks[scheduler_idx].signal_mask)) {
+        if (tasks[scheduler_idx].work & TASK_WORK_SIGNAL) {
           break;
         }
       default:
@@ -155,7 +153,7 @@ void next_scheduled_task_old() {
     // send eoi so that we can receive another scheduling interrupt
     // to switch to another process
     send_eoi(TIMER_IRQ_NUM);
-    execute((uint8_t*) "shell");
+    do_execute((uint8_t*) "shell");
   }
   
   // so above we start a shell if we dont already have one. Then we 
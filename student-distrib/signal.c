@@ -7,6 +7,9 @@
 #include "scheduler.h"
 #include "ece391sysnum.h"
 #include "libc/sys/wait.h"
+#include "mm/uaccess.h"
+#include "ring.h"
+#include "system_calls.h"
 
 int ece391_signal_support[] = {
   SIGFPE,
@@ -53,38 +56,55 @@ char *signal_names[] = {
 	"" // dummy
 };
 
-int32_t sys_sigprocmask(int how, int setp, int oldsetp) {
+int32_t do_sigprocmask(int how, const sigset_t *set, sigset_t *oldset) {
+  // the task list copy, which is the one signals are sent to and checked on
+  task *t = tasks + get_task()->pid;
 
   // save old value if not null
-  if (oldsetp) {
-    *(sigset_t *)oldsetp = get_task()->signal_mask;
+  if (oldset) {
+    *oldset = t->signal_mask;
   }
-  if (setp) {
+  if (set) {
     switch (how) {
       case SIG_BLOCK:
-        get_task()->signal_mask |= *(sigset_t *) setp;
+        t->signal_mask |= *set;
         break;
       case SIG_UNBLOCK:
-        get_task()->signal_mask &= ~(*(sigset_t *) setp);
+        t->signal_mask &= ~(*set);
         break;
       case SIG_SETMASK:
-        get_task()->signal_mask = *(sigset_t *) setp;
+        t->signal_mask = *set;
         break;
       default:
         return -EINVAL;
     }
 
     // always let SIGKILL and SIGSTOP thru though, can't block those signals.
-    sigdelset(&get_task()->signal_mask, SIGKILL);
-    sigdelset(&get_task()->signal_mask, SIGSTOP);
+    sigdelset(&t->signal_mask, SIGKILL);
+    sigdelset(&t->signal_mask, SIGSTOP);
+    // unblocking a pending signal gets it delivered on the way out
+    signal_recalc(t);
   }
+  return 0;
+}
+
+int32_t sys_sigprocmask(int how, int setp, int oldsetp) {
+  sigset_t set, oldset;
+  int32_t ret;
 
+  if (setp && copy_from_user(&set, (void *)setp, sizeof(sigset_t))) {
+    return -EFAULT;
+  }
+  ret = do_sigprocmask(how, setp ? &set : NULL, &oldset);
+  if (ret == 0 && oldsetp && copy_to_user((void *)oldsetp, &oldset, sizeof(sigset_t))) {
+    return -EFAULT;
+  }
+  return ret;
 }
 
-int32_t sys_sigsuspend(const sigset_t *mask) {
+int32_t do_sigsuspend(const sigset_t *mask) {
   if (mask) {
-    // set mask using sigprocmask syscall (probably bad practice)
-    sys_sigprocmask(SIG_SETMASK, mask, 0);
+    do_sigprocmask(SIG_SETMASK, mask, NULL);
   }
   // set the status of the task to sleep
   get_task()->status = TASK_ST_SLEEP;
@@ -93,31 +113,48 @@ int32_t sys_sigsuspend(const sigset_t *mask) {
   return 0;
 }
 
-int32_t sys_sigaction(int signum, int sigaction_ptr, int oldsigaction_ptr) {
+int32_t sys_sigsuspend(const sigset_t *mask) {
+  sigset_t kmask;
+  if (mask && copy_from_user(&kmask, mask, sizeof(sigset_t))) {
+    return -EFAULT;
+  }
+  return do_sigsuspend(mask ? &kmask : NULL);
+}
+
+int32_t do_sigaction(int signum, const sigaction_t *act, sigaction_t *oldact) {
   if (signum > SIG_MAX || signum < 0) {
     return -EINVAL;
   }
   // get current running task pid, offset it into task list (recall that all our tasks are in a tasks array, not kernel pcb memory)
   task* t = tasks + get_task()->pid;
 
-  // intermediate sigaction ptr to help with moving stuff around
-  sigaction_t* intermediate;
-
   // first save old sigaction
-  if (oldsigaction_ptr) {
-    intermediate = (sigaction_t*) oldsigaction_ptr;
-    memcpy(intermediate, &t->sigacts[signum], sizeof(struct sigaction));
+  if (oldact) {
+    memcpy(oldact, &t->sigacts[signum], sizeof(struct sigaction));
   }
 
   // write new sigaction to task
-  if (sigaction_ptr) {
-    intermediate =(sigaction_t*) &t->sigacts[signum];
-    memcpy(intermediate, (sigaction_t*) sigaction_ptr, sizeof(struct sigaction));
+  if (act) {
+    memcpy(&t->sigacts[signum], act, sizeof(struct sigaction));
   }
 
   return 0;
 }
 
+int32_t sys_sigaction(int signum, int sigaction_ptr, int oldsigaction_ptr) {
+  sigaction_t act, oldact;
+  int32_t ret;
+
+  if (sigaction_ptr && copy_from_user(&act, (void *)sigaction_ptr, sizeof(sigaction_t))) {
+    return -EFAULT;
+  }
+  ret = do_sigaction(signum, sigaction_ptr ? &act : NULL, &oldact);
+  if (ret == 0 && oldsigaction_ptr && copy_to_user((void *)oldsigaction_ptr, &oldact, sizeof(sigaction_t))) {
+    return -EFAULT;
+  }
+  return ret;
+}
+
 void signals_init() {
   uint32_t addr = 0;
   alloc_4kb_mem(&addr);
@@ -129,13 +166,152 @@ void signals_init() {
   memcpy(SIGNAL_BASE_ADDR, &(signal_user_base), size_of_signal_asm);
 }
 
+/**
+ * @brief Marks sig pending on t and queues its info. A signal sent with
+ * kill that's already pending stays pending once, like it always has. Ones
+ * sent with sigqueue all queue up, each is delivered with its own value
+ */
+static int32_t signal_send(task *t, int sig, int32_t code, int32_t value) {
+  siginfo_t *info;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  if (code == SI_USER && sigismember(&t->pending_signals, sig)) {
+    restore_flags(flags);
+    return 0;
+  }
+  if (t->sigqueue_len == SIGQUEUE_MAX) {
+    if (code == SI_QUEUE) {
+      restore_flags(flags);
+      return -EAGAIN;
+    }
+    // no room for the info, the signal still goes through without it
+  }
+  else {
+    info = &t->sigqueue[t->sigqueue_len++];
+    info->si_signo = sig;
+    info->si_code = code;
+    info->si_pid = get_task()->pid;
+    info->si_value = value;
+  }
+  sigaddset(&t->pending_signals, sig);
+  signal_recalc(t);
+  wake_up(&t->signal_wait);
+  restore_flags(flags);
+  return 0;
+}
+
+void signal_dequeue(task *proc, int sig, siginfo_t *info) {
+  uint32_t i, found = proc->sigqueue_len;
+  int more = 0;
+  uint32_t flags;
+
+  cli_and_save(flags);
+  for (i = 0; i < proc->sigqueue_len; i++) {
+    if (proc->sigqueue[i].si_signo != sig) {
+      continue;
+    }
+    if (found < proc->sigqueue_len) {
+      more = 1;
+      break;
+    }
+    found = i;
+  }
+  if (found < proc->sigqueue_len) {
+    *info = proc->sigqueue[found];
+    memmove(&proc->sigqueue[found], &proc->sigqueue[found + 1],
+            (proc->sigqueue_len - found - 1) * sizeof(siginfo_t));
+    proc->sigqueue_len--;
+  }
+  else {
+    info->si_signo = sig;
+    info->si_code = SI_KERNEL;
+    info->si_pid = 0;
+    info->si_value = 0;
+  }
+  if (!more) {
+    sigdelset(&proc->pending_signals, sig);
+  }
+  signal_recalc(proc);
+  restore_flags(flags);
+}
+
+void signal_recalc(task *proc) {
+  if (proc->pending_signals & ~proc->signal_mask) {
+    proc->work |= TASK_WORK_SIGNAL;
+  }
+  else {
+    proc->work &= ~TASK_WORK_SIGNAL;
+  }
+}
+
+void signal_deliver(task *proc, int32_t syscall_nr) {
+  // pending signals that aren't blocked. ffs picks the lowest one without
+  // looking at all 32
+  sigset_t signals_pending = proc->pending_signals & (~proc->signal_mask);
+
+  // only a call a signal actually interrupted is restarted, one that
+  // finished keeps its result
+  int32_t restart_nr = -1;
+  if (syscall_nr >= 0 && (int32_t)proc->regs.eax == -EINTR) {
+    restart_nr = syscall_nr;
+  }
+
+  // sigreturn puts eax back from the esp slot of the saved registers (popal
+  // skips it), so that's where the interrupted eax has to be
+  proc->regs.esp_k = proc->regs.eax;
+  while (signals_pending) {
+    int sig = ffs(signals_pending) - 1;
+    siginfo_t info;
+    signals_pending &= signals_pending - 1;
+
+    // takes the oldest one sent. A signal queued more than once stays
+    // pending and its next instance goes the next time round
+    signal_dequeue(proc, sig, &info);
+
+    // now run the handler. this will run either default handler or custom handler.
+    // Only the first frame goes back to the system call, the ones pushed
+    // after it return into the handler before them
+    if (signal_exec(proc, sig, &info, restart_nr)) {
+      restart_nr = -1;
+    }
+  }
+  // a handler's mask may have blocked what's left
+  signal_recalc(proc);
+}
+
+void exit_to_user(regs_t *frame, int32_t syscall_nr) {
+  task *t;
+  // back into the kernel (an IRQ that came in during a system call), the
+  // system call's own return takes care of it
+  if ((frame->cs & 3) != 3) {
+    return;
+  }
+  t = tasks + get_task()->pid;
+  // before signals, the entries may send one
+  if (t->work & TASK_WORK_RING) {
+    ring_exit_work(t);
+  }
+  if (!(t->work & TASK_WORK_SIGNAL)) {
+    return;
+  }
+  memcpy(&t->regs, frame, sizeof(regs_t));
+  signal_deliver(t, syscall_nr);
+  memcpy(frame, &t->regs, sizeof(regs_t));
+}
+
 int32_t sys_kill(pid_t pid, int sig) {
-  if (pid <= 0 || sig <= 0 || sig >= SIG_MAX) {
+  if (pid <= 0 || pid >= MAX_TASKS || sig <= 0 || sig >= SIG_MAX) {
     return -EINVAL;
   }
-  // Send the signal to the process
-  // which is same as just adding the signal to the process' "signals" mask (pending signals)
-  sigaddset(&tasks[pid].pending_signals, sig);
+  return signal_send(&tasks[pid], sig, SI_USER, 0);
+}
+
+int32_t sys_sigqueue(pid_t pid, int sig, int32_t value) {
+  if (pid <= 0 || pid >= MAX_TASKS || sig <= 0 || sig >= SIG_MAX) {
+    return -EINVAL;
+  }
+  return signal_send(&tasks[pid], sig, SI_QUEUE, value);
 }
 
 /**
@@ -144,7 +320,7 @@ int32_t sys_kill(pid_t pid, int sig) {
  * @param proc 
  * @param sig 
  */
-void setup_frame(task* proc, int sig) {
+void setup_frame(task* proc, int sig, const siginfo_t *info, int32_t restart_nr) {
 
   // check for SA_RESTART flag. Basic jist is that if this flag is toggled on the signal action struct, 
   // the system call will be restarted if interrupted by signal handler 
@@ -153,14 +329,28 @@ void setup_frame(task* proc, int sig) {
   // To restart the system call, we will push stack frame for signal_user_ret
   sigaction_t *sa;
   sa = proc->sigacts + sig;
-  if (sa->flags & SA_RESTART) {
-    // Restart INT 0x80
-		// TODO validity check
-		if (*(uint8_t *)(proc->regs.eip - 2) == 0xcd) { // OPCode for INT: CD
-			push_onto_task_stack(&(proc->regs.esp), proc->regs.eip - 2);
-		} else {
-			push_onto_task_stack(&(proc->regs.esp), proc->regs.eip);
-		}
+  if (restart_nr >= 0 && (sa->flags & SA_RESTART)) {
+    // Restart INT 0x80 or SYSENTER. The arguments are all still in their
+    // registers, the number went to the -EINTR the call returned, sigreturn
+    // puts it back in eax from esp_k
+    uint32_t eip = proc->regs.eip;
+    uint8_t opcode = 0;
+    if (sysenter_return && eip == sysenter_return) {
+      // the vsyscall stub's sysenter (0F 34) is right before. ebp still
+      // points at the ecx / edx it saved, sysenter_entry takes it as the
+      // user esp again
+      eip -= 2;
+    }
+    else {
+      copy_from_user(&opcode, (uint8_t *)eip - 2, 1);
+      if (opcode == 0xcd) { // OPCode for INT: CD
+        eip -= 2;
+      }
+    }
+    if (eip != proc->regs.eip) {
+      proc->regs.esp_k = restart_nr;
+    }
+    push_onto_task_stack(&(proc->regs.esp), eip);
   }
   else {
     // eip
@@ -174,17 +364,29 @@ void setup_frame(task* proc, int sig) {
   push_onto_task_stack(&proc->regs.esp, proc->signal_mask);
   proc->signal_mask = proc->sigacts[sig].mask & (~(SIGKILL | SIGSTOP)); // must always be able to kill and stop
 
-  // push signal num
-  push_onto_task_stack(&(proc->regs.esp), sig);
+  if (sa->flags & SA_SIGINFO) {
+    // the info goes on the user stack too, the handler gets a pointer to it.
+    // sigreturn_info skips it and the two extra arguments
+    push_buf_onto_task_stack(&proc->regs.esp, (uint8_t *)info, sizeof(siginfo_t));
+    uint32_t info_addr = proc->regs.esp;
+    push_onto_task_stack(&proc->regs.esp, 0);
+    push_onto_task_stack(&proc->regs.esp, info_addr);
+    push_onto_task_stack(&proc->regs.esp, sig);
+    push_onto_task_stack(&proc->regs.esp, (uint32_t) sigreturn_info_user_addr);
+  }
+  else {
+    // push signal num
+    push_onto_task_stack(&(proc->regs.esp), sig);
 
-  // push return address (which runs sigreturn)
-  uint32_t esp = push_onto_task_stack(&proc->regs.esp, (uint32_t) sigreturn_user_addr);
+    // push return address (which runs sigreturn)
+    push_onto_task_stack(&proc->regs.esp, (uint32_t) sigreturn_user_addr);
+  }
   
   // finally we must run the handler 
   proc->regs.eip = (uint32_t) proc->sigacts[sig].handler;
 }
 
-void signal_exec(task* proc, int sig) {
+int32_t signal_exec(task* proc, int sig, const siginfo_t *info, int32_t restart_nr) {
   struct sigaction a = proc->sigacts[sig];
 
   // IF DEFAULT HANDLER, EXECUTE DEFAULT HANDLER
@@ -192,14 +394,15 @@ void signal_exec(task* proc, int sig) {
     // check if handler is any of the preset 3
     case ((int)SIGHANDLER_DEFAULT):
       signal_exec_default(proc, sig);
-      return;
+      return 0;
     case ((int)SIGHANDLER_IGNORE):
       signal_handler_ignore(proc, sig);
-      return;
+      return 0;
   }
 
   // NOT default handler... custom handler instead. this is more complicated
-  setup_frame(proc, sig);
+  setup_frame(proc, sig, info, restart_nr);
+  return 1;
 
 }
 
@@ -250,6 +453,10 @@ void signal_handler_terminate(task *proc, int sig) {
 void signal_handler_stop(task *proc, int sig) {
   proc->status = TASK_ST_SLEEP;
   proc->exit_status = sig | WIFSTOPPED(-1);
+  // a WUNTRACED waitpid in the parent reports the stop
+  if (proc->parent_pid < MAX_TASKS) {
+    wake_up(&tasks[proc->parent_pid].child_wait);
+  }
 }
 
 
@@ -273,7 +480,7 @@ int32_t ece391_sys_set_handler(int32_t signum, void *handler_address)
   sigaddset(&s_act.mask, signum);
   s_act.flags = SA_ECE391SIGNO;
 
-  return sys_sigaction(signum, (int) &s_act, 0);
+  return do_sigaction(signum, &s_act, NULL);
 }
 
 int32_t ece391_sys_sigreturn(void)
@@ -15,7 +15,7 @@
  * @param handler_address 
  * @return int32_t 
  */
-int32_t sys_set_handler(int32_t signum, void *handler_address);
+int32_t ece391_sys_set_handler(int32_t signum, void *handler_address);
 
 
 /**
@@ -23,7 +23,7 @@ int32_t sys_set_handler(int32_t signum, void *handler_address);
  * 
  * @return int32_t 
  */
-int32_t sys_sigreturn();
+int32_t ece391_sys_sigreturn(void);
 
 /**
  * @brief The sigaction system call is #13 and basically swaps the sigaction
@@ -59,6 +59,15 @@ int32_t sys_sigprocmask(int how, int setp, int oldsetp);
  */ 
 int32_t sys_sigsuspend(const sigset_t *mask);
 
+/**
+ * @brief sigaction / sigprocmask / sigsuspend for callers inside the kernel,
+ * whose pointers are kernel pointers. The sys_ versions copy their arguments
+ * in from user memory and call these
+ */
+int32_t do_sigaction(int signum, const sigaction_t *act, sigaction_t *oldact);
+int32_t do_sigprocmask(int how, const sigset_t *set, sigset_t *oldset);
+int32_t do_sigsuspend(const sigset_t *mask);
+
 /**
  * @brief Sends ANY signal to any process or group of proesses
  * 
@@ -68,6 +77,43 @@ int32_t sys_sigsuspend(const sigset_t *mask);
  */
 int32_t sys_kill(pid_t pid, int sig);
 
+/**
+ * @brief Sends sig to process pid along with value. Unlike kill, every send
+ * is queued and delivered on its own, in the order they were sent
+ * https://man7.org/linux/man-pages/man3/sigqueue.3.html
+ * @return int32_t 0, -EINVAL, -EAGAIN if too many signals are queued already
+ */
+int32_t sys_sigqueue(pid_t pid, int sig, int32_t value);
+
+/**
+ * @brief Sets or clears TASK_WORK_SIGNAL on proc, after its pending signals
+ * or its mask changed
+ */
+void signal_recalc(task *proc);
+
+/**
+ * @brief Runs (or sets up the handler frames of) every pending signal proc
+ * doesn't block, on proc->regs. proc must be the one whose memory is mapped
+ * @param syscall_nr the system call proc->regs is returning from, -1 if it
+ * isn't returning from one. If that call was cut short with -EINTR and the
+ * first handler has SA_RESTART, the call runs again after the handler
+ */
+void signal_deliver(task *proc, int32_t syscall_nr);
+
+/**
+ * @brief Called on the way back out of every system call and IRQ with the
+ * registers about to be restored. If they go back to user mode and the task
+ * has work pending, delivers its signals by rewriting them
+ * @param syscall_nr the system call being returned from, -1 for an IRQ
+ */
+void exit_to_user(regs_t *frame, int32_t syscall_nr);
+
+/**
+ * @brief Takes the oldest queued instance of the pending signal sig off proc,
+ * into info. sig stays pending as long as more instances are queued
+ */
+void signal_dequeue(task *proc, int sig, siginfo_t *info);
+
 // forward declare this
 struct task;
 
@@ -76,8 +122,11 @@ struct task;
  *	Checks for whether or not the handler is a default handler
  *	@param proc: the process
  *	@param sig: the signal number
+ *	@param info: from signal_dequeue, for SA_SIGINFO handlers
+ *	@param restart_nr: system call to restart after an SA_RESTART handler, -1 for none
+ *	@return 1 if it set up a frame for a custom handler, 0 otherwise
  */
-void signal_exec(task* proc, int sig);
+int32_t signal_exec(task* proc, int sig, const siginfo_t *info, int32_t restart_nr);
 
 /**
  *	Invoke the default signal handler. This will run one of the helper methods depending
@@ -142,6 +191,8 @@ void signals_init();
 #define SA_RESETHAND	0x20
 /// Send signal number to handler in ECE391 format
 #define SA_ECE391SIGNO	0x40
+/// Call the handler as handler(sig, siginfo_t *info, NULL)
+#define SA_SIGINFO		0x80
 
 /// Add signal to set
 #define sigaddset(set, signo) (*(set) |= (1<<(signo)))
@@ -24,5 +24,22 @@ extern uint32_t offset_of_signal_systemcall_user;
 extern uint32_t offset_of_signal_user_ret;
 #define sigreturn_user_addr ((void*)SIGNAL_BASE_ADDR + offset_of_signal_user_ret)
 
+// return address of SA_SIGINFO handlers, whose frame also has the siginfo_t
+extern uint32_t offset_of_signal_user_ret_info;
+#define sigreturn_info_user_addr ((void*)SIGNAL_BASE_ADDR + offset_of_signal_user_ret_info)
+
+// vsyscall: user programs call through the pointer at VSYSCALL_ENTRY_ADDR,
+// which is set to one of the two stubs at boot (see sysenter_init)
+#define VSYSCALL_ENTRY_ADDR	(SIGNAL_BASE_ADDR + 4)
+
+extern uint32_t offset_of_vsyscall_int80;
+#define vsyscall_int80_addr ((void*)SIGNAL_BASE_ADDR + offset_of_vsyscall_int80)
+
+extern uint32_t offset_of_vsyscall_sysenter;
+#define vsyscall_sysenter_addr ((void*)SIGNAL_BASE_ADDR + offset_of_vsyscall_sysenter)
+
+extern uint32_t offset_of_sysenter_return;
+#define sysenter_return_addr ((void*)SIGNAL_BASE_ADDR + offset_of_sysenter_return)
+
 #endif
 
@@ -0,0 +1,65 @@
+/**
+ * @file syscall_table.h
+ * @brief Every system call, once. This list is expanded into the kernel's
+ * dispatch table and call names (system_calls.c), the kernel's own call
+ * stubs (system_call_public.S) and the user library wrappers
+ * (syscalls/ece391syscall.S), so none of them can disagree about a number.
+ *
+ * Each entry is X(number, name, handler, nargs). nargs is the number of
+ * arguments, calls with 4 take the last one in esi. Numbers are in
+ * ece391sysnum.h, two entries with the same number fail to compile.
+ */
+#ifndef SYSCALL_TABLE_H
+#define SYSCALL_TABLE_H
+
+#include "ece391sysnum.h"
+
+#define SYSCALL_TABLE(X) \
+	/* ECE391 */ \
+	X(SYS_HALT,             halt,           sys_halt,               1) \
+	X(SYS_EXECUTE,          execute,        sys_execute,            1) \
+	X(SYS_READ,             read,           sys_read,               3) \
+	X(SYS_WRITE,            write,          sys_write,              3) \
+	X(SYS_OPEN,             open,           sys_open,               1) \
+	X(SYS_CLOSE,            close,          sys_close,              1) \
+	X(SYS_GETARGS,          getargs,        sys_getargs,            2) \
+	X(SYS_VIDMAP,           vidmap,         sys_vidmap,             1) \
+	X(SYS_SET_HANDLER,      set_handler,    ece391_sys_set_handler, 2) \
+	X(SYS_SIGRETURN,        sigreturn,      ece391_sys_sigreturn,   0) \
+	X(SYSCALL_MAKE_INITD,   make_initd,     task_make_initd,        0) \
+	/* Process */ \
+	X(SYSCALL_FORK,         fork,           sys_fork,               0) \
+	X(SYSCALL_EXIT,         exit,           sys_exit,               1) \
+	X(SYSCALL_EXECVE,       execve,         sys_execve,             3) \
+	X(SYSCALL_WAITPID,      waitpid,        sys_waitpid,            3) \
+	X(SYSCALL_GETPID,       getpid,         sys_getpid,             0) \
+	/* Signals */ \
+	X(SYSCALL_KILL,         kill,           sys_kill,               2) \
+	X(SYSCALL_SIGACTION,    sigaction,      sys_sigaction,          3) \
+	X(SYSCALL_SIGSUSPEND,   sigsuspend,     sys_sigsuspend,         1) \
+	X(SYSCALL_SIGPROCMASK,  sigprocmask,    sys_sigprocmask,        3) \
+	X(SYSCALL_SIGQUEUE,     sigqueue,       sys_sigqueue,           3) \
+	X(SYSCALL_SIGNALFD,     signalfd,       sys_signalfd,           2) \
+	/* Filesystem */ \
+	X(SYSCALL_CHDIR,        chdir,          sys_chdir,              1) \
+	X(SYSCALL_GETCWD,       getcwd,         sys_getcwd,             2) \
+	X(SYSCALL_MKDIR,        mkdir,          sys_mkdir,              2) \
+	X(SYSCALL_GETDENTS,     getdents,       sys_getdents,           3) \
+	X(SYSCALL_MOUNT,        mount,          sys_mount,              3) \
+	X(SYSCALL_UMOUNT,       umount,         sys_umount,             1) \
+	X(SYSCALL_IOCTL,        ioctl,          sys_ioctl,              3) \
+	X(SYSCALL_DUP,          dup,            sys_dup,                1) \
+	X(SYSCALL_DUP2,         dup2,           sys_dup2,               2) \
+	X(SYSCALL_PIPE,         pipe,           sys_pipe,               1) \
+	X(SYSCALL_READV,        readv,          sys_readv,              3) \
+	X(SYSCALL_WRITEV,       writev,         sys_writev,             3) \
+	X(SYSCALL_PREAD,        pread,          sys_pread,              4) \
+	X(SYSCALL_PWRITE,       pwrite,         sys_pwrite,             4) \
+	X(SYSCALL_RING_SETUP,   ring_setup,     sys_ring_setup,         2) \
+	X(SYSCALL_ENTER_RING,   enter_ring,     sys_enter_ring,         1) \
+	/* Block devices */ \
+	X(SYSCALL_IOSTAT,       iostat,         sys_iostat,             2) \
+	/* Interrupts */ \
+	X(SYSCALL_IRQSTAT,      irqstat,        sys_irqstat,            2)
+
+#endif
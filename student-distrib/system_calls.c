@@ -1,74 +1,84 @@
 #include "system_calls.h"
 #include "lib.h"
 #include "filesystem.h"
-#include "RTC.h"
+#include "fs/vfs.h"
 #include "keyboard.h"
 #include "task.h"
 #include "paging.h"
 #include "x86_desc.h"
 #include "signal.h"
+#include "signal_user.h"
 #include "terminal.h"
 #include "errno.h"
+#include "mm/uaccess.h"
+#include "libc/sys/uio.h"
+#include "drivers/bcache.h"
+#include "ring.h"
+#include "syscall_table.h"
+#include "fs/procfs.h"
+#include "fs/pipe.h"
+#include "fs/signalfd.h"
+#include "elf.h"
+#include "irqstat.h"
 
-/**
- * @brief This function programatically populates the jump table for system calls in the system_call_public.S file
- * That way we have fine control over which system call maps to which syscall number. Otherwise we'd have to 
- * arrange it in order in the assembly file which could get confusing
- * @param syscall_no 
- * @param handler 
- * @return uint32_t 
- */
-uint32_t register_syscall(int syscall_no, syscall_handler handler) {
-  if (syscall_no > NUM_SYSCALLS || syscall_no <= 0) {
-    return -1;
+/*
+The dispatch table, generated from syscall_table.h and indexed by the call
+number itself. Numbers without an entry stay NULL and the entry code turns
+them into -1, like numbers past the end of the table.
+*/
+#define SYSCALL_HANDLER(nr, name, handler, nargs) [nr] = (syscall_handler)handler,
+syscall_handler syscall_table[NUM_SYSCALLS] = {
+  SYSCALL_TABLE(SYSCALL_HANDLER)
+};
+
+#define SYSCALL_NAME(nr, name, handler, nargs) [nr] = #name,
+static const char *syscall_names[NUM_SYSCALLS] = {
+  SYSCALL_TABLE(SYSCALL_NAME)
+};
+
+// never called, two entries with the same number make a duplicate case
+#define SYSCALL_CASE(nr, name, handler, nargs) case nr:
+static void __attribute__((unused)) syscall_table_check(int nr)
+{
+  switch (nr)
+  {
+    SYSCALL_TABLE(SYSCALL_CASE)
+    break;
   }
+}
 
-  jump_table[syscall_no] = handler;
-  return 0;
+// updated by the entry code around every call
+uint32_t syscall_count[NUM_SYSCALLS];
+uint64_t syscall_cycles[NUM_SYSCALLS];
+
+/*
+/proc/syscalls, one line per call that's been made: how often, the TSC
+cycles spent in it in total and per call. Calls that block (read on the
+terminal, waitpid) count the time other tasks ran meanwhile too, and calls
+that don't return (halt, execve) are counted but not timed.
+*/
+static void syscall_stats_show(proc_buf_t *pb)
+{
+  int32_t nr;
+  proc_putpad(pb, "name", 14);
+  proc_puts(pb, "     calls           cycles  cycles/call\n");
+  for (nr = 0; nr < NUM_SYSCALLS; nr++)
+  {
+    if (!syscall_names[nr] || !syscall_count[nr])
+    {
+      continue;
+    }
+    proc_putpad(pb, syscall_names[nr], 14);
+    proc_putnum(pb, syscall_count[nr], 10);
+    proc_putnum(pb, syscall_cycles[nr], 17);
+    proc_putnum(pb, div64_32(syscall_cycles[nr], syscall_count[nr]), 13);
+    proc_puts(pb, "\n");
+  }
 }
 
-/**
- * @brief This function will just populate the jump table by calling register_syscall a ton of times
- * 
- */
-void register_all_syscalls() {
-  	// ece391_halt
-	syscall_register(1, sys_halt);
-	// ece391_execute
-	syscall_register(2, sys_execute);
-	// ece391_read
-	syscall_register(3, sys_read);
-	// ece391_write
-	syscall_register(4, sys_write);
-	// ece391_open
-	syscall_register(5, sys_open);
-	// ece391_close
-	syscall_register(6, sys_close);
-	// ece391_getargs
-	syscall_register(7, sys_getargs);
-	// ece391_vidmap
-	syscall_register(8, sys_vidmap);
-	// ece391_set_handler
-	syscall_register(9, sys_set_handler);
-	// ece391_sigreturn
-	syscall_register(10, sys_sigreturn);
-
-  syscall_register(15, task_make_initd);
-
-  // Process
-	syscall_register(SYSCALL_FORK, sys_fork);
-	syscall_register(SYSCALL_EXIT, sys_exit);
-	syscall_register(SYSCALL_EXECVE, sys_execve);
-	syscall_register(SYSCALL_WAITPID, sys_waitpid);
-	syscall_register(SYSCALL_GETPID, sys_getpid);
-	syscall_register(SYSCALL_BRK, sys_brk);
-	syscall_register(SYSCALL_SBRK, sys_sbrk);
-
-	// Signals
-	syscall_register(SYSCALL_KILL, sys_kill);
-	syscall_register(SYSCALL_SIGACTION, sys_sigaction);
-	syscall_register(SYSCALL_SIGSUSPEND, sys_sigsuspend);
-	syscall_register(SYSCALL_SIGPROCMASK, sys_sigprocmask);
+void syscall_stats_init()
+{
+  procfs_register("syscalls", syscall_stats_show);
 }
 
 /*
@@ -95,12 +105,10 @@ int32_t sys_halt(uint8_t status)
   int i;
   for (i = 0; i < MAX_OPEN_FILES; i++)
   {
-    // this will use the fd's jump table
-    // will also deal with setting all fd values
-    // like jump tables and such to 0
-    // so that illegal calls cannot be made without getting errors
-    // if file is not open to begin with then it won't do anything
-    close(i);
+    // drops the fd's reference to its open file, including stdin/stdout
+    // which close() refuses to touch. If the file is not open to begin with
+    // then it won't do anything
+    vfs_fd_close(current_running_task, i);
   }
   // no need to do anything else, all the other task fields get over-written
   // on a second call to execute()
@@ -116,7 +124,7 @@ int32_t sys_halt(uint8_t status)
   if (terminals[cur_terminal_running].num_processes_running == 0)
   {
     printf("restarting terminal\n");
-    execute((uint8_t*) "shell");
+    do_execute((uint8_t*) "shell");
   }
 
   printf("shutdown process %d, returning to process %d\n", current_task_pid, parent_task_pid);
@@ -158,8 +166,25 @@ for example, if the program does not exist or the filename specified is not an e
 exception, or a value in the range 0 to 255 if the program executes a halt system call, in which case the value returned
 is that given by the program’s call to halt.
 
+The command comes from user memory, so it's copied in first and the real work
+is done by do_execute, which the kernel also calls to start shells.
 */
 int32_t sys_execute(const uint8_t *command)
+{
+  int8_t kcommand[LINE_BUFFER_MAX_SIZE + 1];
+  int32_t len = strncpy_from_user(kcommand, (const int8_t *)command, LINE_BUFFER_MAX_SIZE + 1);
+  if (len < 0)
+  {
+    return len;
+  }
+  if (len > LINE_BUFFER_MAX_SIZE)
+  {
+    return -1;
+  }
+  return do_execute((uint8_t *)kcommand);
+}
+
+int32_t do_execute(const uint8_t *command)
 {
 
   // no interrupts when initializing a program
@@ -182,72 +207,49 @@ int32_t sys_execute(const uint8_t *command)
     return 0;
   }
 
-  // look for program's dentry_t struct
-  dentry_t program;
-  if (read_dentry_by_name((uint8_t *)program_name, &program) == -1)
+  // open the program. Bare program names that aren't in the working
+  // directory are looked up in the root, which is where all the programs live
+  file_t *program;
+  if (vfs_open(program_name, FD_READ_PERMS, &program) < 0)
   {
-    // program not found
-    return -1;
+    int8_t root_path[LINE_BUFFER_MAX_SIZE + 2] = "/";
+    int8_t *c;
+    for (c = program_name; *c; c++)
+    {
+      if (*c == '/')
+      {
+        return -1;
+      }
+    }
+    strcpy(root_path + 1, program_name);
+    if (vfs_open(root_path, FD_READ_PERMS, &program) < 0)
+    {
+      // program not found
+      return -1;
+    }
   }
 
-  // check that this is an executable
-  /*
-  In this file, a header that occupies the first 40 bytes gives information
-  for loading and starting
-  the program. The first 4 bytes of the file represent a “magic number”
-  that identifies the file as an executable. These
-  bytes are, respectively, 0: 0x7f; 1: 0x45; 2: 0x4c; 3: 0x46. If the
-  magic number is not present, the execute system
-  call should fail.
-  */
-  uint8_t first_fourty_bytes[40];
-  if (read_data(program.inode_number, 0, first_fourty_bytes, 40) == -1)
-  {
-    return -1;
-  }
-  if (first_fourty_bytes[0] != 0x7f || first_fourty_bytes[1] != 0x45 || first_fourty_bytes[2] != 0x4c || first_fourty_bytes[3] != 0x46)
+  // get the program ready to load. Its ELF header has the entry point, the
+  // virtual address of the first instruction to run, and says where the
+  // segments to load are. Programs that ran recently are already cached
+  elf_image_t *image;
+  if (elf_image_get(program, &image) < 0)
   {
+    vfs_file_put(program);
     return -1;
   }
+  uint32_t entry_point = image->entry;
 
-  /*
-  The other important bit of information that you need
-  to execute programs is the entry point into the
-  program, i.e., the virtual address of the first
-  instruction that should be executed. This information is stored as a 4-byte
-  unsigned integer in bytes 24-27 of the executable,
-  and the value of it falls somewhere near 0x08048000
-  for all programs we have provided to you. When processing
-  the execute system call, your code should make a note of the entry
-  point, and then copy the entire file to memory starting
-  at virtual address 0x08048000. It then must jump to the entry
-  point of the program to begin execution.
-  */
-  uint32_t entry_point = *((uint32_t *)(first_fourty_bytes + 24));
-  printf("program entry: 0x%x\n", entry_point);
   int32_t new_pid = get_new_process_id();
-  printf("running %s with process id %d\n", program_name, new_pid);
-  if (new_pid == -1)
+  if (new_pid < 0)
   {
     // too many processes
     printf("Too many processes, %d running already\n", MAX_TASKS);
+    vfs_file_put(program);
     return -1;
   }
 
 
-  // AT THIS POINT WE KNOW WE WILL RUN THE PROCESS, ALL CHECKS COMPLETE
-
-  task *t = init_task(new_pid);
-
-  // copy argument information and process ID into the current task.
-  strncpy((int8_t *)t->arguments, arguments, strlen(arguments));
-
-  // name the task, 32 bits because that's max size of task name (as it says in spec)
-  strncpy((int8_t *)t->name_of_task, program_name, MAX_FILE_NAME_LENGTH);
-
-  printf("program name: %s\n", program_name);
-  printf("program arguments: %s\n", arguments);
-
   /*
   The way to get this
   working is to set up a single 4 MB page directory entry that maps virtual address 0x08000000 (128 MB) to the right
@@ -256,16 +258,32 @@ int32_t sys_execute(const uint8_t *command)
   */
   map_process_mem(new_pid);
 
-  // copy the executable to the task's page in memory at offset 0x48000. Since we just mapped the memory, we can
-  // now virtual address 0x08048000 will be translated into 0x800000 + 0x48000
-  // AKA 8MB + 48*4KB physical, or a 0x48000 offset into the right page. Just as required.
-  // Also we set length to be a really big number, I know from printing out that largest
-  // exe is 5277 bytes, so 10k should work. Because read_data() will exit if done reading.
-  if (read_data(program.inode_number, 0, (uint8_t *)(PROGRAM_IMAGE_VIRTUAL_ADDRESS + 0x48000), 100000) == -1)
+  // load the program's segments into the page we just mapped, at the
+  // addresses they were linked for (0x08048000 and up). Nothing is claimed
+  // yet, the pid stays free until the task is marked running below
+  int32_t ret = elf_image_load(image, program);
+  vfs_file_put(program);
+  if (ret < 0)
   {
+    // the caller goes on running, give it its own program page back
+    task *parent = terminals[cur_terminal_running].current_task;
+    if (parent)
+    {
+      map_process_mem(parent->pid);
+    }
     return -1;
   }
 
+  // AT THIS POINT WE KNOW WE WILL RUN THE PROCESS, ALL CHECKS COMPLETE
+
+  task *t = init_task(new_pid);
+
+  // copy argument information and process ID into the current task.
+  strncpy((int8_t *)t->arguments, arguments, strlen(arguments));
+
+  // name the task, 32 bits because that's max size of task name (as it says in spec)
+  strncpy((int8_t *)t->name_of_task, program_name, MAX_FILE_NAME_LENGTH);
+
   // mark as running status?
   tasks[new_pid].status = TASK_ST_RUNNING;
 
@@ -349,30 +367,28 @@ should be inserted into the file array on the open system call (see below).
 */
 int32_t sys_read(int32_t fd, void *buf, int32_t nbytes)
 {
-  // task *PCB_data = get_task();
-
   // current running process
   task *PCB_data = get_task_in_running_terminal();
+  file_t *file = vfs_fd_get(PCB_data, fd);
 
-  if (fd < 0 || fd > 7 || buf == 0)
+  // is the fd even open, and can it be read from?
+  if (!file || nbytes < 0 || !(file->flags & FD_READ_PERMS))
   {
     return -1;
   }
-
-  // is the fd even open?
-  if ((PCB_data->fds[fd].flags & FD_IN_USE) == 0)
+  // the range check is all we do here, the file's read copies with
+  // __copy_to_user and stops if part of buf isn't mapped
+  if (!access_ok(buf, nbytes))
   {
-    // its not open, don't bother
-    return -1;
+    return -EFAULT;
   }
 
-  // pass along argumenst to the appropriate function in jump table (if exists)
-  if (PCB_data->fds[fd].jump_table.read == 0)
+  // pass along arguments to the file's read (if it has one)
+  if (!file->f_op || !file->f_op->read)
   {
     return -1;
   }
-  int32_t ret = (int32_t)(PCB_data->fds[fd].jump_table.read(fd, buf, nbytes));
-  return ret;
+  return file->f_op->read(file, buf, nbytes);
 }
 
 /*
@@ -389,126 +405,194 @@ written, or -1 on failure.
 int32_t sys_write(int32_t fd, const void *buf, int32_t nbytes)
 {
   task *PCB_data = get_task_in_running_terminal();
+  file_t *file = vfs_fd_get(PCB_data, fd);
 
-  if (fd < 0 || fd > 7 || buf == 0)
+  // is the fd even open, and can it be written to?
+  if (!file || nbytes < 0 || !(file->flags & FD_WRITE_PERMS))
   {
     return -1;
   }
-
-  // is the fd even open?
-  if ((PCB_data->fds[fd].flags & FD_IN_USE) == 0)
+  if (!access_ok(buf, nbytes))
   {
-    // its not open, don't bother
-    return -1;
+    return -EFAULT;
   }
 
-  // pass along argumenst to the appropriate function if it exists
-  if (PCB_data->fds[fd].jump_table.write == 0)
+  // pass along arguments to the file's write if it exists
+  if (!file->f_op || !file->f_op->write)
   {
     return -1;
   }
-  int32_t ret = PCB_data->fds[fd].jump_table.write(fd, buf, nbytes);
-  return ret;
+  return file->f_op->write(file, buf, nbytes);
 }
 
 /*
-The open system call provides access to the file system. T
-he call should find the directory entry corresponding to the
-named file, allocate an unused file descriptor, and set up any data
-necessary to handle the given type of file (directory,
-RTC device, or regular file). If the named file does not exist or
-no descriptors are free, the call returns -1.
+readv and writev are read and write over up to IOV_MAX buffers in one call.
+The fd and its operation are looked up once and the buffers are handed to it
+in order. A short transfer ends the call, and an error after some bytes have
+moved returns what was moved, like Linux.
 */
-int32_t sys_open(const uint8_t *filename)
+static int32_t do_iov(int32_t fd, const struct iovec *uiov, int32_t iovcnt, int32_t write)
 {
-  // we need to look thru our filesystem for such a file
-  dentry_t file;
-  uint32_t ret = read_dentry_by_name(filename, &file);
-  if (ret == -1)
+  struct iovec iov[IOV_MAX];
+  task *PCB_data = get_task_in_running_terminal();
+  file_t *file = vfs_fd_get(PCB_data, fd);
+  int32_t total = 0;
+  int32_t i, ret;
+
+  if (!file || !(file->flags & (write ? FD_WRITE_PERMS : FD_READ_PERMS)))
   {
-    // file not found
     return -1;
   }
-
-  // allocate an unused file descriptor in the task
-  int32_t open_fd = find_unused_fd();
-  if (open_fd == -1)
+  if (!file->f_op || !(write ? (void *)file->f_op->write : (void *)file->f_op->read))
   {
-    // no open file descriptors for current task. Abort
     return -1;
   }
-
-  // get current terminal's active task
-  task *cur_task = get_task_in_running_terminal();
-
-  // mark the fd for that task as in use
-  cur_task->fds[open_fd].flags |= FD_IN_USE;
-  // set the position back to 0 if you re-open a file
-  cur_task->fds[open_fd].file_position = 0;
-
-  if (file.file_type == 1)
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
   {
-    // directory
-
-    // create jump table
-    jump_table_fd dir_jump_table = {
-        read_dir,
-        write_dir,
-        open_dir,
-        close_dir};
-    cur_task->fds[open_fd].jump_table = dir_jump_table;
+    return -EINVAL;
+  }
+  if (copy_from_user(iov, uiov, iovcnt * sizeof(struct iovec)))
+  {
+    return -EFAULT;
+  }
 
-    // call the open
-    if (open_dir(filename) == -1)
+  // check all of them before moving anything
+  for (i = 0; i < iovcnt; i++)
+  {
+    if ((int32_t)iov[i].iov_len < 0 || total + (int32_t)iov[i].iov_len < total)
     {
-      return -1;
+      return -EINVAL;
+    }
+    if (!access_ok(iov[i].iov_base, iov[i].iov_len))
+    {
+      return -EFAULT;
     }
+    total += iov[i].iov_len;
   }
-  else if (file.file_type == 2)
+
+  total = 0;
+  for (i = 0; i < iovcnt; i++)
   {
-    // regular file
+    if (iov[i].iov_len == 0)
+    {
+      continue;
+    }
+    ret = write ? file->f_op->write(file, iov[i].iov_base, iov[i].iov_len)
+                : file->f_op->read(file, iov[i].iov_base, iov[i].iov_len);
+    if (ret < 0)
+    {
+      return total ? total : ret;
+    }
+    total += ret;
+    if (ret < (int32_t)iov[i].iov_len)
+    {
+      break;
+    }
+  }
+  return total;
+}
 
-    // create jump table
-    jump_table_fd file_jump_table = {
-        read_file,
-        write_file,
-        open_file,
-        close_file};
-    cur_task->fds[open_fd].jump_table = file_jump_table;
+int32_t sys_readv(int32_t fd, const struct iovec *iov, int32_t iovcnt)
+{
+  return do_iov(fd, iov, iovcnt, 0);
+}
 
-    // also assign the inode value since this is a file
-    cur_task->fds[open_fd].inode = file.inode_number;
+int32_t sys_writev(int32_t fd, const struct iovec *iov, int32_t iovcnt)
+{
+  return do_iov(fd, iov, iovcnt, 1);
+}
 
-    // call the open
-    if (open_file(filename) == -1)
-    {
-      return -1;
-    }
+/*
+pread and pwrite are read and write at an explicit offset (the fourth
+argument, in esi). The open file's position isn't used or moved, the
+operation runs on a private copy of the open file, so other fds sharing it
+(dup, fork) never see a changed position. Only regular files have offsets.
+*/
+static int32_t do_pio(int32_t fd, void *buf, int32_t nbytes, uint32_t offset, int32_t write)
+{
+  task *PCB_data = get_task_in_running_terminal();
+  file_t *file = vfs_fd_get(PCB_data, fd);
+
+  if (!file || nbytes < 0 || !(file->flags & (write ? FD_WRITE_PERMS : FD_READ_PERMS)))
+  {
+    return -1;
+  }
+  if (file->inode->type != DT_REG)
+  {
+    return file->inode->type == DT_DIR ? -EISDIR : -ESPIPE;
+  }
+  if (!file->f_op || !(write ? (void *)file->f_op->write : (void *)file->f_op->read))
+  {
+    return -1;
   }
-  else if (file.file_type == 0)
+  if (!access_ok(buf, nbytes))
   {
-    // RTC
+    return -EFAULT;
+  }
 
-    // create jump table
-    jump_table_fd rtc_jump_table = {
-        read_RTC,
-        write_RTC,
-        open_RTC,
-        close_RTC};
-    cur_task->fds[open_fd].jump_table = rtc_jump_table;
+  file_t at = *file;
+  at.pos = offset;
+  return write ? at.f_op->write(&at, buf, nbytes) : at.f_op->read(&at, buf, nbytes);
+}
 
-    // call the open
-    if (open_RTC(filename) == -1)
-    {
-      return -1;
-    }
+int32_t sys_pread(int32_t fd, void *buf, int32_t nbytes, uint32_t offset)
+{
+  return do_pio(fd, buf, nbytes, offset, 0);
+}
+
+int32_t sys_pwrite(int32_t fd, const void *buf, int32_t nbytes, uint32_t offset)
+{
+  return do_pio(fd, (void *)buf, nbytes, offset, 1);
+}
+
+/*
+The open system call provides access to the file system. T
+he call should find the directory entry corresponding to the
+named file, allocate an unused file descriptor, and set up any data
+necessary to handle the given type of file (directory,
+RTC device, or regular file). If the named file does not exist or
+no descriptors are free, the call returns -1.
+
+The VFS finds the file (through whatever filesystem is mounted there) and
+the inode it lands on says which operations the new file gets, so nothing
+here knows about file types.
+*/
+int32_t sys_open(const uint8_t *filename)
+{
+  char path[PATH_MAX_LENGTH];
+  int32_t len = strncpy_from_user((int8_t *)path, (const int8_t *)filename, PATH_MAX_LENGTH);
+  if (len < 0)
+  {
+    return len;
   }
-  else
+  if (len == PATH_MAX_LENGTH)
   {
-    // unknown file type
+    return -ENAMETOOLONG;
+  }
+  return do_open(path);
+}
+
+int32_t do_open(const char *path)
+{
+  // allocate an unused file descriptor in the task
+  int32_t open_fd = find_unused_fd();
+  if (open_fd == -1)
+  {
+    // no open file descriptors for current task. Abort
     return -1;
   }
 
+  file_t *file;
+  if (vfs_open(path, FD_READ_PERMS | FD_WRITE_PERMS, &file) != 0)
+  {
+    // file not found, or its open failed
+    return -1;
+  }
+
+  // get current terminal's active task
+  task *cur_task = get_task_in_running_terminal();
+  cur_task->files[open_fd] = file;
+
   // return newly allocated fd
   return open_fd;
 }
@@ -523,37 +607,18 @@ return 0.
 */
 int32_t sys_close(int32_t fd)
 {
-  if (fd == 0 || fd == 1 || fd < 0 || fd > 7)
+  if (fd == 0 || fd == 1)
   {
-    // doesn't exist or is special
+    // special
     return -1;
   }
   task *cur_task = get_task_in_running_terminal();
 
-  // if the file descriptor is open
-  if ((cur_task->fds[fd].flags & FD_IN_USE) != 0)
-  {
-
-    if (cur_task->fds[fd].jump_table.close == 0)
-    {
-      return -1;
-    }
-    // call the right close function if it exists
-    cur_task->fds[fd].jump_table.close(fd);
-
-    // also set the file descriptor to initial values
-    cur_task->fds[fd].file_position = 0;
-    cur_task->fds[fd].flags = 0; // mark it as not in use
-    cur_task->fds[fd].inode = 0;
-
-    cur_task->fds[fd].jump_table.close = 0;
-    cur_task->fds[fd].jump_table.open = 0;
-    cur_task->fds[fd].jump_table.read = 0;
-    cur_task->fds[fd].jump_table.write = 0;
-  }
-  else
+  // drops this fd's reference, the file itself is released once nothing
+  // (dup'd fds, forked children) points at it anymore
+  if (vfs_fd_close(cur_task, fd) != 0)
   {
-    // else it's not open
+    // it's not open
     return -1;
   }
   return 0;
@@ -577,11 +642,15 @@ int32_t sys_getargs(uint8_t *buf, int32_t nbytes)
     return -1;
   }
   task *cur_task = get_task_in_running_terminal();
-  if (strlen((int8_t *)&(cur_task->arguments)) + 1 > nbytes)
+  uint32_t len = strlen((int8_t *)&(cur_task->arguments));
+  if (len + 1 > nbytes)
   {
     return -1;
   }
-  strcpy((int8_t *)buf, (int8_t *)&(cur_task->arguments));
+  if (copy_to_user(buf, &(cur_task->arguments), len + 1))
+  {
+    return -EFAULT;
+  }
 
   // if no arguments (aka buf == "") also return -1
   if (strlen((int8_t*) &(cur_task->arguments)) == 0) {
@@ -596,7 +665,7 @@ virtual address. Although the address
 returned is always the same (see the memory map section later in this handout),
 it should be written into the memory
 location provided by the caller (which must be checked for validity). If the location
-is invalid, the call should return -1.
+is invalid, the call should return -1 (-EFAULT here, copy_to_user does the checking).
 To avoid adding kernel-side exception handling for this sort of check,
 you can simply check whether the address falls
 within the address range covered by the single user-level page. Note that the
@@ -608,17 +677,53 @@ video page located < 4MB and pass that address.
 #define VIDMAP_ADDR 0x8500000
 int32_t sys_vidmap(uint8_t **screen_start)
 {
-  if ((uint32_t)screen_start < PROGRAM_IMAGE_VIRTUAL_ADDRESS ||
-      (uint32_t)screen_start > PROGRAM_IMAGE_VIRTUAL_ADDRESS + FOURMB)
+  uint8_t *addr = (uint8_t *)VIDMAP_ADDR;
+  if (copy_to_user(screen_start, &addr, sizeof(addr)))
   {
-    return -1;
+    return -EFAULT;
   }
   page_directory[34] = (uint32_t)(uint32_t)page_table | READ_WRITE_BIT | PRESENT_BIT | USER_BIT;
 
   page_table[0] = ((uint32_t)VIDEO) | USER_BIT | PRESENT_BIT | READ_WRITE_BIT;
   flush_tlb();
 
-  *screen_start = (uint8_t *)(VIDMAP_ADDR);
   return VIDMAP_ADDR;
 }
 
+
+// https://wiki.osdev.org/Sysenter
+#define CPUID_EDX_SEP (1 << 11)
+#define IA32_SYSENTER_CS 0x174
+#define IA32_SYSENTER_ESP 0x175
+#define IA32_SYSENTER_EIP 0x176
+
+/**
+ * @brief Sets up the SYSENTER MSRs and points the vsyscall entry in the
+ * signal page at the fast stub. Without SEP (or on the first Pentium Pros,
+ * which report it but don't have it) programs keep going through int 0x80.
+ * Must run after signals_init, which copies the stubs into the page
+ */
+void sysenter_init() {
+  uint32_t a, b, c, d;
+  uint32_t *entry = (uint32_t *)VSYSCALL_ENTRY_ADDR;
+
+  *entry = (uint32_t)vsyscall_int80_addr;
+
+  cpuid(1, &a, &b, &c, &d);
+  // family 6, model < 3, stepping < 3 set the SEP bit without supporting it
+  if (!(d & CPUID_EDX_SEP) || (((a >> 8) & 0xF) == 6 && ((a >> 4) & 0xF) < 3 && (a & 0xF) < 3)) {
+    printf("SYSENTER not supported, syscalls use int 0x80\n");
+    return;
+  }
+
+  // SYSENTER loads cs from this and ss = cs + 8, SYSEXIT uses cs + 16 and
+  // cs + 24 with RPL 3, which is exactly how our GDT is laid out
+  wrmsr(IA32_SYSENTER_CS, KERNEL_CS);
+  // the entry stub loads the real stack pointer from tss.esp0, which changes
+  // on every task switch, so point at the field instead of a fixed stack
+  wrmsr(IA32_SYSENTER_ESP, (uint32_t)&tss.esp0);
+  wrmsr(IA32_SYSENTER_EIP, (uint32_t)sysenter_entry);
+
+  sysenter_return = (uint32_t)sysenter_return_addr;
+  *entry = (uint32_t)vsyscall_sysenter_addr;
+}
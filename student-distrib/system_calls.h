@@ -51,17 +51,67 @@ int32_t sigprocmask(int how, int setp, int oldsetp);
 // tasks
 int32_t fork();
 
+// the handlers behind the ECE391 calls
+int32_t sys_halt(uint8_t status);
+
+int32_t sys_execute(const uint8_t* command);
+
+int32_t sys_getargs(uint8_t* buf, int32_t nbytes);
+
+int32_t sys_vidmap(uint8_t** screen_start);
+
 // expose some of these syscalls publically so we can use them in the kernel
 int32_t sys_close(int32_t fd);
 
 int32_t sys_open(const uint8_t* filename);
 
+// the kernel side of execute and open, for callers whose pointers are the
+// kernel's own (sys_execute / sys_open copy theirs in from user memory first)
+int32_t do_execute(const uint8_t* command);
+
+int32_t do_open(const char* path);
+
 int32_t sys_read(int32_t fd, void* buf, int32_t nbytes);
 
-// jump table
-typedef int32_t (*syscall_handler)(int, int, int);
-extern syscall_handler jump_table[NUM_SYSCALLS];
+int32_t sys_write(int32_t fd, const void* buf, int32_t nbytes);
+
+struct iovec;
+
+/**
+ * @brief read / write over several buffers in one call
+ * @return int32_t bytes transferred, -EINVAL for a bad count, -EFAULT
+ */
+int32_t sys_readv(int32_t fd, const struct iovec* iov, int32_t iovcnt);
+int32_t sys_writev(int32_t fd, const struct iovec* iov, int32_t iovcnt);
 
-void register_all_syscalls();
+/**
+ * @brief read / write at offset, leaving the file position alone. Regular
+ * files only (-ESPIPE / -EISDIR otherwise)
+ */
+int32_t sys_pread(int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+int32_t sys_pwrite(int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+
+// dispatch table, indexed by call number (see syscall_table.h)
+typedef int32_t (*syscall_handler)(int, int, int);
+extern syscall_handler syscall_table[NUM_SYSCALLS];
+
+// per call number: times called and total TSC cycles spent in the handler
+extern uint32_t syscall_count[NUM_SYSCALLS];
+extern uint64_t syscall_cycles[NUM_SYSCALLS];
+
+/**
+ * @brief Adds /proc/syscalls with the counts above. procfs must be registered
+ */
+void syscall_stats_init();
+
+// SYSENTER fast path (system_call_public.S)
+void sysenter_entry();
+extern uint32_t sysenter_return;
+
+/**
+ * @brief Enables the SYSENTER path if the CPU has it and picks the vsyscall
+ * stub user programs call through. Call after signals_init
+ */
+void sysenter_init();
 
 #endif
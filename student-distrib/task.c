@@ -10,7 +10,10 @@
 #include "elf.h"
 #include "wait.h"
 #include "mm/kmalloc.h"
+#include "mm/zeropage.h"
 #include "errno.h"
+#include "mm/uaccess.h"
+#include "libc/sys/wait.h"
 
 // All of our running tasks! Initialized to zero since its global
 task tasks[MAX_TASKS];
@@ -83,36 +86,27 @@ task *init_task(uint32_t pid)
   // put this task ptr at a very specific address
   task *task_pcb = (task *)calculate_task_pcb_pointer(pid);
 
-  // initiate two open file descriptors for stdin and stdout (0 and 1)
-  file_descriptor stdin, stdout;
-
-  // stdin is read only (keyboard input)
-  jump_table_fd stdin_jt = {
-      .read = terminal_read,
-  };
-
-  // stdout is write only (terminal output)
-  jump_table_fd stdout_jt = {
-      .write = terminal_write,
-  };
-  stdin.file_position = 0;
-  stdin.flags = 1;
-  stdin.inode = 0;
-  stdin.jump_table = stdin_jt;
-  stdout.file_position = 0;
-  stdout.flags = 1;
-  stdout.inode = 0;
-  stdout.jump_table = stdout_jt;
-
-  stdin.flags |= FD_READ_PERMS;
-  stdout.flags |= FD_WRITE_PERMS;
-
   // set everything to 0 first
   memset(task_pcb, 0, sizeof(task));
 
-  // these should do a deep copy? IF not then just get rid of the file_descirptor stuff
-  task_pcb->fds[0] = stdin;
-  task_pcb->fds[1] = stdout;
+  // stdin and stdout (0 and 1) are two opens of the terminal, stdin is read
+  // only (keyboard input) and stdout is write only (terminal output). A
+  // program started by another one gets the parent's instead, which is how
+  // the shell points them at a pipe
+  task *parent = terminals[cur_terminal_running].current_task;
+  inode_t *tty = vfs_chrdev_inode("tty", 3);
+  int fd;
+  for (fd = 0; fd <= 1; fd++)
+  {
+    if (parent && parent->files[fd])
+    {
+      task_pcb->files[fd] = vfs_file_get(parent->files[fd]);
+    }
+    else if (tty)
+    {
+      vfs_open_inode(tty, fd == 0 ? FD_READ_PERMS : FD_WRITE_PERMS, &task_pcb->files[fd]);
+    }
+  }
 
   task_pcb->pid = pid;
   task_pcb->parent_task = terminals[cur_terminal_running].current_task;
@@ -177,13 +171,10 @@ int32_t find_unused_fd()
 {
   int32_t i;
   task *cur_task = terminals[cur_terminal_running].current_task;
-  for (i = 0; i < 8; i++)
+  for (i = 0; i < MAX_OPEN_FILES; i++)
   {
-    file_descriptor f = cur_task->fds[i];
-    uint32_t flags = f.flags;
-    if ((flags & FD_IN_USE) == 0)
+    if (!cur_task->files[i])
     {
-      // printf("open fd: %d\n", i);
       return i;
     }
   }
@@ -196,13 +187,12 @@ int32_t find_unused_fd()
  * 
  * @param esp The value of the esp register for this task context
  * @param new_val The value we want to be at the memory location
- * @return int 
+ * @return int 0, or -EFAULT if the stack runs into unmapped memory
  */
 int push_onto_task_stack(uint32_t* esp, uint32_t new_val) {
   *esp -= 4; // move esp for this user stack down 4
-  *esp = new_val;
-  // value is bfc00000 if its hard to see. The reason why is because there's 0x400000 or 4MB stack for each user process starting at c0000000
-  if (*esp < 0xbfc00000) {
+  // it's the task's stack, so copy_to_user stops us if it has overflowed
+  if (copy_to_user((void *)*esp, &new_val, sizeof(uint32_t))) {
 		// Stack overflow!
 		return -EFAULT;
 	}
@@ -213,18 +203,40 @@ int push_buf_onto_task_stack(uint32_t* esp, uint8_t* buf, uint32_t len) {
   *esp -= len; // move esp for this user stack down 4
   *esp &= ~3;  // align to DWORD (last two bits zeroed)
 
-  if (*esp < 0xbfc00000) {
+  if (copy_to_user((void *)*esp, buf, len)) {
 		// Stack overflow!
 		return -EFAULT;
 	}
-  memcpy(esp, buf, len);
   return 0;
 }
 
+// children and zombies lists, linked through sib_prev / sib_next
+static void task_list_add(task **head, task *t) {
+  t->sib_prev = NULL;
+  t->sib_next = *head;
+  if (*head) {
+    (*head)->sib_prev = t;
+  }
+  *head = t;
+}
+
+static void task_list_del(task **head, task *t) {
+  if (t->sib_prev) {
+    t->sib_prev->sib_next = t->sib_next;
+  }
+  else {
+    *head = t->sib_next;
+  }
+  if (t->sib_next) {
+    t->sib_next->sib_prev = t->sib_prev;
+  }
+  t->sib_prev = t->sib_next = NULL;
+}
+
 int32_t sys_fork() {
   int32_t cur_pid = sys_getpid();
   int32_t child_pid = get_new_process_id();
-  if (get_new_process_id < 0) {
+  if (child_pid < 0) {
     // if out of PIDs
     return child_pid;
   }
@@ -236,10 +248,15 @@ int32_t sys_fork() {
   child_task_ptr->pid = child_pid;
   child_task_ptr->parent_pid = cur_pid;
 
-  // allocate a new region of memory to store the same pathname? Not sure why this kmalloc is needed but OK
-  child_task_ptr->wd = kmalloc(PATH_MAX_LENGTH);
-  memcpy(child_task_ptr->wd, cur_task_ptr->wd, PATH_MAX_LENGTH);
+  // pending signals were sent to the parent, not the child
+  child_task_ptr->pending_signals = 0;
+  child_task_ptr->sigqueue_len = 0;
+  wait_queue_init(&child_task_ptr->signal_wait);
 
+  // the memcpy gave it the parent's family, it starts with none of its own
+  child_task_ptr->children = NULL;
+  child_task_ptr->zombies = NULL;
+  wait_queue_init(&child_task_ptr->child_wait);
 
   // kernel stack initialization
   // loop thru all the available kernel stacks and find the first one not being used
@@ -255,7 +272,9 @@ int32_t sys_fork() {
     }
   }
   if (i == 256) {
-    // failed to allocate a kernel stack
+    // failed to allocate a kernel stack. The memcpy made the slot look in
+    // use, give it back
+    child_task_ptr->status = TASK_ST_NA;
     return -ENOMEM;
   }
 
@@ -263,8 +282,26 @@ int32_t sys_fork() {
   child_task_ptr->pages = kmalloc(sizeof(task_ptentry_t) * cur_task_ptr->page_limit);
   
   if (!child_task_ptr->pages) {
+    kstack[i].pid = -1;
+    child_task_ptr->status = TASK_ST_NA;
+    return -ENOMEM;
+  }
+
+  // allocate a new region of memory to store the same pathname? Not sure why this kmalloc is needed but OK
+  child_task_ptr->wd = kmalloc(PATH_MAX_LENGTH);
+  if (!child_task_ptr->wd) {
+    kfree(child_task_ptr->pages);
+    kstack[i].pid = -1;
+    child_task_ptr->status = TASK_ST_NA;
     return -ENOMEM;
   }
+  memcpy(child_task_ptr->wd, cur_task_ptr->wd, PATH_MAX_LENGTH);
+
+  // nothing can fail from here on. The child points at the same open files,
+  // it just holds its own references, and only now is it a child waitpid
+  // can find
+  vfs_fd_share_all(child_task_ptr);
+  task_list_add(&cur_task_ptr->children, child_task_ptr);
 
   // copy over contents of all the pages
   memcpy(child_task_ptr->pages, cur_task_ptr->pages, sizeof(task_ptentry_t) * cur_task_ptr->page_limit);
@@ -321,6 +358,10 @@ void task_release(task* t) {
   // program status change
   t->status = TASK_ST_DEAD;
 
+  // the ring lived in the program's memory
+  t->ring = NULL;
+  t->ring_flags = 0;
+
   // dealloc pages in use by this program
   for (i = 0; i < t->page_limit; i++) {
     if (!(t->pages[i].pt_flags & PRESENT_BIT)) {
@@ -350,16 +391,34 @@ void task_release(task* t) {
   }
 }
 
+/**
+ * @brief Hands the children of t to the kernel task. It never waits, so the
+ * ones that already exited are released here and the others will be when they
+ * exit. O(children)
+ */
+static void task_reparent_children(task *t) {
+  task *c;
+  while ((c = t->zombies)) {
+    task_list_del(&t->zombies, c);
+    task_release(c);
+  }
+  while ((c = t->children)) {
+    task_list_del(&t->children, c);
+    c->parent_pid = TASK_INIT_PID;
+  }
+}
+
 int32_t sys_exit(int32_t status) {
   int32_t cur_pid = sys_getpid();
   int32_t parent_pid = get_task()->parent_pid;
   task* cur_task_ptr = tasks + cur_pid;
   task* parent_task_ptr = tasks + parent_pid;
+  uint32_t flags;
 
-  // close all file descriptors
+  // close all file descriptors, stdin and stdout too
   int i;
   for (i = 0; i < MAX_OPEN_FILES; i++) {
-    sys_close(i);
+    vfs_fd_close(cur_task_ptr, i);
   }
 
   // run new shell process if no shell running in terminal
@@ -368,14 +427,21 @@ int32_t sys_exit(int32_t status) {
   // set return value to error code
   cur_task_ptr->regs.eax = status;
 
-  // now we send either 1. SIGCHLD to parent and make the child process a zombie
-  // or 2. if the handler for SIGCHLD has SA_NOCLDWAIT, then we close the current process and send a SIGCONT to parent
+  // the lists are also walked by waitpid, and a stop signal wakes child_wait from the IRQ side
+  cli_and_save(flags);
+  task_reparent_children(cur_task_ptr);
 
-  if (parent_task_ptr->status == TASK_ST_SLEEP || parent_task_ptr->status == TASK_ST_RUNNING) {
-    if (parent_task_ptr->sigacts[SIGCHLD].flags & SA_NOCLDWAIT) {
+  // now we either 1. make the child process a zombie, wake the parent's waitpid and send it SIGCHLD
+  // or 2. if the parent is the kernel task or its SIGCHLD handler has SA_NOCLDWAIT, we close the current process right away
 
+  if (parent_pid != TASK_INIT_PID && parent_pid < MAX_TASKS &&
+      (parent_task_ptr->status == TASK_ST_SLEEP || parent_task_ptr->status == TASK_ST_RUNNING)) {
+    if (parent_task_ptr->sigacts[SIGCHLD].flags & SA_NOCLDWAIT) {
+      task_list_del(&parent_task_ptr->children, cur_task_ptr);
       scheduler_page_clear(cur_task_ptr);
       task_release(cur_task_ptr);
+      // a waitpid may be waiting on its last child
+      wake_up(&parent_task_ptr->child_wait);
       sys_kill(parent_pid, SIGCONT);
     }
     else {
@@ -390,6 +456,9 @@ int32_t sys_exit(int32_t status) {
       else {
         cur_task_ptr->exit_status = WEXITSTATUS(status) | WIFEXITED(-1);
       }
+      task_list_del(&parent_task_ptr->children, cur_task_ptr);
+      task_list_add(&parent_task_ptr->zombies, cur_task_ptr);
+      wake_up(&parent_task_ptr->child_wait);
       sys_kill(parent_pid, SIGCHLD); // by default ignored
     }
   }
@@ -399,97 +468,157 @@ int32_t sys_exit(int32_t status) {
     scheduler_page_clear(cur_task_ptr);
     task_release(cur_task_ptr);
   }
+  restore_flags(flags);
 
-  // so at this point the task that called exit should have its status set to DEAD, therefore scheduler will never run it again
-  // also parent task has been properly notified via and we are ready to call wait() to get the exit status of the dead process.
+  // so at this point the task that called exit should have its status set to DEAD (or ZOMBIE), therefore scheduler will never run it again
+  // also parent task has been properly woken up and its waitpid will collect the exit status of the dead process.
   next_scheduled_task();
 
   // should never hit
   return 0;
 }
 
+// the child of t that pid refers to (any child for pid <= 0), if it's on list
+static task *waitpid_match(task *t, task *list, pid_t pid) {
+  if (pid <= 0) {
+    return list;
+  }
+  // O(1): the child's own entry says whose it is
+  if (pid >= MAX_TASKS || tasks[pid].parent_pid != t->pid) {
+    return NULL;
+  }
+  if (list == t->zombies) {
+    return tasks[pid].status == TASK_ST_ZOMBIE ? tasks + pid : NULL;
+  }
+  return tasks[pid].status == TASK_ST_RUNNING || tasks[pid].status == TASK_ST_SLEEP ? tasks + pid : NULL;
+}
+
+// stopped child to report for WUNTRACED, O(children) since stops are rare
+static task *waitpid_stopped(task *t, pid_t pid) {
+  task *c;
+  if (pid > 0) {
+    c = waitpid_match(t, t->children, pid);
+    return c && c->status == TASK_ST_SLEEP && WIFSTOPPED(c->exit_status) ? c : NULL;
+  }
+  for (c = t->children; c; c = c->sib_next) {
+    if (c->status == TASK_ST_SLEEP && WIFSTOPPED(c->exit_status)) {
+      return c;
+    }
+  }
+  return NULL;
+}
+
 int32_t sys_waitpid(pid_t pid, int *wstatus, int options) {
-  int i;
-  if (!wstatus) {
+  task *t = tasks + get_task()->pid;
+  task *c;
+  siginfo_t info;
+  int32_t ret, status = 0;
+  uint32_t flags;
+  if (!wstatus || !access_ok(wstatus, sizeof(int))) {
     return -EFAULT;
   }
-  int cur_proc_pid = get_task()->pid;
 
-  int found_child = 0;
-  // loop thru each process and check if any are children of current process
-  for (i = 0; i < MAX_TASKS; i++) {
-    if (tasks[i].pid == pid) {
-      // check if its parent is itself? Not sure about this one
-      // Shouldn't it be, check if parent is current process? I changed it below...
-      if (tasks[i].parent_pid != cur_proc_pid) {
-        return -ECHILD;
-      }
-      found_child = 1;
+  cli_and_save(flags);
+  for (;;) {
+    // a zombie is reaped off the front of the list, or straight from its entry for a given pid
+    c = waitpid_match(t, t->zombies, pid);
+    if (c) {
+      status = c->exit_status;
+      ret = c->pid;
+      task_list_del(&t->zombies, c);
+      task_release(c);
       break;
     }
-
-    // other case- if waiting on ANY pid, then we just have to check if its parrent is current pid
-    if ((pid < 0 || pid > MAX_TASKS) && tasks[i].parent_pid == cur_proc_pid) {
-      switch (tasks[i].status) {
-        case TASK_ST_RUNNING:
-          found_child = 1;
-          break;
-        case TASK_ST_ZOMBIE:
-          // could be a zombie cuz when we exit() we will zombie the process in one of the cases
-          *wstatus = tasks[i].exit_status;
-
-          // free the zombie process.
-          task_release(&tasks[i]);
-          return tasks[i].pid;
-        case TASK_ST_SLEEP:
-          // if WUNTRACED in options, then return if a child has stopped
-          if ((options & WUNTRACED) ) {
-            *wstatus = tasks[i].exit_status;
-            tasks[i].exit_status = 0;
-            return tasks[i].pid;
-          }
-      }
+    // if WUNTRACED in options, then return if a child has stopped
+    if ((options & WUNTRACED) && (c = waitpid_stopped(t, pid))) {
+      status = c->exit_status;
+      ret = c->pid;
+      c->exit_status = 0;
+      break;
+    }
+    if (!waitpid_match(t, t->children, pid)) {
+      // no relevant processes found
+      ret = -ECHILD;
+      break;
+    }
+    // if WNOHANG was specified and one or more child(ren) specified by pid exist, but have not yet changed
+    // state, then 0 is returned.
+    if (options & WNOHANG) {
+      ret = 0;
+      break;
     }
-  }
-  if (!found_child) {
-    // no relevant processes found
-    return -ECHILD;
-  }
-  // if WNOHANG was specified and one or more child(ren) specified by pid exist, but have not yet changed
-  // state, then 0 is returned.  On failure, -1 is returned. Because again wait will block the current process thread 
-  // until child process changes state
-  if (options & WNOHANG) {
-    return -ECHILD;
-  }
 
-  // set a new signal handler and assign it to SIGCHLD on the current process
-  sigaction_t sa;
-  sigemptyset(&(sa.mask));
-  sa.flags = SA_RESTART;
-  sa.handler = SIGHANDLER_IGNORE;
-  sys_sigaction(SIGCHLD, &sa, 0);
+    // an ignored SIGCHLD left over from an earlier child would cut the sleep short
+    if (sigismember(&t->pending_signals, SIGCHLD) &&
+        (t->sigacts[SIGCHLD].handler == SIGHANDLER_DEFAULT || t->sigacts[SIGCHLD].handler == SIGHANDLER_IGNORE)) {
+      signal_dequeue(t, SIGCHLD, &info);
+    }
 
-  // now call sigsuspend to put current process to sleep and wait for a SIGCHLD signal
+    // second part means "blocked by syscall" and first part includes syscall number which is WAIT
+    t->exit_status = SYSCALL_WAITPID | WIFSYSCALL(-1);
+    ret = wait_queue_sleep(&t->child_wait);
+    t->exit_status = 0;
+    if (ret < 0) {
+      // -EINTR, a signal came in first
+      break;
+    }
+    // woken by an exit or a stop, which may not be the child we're after: look again
+  }
+  restore_flags(flags);
 
-  sigset_t st;
-  sigemptyset(&st); // lets all signals thru
+  if (ret > 0 && copy_to_user(wstatus, &status, sizeof(int))) {
+    return -EFAULT;
+  }
+  return ret;
+}
 
-  // second part means "blocked by syscall" and first part includes syscall number which is WAIT
-  tasks[cur_proc_pid].exit_status = SYSCALL_WAITPID | WIFSYSCALL(-1);
-  sys_sigsuspend(&st);
-  return 0; // does not hit
+/**
+ * @brief Copies the strings of a user argv or envp array onto the new stack
+ *
+ * @param esp stack pointer of the new stack, moved down past the strings
+ * @param uarr the user's NULL terminated array, may be NULL
+ * @param out where each string landed (in the final stack mapping), NULL terminated
+ * @return int32_t number of strings, -EFAULT or -E2BIG
+ */
+static int32_t execve_push_strings(uint32_t *esp, char **uarr, uint32_t *out) {
+  char str[PATH_MAX_LENGTH];
+  char *ustr;
+  int32_t n, len;
+  for (n = 0; uarr; n++) {
+    if (copy_from_user(&ustr, uarr + n, sizeof(char *))) {
+      return -EFAULT;
+    }
+    if (!ustr) {
+      break;
+    }
+    len = strncpy_from_user((int8_t *)str, (const int8_t *)ustr, PATH_MAX_LENGTH);
+    if (len < 0) {
+      return len;
+    }
+    if (len == PATH_MAX_LENGTH || push_buf_onto_task_stack(esp, (uint8_t *)str, len + 1) != 0) {
+      return -E2BIG;
+    }
+    out[n] = *esp - 0x400000; // Offset 4MB
+  }
+  out[n] = 0; // Terminating zero
+  return n;
 }
 
 int32_t sys_execve(char *pathname, int argv, int envp) {
-  char **argvv = (char **)argv;
-  char **envpp = (char **)envp;
+  char path[PATH_MAX_LENGTH];
   
   if (!pathname) {
     return -1;
   }
-  int ret;
+  int ret = strncpy_from_user((int8_t *)path, (const int8_t *)pathname, PATH_MAX_LENGTH);
+  if (ret < 0) {
+    return ret;
+  }
+  if (ret == PATH_MAX_LENGTH) {
+    return -ENAMETOOLONG;
+  }
   // check ELF header
-  int fd = sys_open(pathname);
+  int fd = do_open(path);
   if (fd < 0) {
     return fd;
   }
@@ -504,9 +633,9 @@ int32_t sys_execve(char *pathname, int argv, int envp) {
   task_ptentry_t ptent_stack, tmp_pages[2];
 
   // allocate a 4MB page for new stack (temporary at virtual addr 0xc0000000 - 0xc0400000)
+  // zeroed, so the new program doesn't see what the page last held
 	ptent_stack.vaddr = 0xc0000000;
-	ptent_stack.paddr = 0;
-	ret = page_alloc_4MB((int *)&(ptent_stack.paddr));
+	ret = zeropage_alloc_4mb(&ptent_stack.paddr);
 	if (ret != 0) {
 		// Page allocation failed. Probably ENOMEM
 		return -1;
@@ -521,6 +650,7 @@ int32_t sys_execve(char *pathname, int argv, int envp) {
 	flush_tlb();
 
   task *proc = get_task();
+  uint32_t old_esp = proc->regs.esp;
   // set stack ptr of new process
 	proc->regs.esp = 0xc0400000; // Default stack address
 
@@ -530,29 +660,25 @@ int32_t sys_execve(char *pathname, int argv, int envp) {
   // Parse argv
   // so what I think this is doing is pushing the values in argv onto the user stack
   // and then also populating u_argv array with the location to which it is at.
+  // argv and envp are still the old program's memory, so every pointer and
+  // string is copied in checked, and a bad one fails execve before the old
+  // program is gone
 	u_argv = (uint32_t *) 0xc0000000; // Temporarily use top of stack as heap
-	if (argv) {
-		for (argc = 0; argv[argc]; argc++) {
-			push_buf_onto_task_stack(&(proc->regs.esp), (uint8_t *) argv[argc],
-							strlen(argv[argc])+1);
-			u_argv[argc] = proc->regs.esp - 0x400000; // Offset 4MB
-		}
-	} else {
-		argc = 0;
+	ret = execve_push_strings(&(proc->regs.esp), (char **)argv, u_argv);
+	if (ret >= 0) {
+		argc = ret;
+		// Parse envp
+		u_envp = u_argv + argc + 1;
+		ret = execve_push_strings(&(proc->regs.esp), (char **)envp, u_envp);
+		envc = ret;
 	}
-	u_argv[argc] = 0; // Terminating zero
-	// Parse envp
-	u_envp = u_argv + argc + 1;
-	if (envp) {
-		for (envc = 0; envp[envc]; envc++) {
-			push_buf_onto_task_stack(&(proc->regs.esp), (uint8_t *) envp[envc],
-							strlen(envp[envc])+1);
-			u_envp[envc] = proc->regs.esp - 0x400000; // Offset 4MB
-		}
-	} else {
-		envc = 0;
+	if (ret < 0) {
+		proc->regs.esp = old_esp;
+		page_dir_delete_entry(ptent_stack.vaddr);
+		page_alloc_free_4MB(ptent_stack.paddr);
+		flush_tlb();
+		return ret;
 	}
-	u_envp[envc] = 0; // Terminating zero
 
   // Move temp values back (no clue what this is pushing- why do we have to push twice?)
   // so do u_argv and u_envp hold offset values to each of the arguments/env variables?
@@ -567,14 +693,19 @@ int32_t sys_execve(char *pathname, int argv, int envp) {
 	// ece391_getargs workaround: bottom of stack points to argv
 	*(uint32_t *)(0xc0400000 - 4) = (uint32_t) u_argv;
 
-	strcpy((char *)0xc0000000, (char *)pathname); // Copy path to top-of-stack
+	strcpy((char *)0xc0000000, path); // Copy path to top-of-stack
 
-  for (i = 3; i < TASK_MAX_OPEN_FILES; i++) {
+  for (i = 3; i < MAX_OPEN_FILES; i++) {
 		if (proc->files[i]) {
-			sys_close(i);
+			vfs_fd_close(proc, i);
 		}
 	}
 
+  // a registered ring points into the old image, and the timer tick would
+  // run whatever the new one has at that address as entries
+  proc->ring = NULL;
+  proc->ring_flags = 0;
+
   // release previous process
   ret = task_current_pid();
 
@@ -623,7 +754,7 @@ void task_create_kernel_pid() {
 	init_task->sigacts[SIGCHLD].flags = SA_NOCLDWAIT;
 	
   // alloc some memory for working directory, pages
-	init_task->wd = kmalloc(sizeof(PATH_MAX_LENGTH));
+	init_task->wd = kmalloc(PATH_MAX_LENGTH);
   strcpy(init_task->wd, "/");
 	init_task->pages = kmalloc(4 * sizeof(task_ptentry_t));
 	init_task->page_limit = 4;
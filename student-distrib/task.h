@@ -5,6 +5,8 @@
 #include "libc/signal.h"
 #include "interrupt_handlers.h"
 #include "libc/sys/types.h"
+#include "fs/vfs.h"
+#include "wait.h"
 
 // defined by MP3
 #define MAX_OPEN_FILES 8
@@ -42,37 +44,9 @@ physical memory address (either 8 MB or 12 MB). Then, the program image must be
 */
 #define PROGRAM_IMAGE_VIRTUAL_ADDRESS 0x08000000 // 128 MB
 #define OFFSET_WITHIN_PAGE 0x00048000
-/*
-The file operations jump table associated with the correct file type. 
-This jump table should contain entries
-for open, read, write, and close to perform type-specific actions 
-for each operation. open is used for
-performing type-specific initialization. For example, if we just open’d 
-the RTC, the jump table pointer in this
-structure should store the RTC’s file operations table.
-*/
-typedef struct jump_table_fd {
-  int32_t (*read)(int32_t, void*, int32_t);
-  int32_t (*write)(int32_t, const void*, int32_t);
-  int32_t (*open)(const uint8_t*);
-  int32_t (*close)(int32_t);
-} jump_table_fd;
-
-// for flags bit, let's let the very first bit be whether or not the FD is in use.
-// it will be set to 1 if in use, 0 otherwise.
-#define FD_IN_USE 0x1
-
-// lets also define read + write privs for certain file descriptors. For example, stdin
-// is read only while stdout is write only
-#define FD_READ_PERMS 0x2
-#define FD_WRITE_PERMS 0x4
-
-typedef struct file_descriptor {
-  jump_table_fd jump_table;
-  uint32_t inode;
-  uint32_t file_position;
-  uint32_t flags;
-} file_descriptor;
+// open files are shared, refcounted file_t objects (see fs/vfs.h). A task's
+// fd is just a pointer to one, NULL if the fd isn't in use. fork and dup make
+// more pointers to the same file_t, so they also share the file position
 
 // task states (only one should be set at a time) https://elixir.bootlin.com/linux/latest/source/include/linux/sched.h#L84
 #define TASK_ST_NA			0	///< Process PID is not in use
@@ -83,7 +57,14 @@ typedef struct file_descriptor {
 
 #define COPY_ON_WRITE 1 /// for priv_flags field, mark the page of a process as copy on write
 
+#define TASK_INIT_PID 0 ///< the kernel task, adopts orphans and never waits for them
+
 #define SIG_MAX 32
+#define SIGQUEUE_MAX 16 ///< signals with info a task can have waiting
+
+// task work flags, things to do before the task goes back to user mode
+#define TASK_WORK_SIGNAL	0x1	///< a signal that isn't blocked is pending
+#define TASK_WORK_RING		0x2	///< the timer tick caught it with a polled ring (ring.h)
 
 #define PATH_MAX_LENGTH 256
 
@@ -103,7 +84,7 @@ typedef struct s_task_ptentry {
 typedef struct task_t {
   uint8_t status; ///< Current status of this task
   uint8_t tty; ///< Attached tty number
-  file_descriptor fds[MAX_OPEN_FILES];
+  file_t *files[MAX_OPEN_FILES]; ///< open files, indexed by fd
   uint8_t name_of_task[32];
   uint32_t pid; // the process ID tells us all sorts of into about where the process is in memory
   uint32_t parent_pid; ///< parent process id
@@ -115,7 +96,16 @@ typedef struct task_t {
   struct sigaction sigacts[32]; ///< Signal handlers
 	sigset_t pending_signals;	///< Pending signals
 	sigset_t signal_mask; ///< Deferred signals
+	siginfo_t sigqueue[SIGQUEUE_MAX]; ///< Info of the pending signals, oldest first
+	uint32_t sigqueue_len; ///< Entries in sigqueue
+	wait_queue_t signal_wait; ///< signalfd readers waiting for a signal
+	volatile uint32_t work; ///< TASK_WORK_*, checked on every return to user mode
 	uint32_t exit_status; ///< Status to report on `wait`
+	struct task_t *children; ///< Live (running or stopped) children, newest first
+	struct task_t *zombies; ///< Exited children not waited for yet, newest first
+	struct task_t *sib_prev; ///< Neighbours on the parent's children or zombies list
+	struct task_t *sib_next;
+	wait_queue_t child_wait; ///< `waitpid` callers, woken when a child exits or stops
 
   // current ebp + esp
   uint32_t esp;
@@ -146,6 +136,9 @@ typedef struct task_t {
 	uint16_t gid; ///< Group ID of the process
 	
 	char *wd; ///< Working directory
+
+  struct ring *ring; ///< registered system call ring (see ring.h), NULL if none
+  uint32_t ring_flags; ///< RING_SETUP_* it was registered with
   
 } task;
 
@@ -232,7 +225,9 @@ int32_t sys_exit(int32_t error_code);
  * @param wstatus A pointer to an int- stores a status code into this pointer indicating some info about how the process terminated
  * @param options 
  * @return int32_t on success, returns the process ID of the terminated
-       child; on failure, -1 is returned.
+       child; 0 if WNOHANG was given and no child changed state yet;
+       -ECHILD if there's no such child, -EINTR if a signal came first.
+       Sleeps on the caller's child_wait, which exit and stop wake
 
  */
 int32_t sys_waitpid(pid_t pid, int *wstatus, int options);
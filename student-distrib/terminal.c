@@ -3,22 +3,15 @@
 #include "system_calls.h"
 #include "task.h"
 #include "paging.h"
+#include "errno.h"
+#include "mm/uaccess.h"
+#include "mm/kmalloc.h"
+#include "drivers/tty.h"
 
 int cur_terminal_displayed = 0;
 int cur_terminal_running = 1;
 terminal_t terminals[NUM_TERMINALS];
 
-// i = the terminal
-void clear_terminal_line_buffer(uint32_t terminal_num)
-{
-  int i;
-  for (i = 0; i < LINE_BUFFER_MAX_SIZE; i++)
-  {
-    terminals[terminal_num].line_buffer[i] = 0;
-  }
-  terminals[terminal_num].line_buffer_idx = 0;
-}
-
 void init_terminal()
 {
   int i;
@@ -27,9 +20,6 @@ void init_terminal()
     // let current running pid of 0 mean no task is running
     memset(&terminals[i], 9, sizeof(terminals[i]));
     terminals[i].current_task = 0;
-    clear_terminal_line_buffer(i);
-    terminals[i].line_buffer_idx = 0;
-    terminals[i].newline_received = 0;
     terminals[i].screen_x = 0;
     terminals[i].screen_y = 0;
     terminals[i].num_processes_running = 0;
@@ -37,6 +27,13 @@ void init_terminal()
 
     // terminal 0: 0xB9000, terminal 1 : 0xBA000, terminal 2: 0xBB000
     terminals[i].video_mem_start = (uint32_t)(VIDEO + FOURKB * (i + 1));
+    terminals[i].row_offset = 0;
+
+    // 160 bytes a line, so the default 500 lines is about 80KB per terminal
+    terminals[i].history = SCROLLBACK_LINES ? kmalloc(SCROLLBACK_LINES * NUM_COLS * sizeof(uint16_t)) : NULL;
+    terminals[i].history_next = 0;
+    terminals[i].history_lines = 0;
+    terminals[i].scroll_view = 0;
     // set all video memory to zero at the beginning
   }
   // spawn an instance of shell in this terminal
@@ -58,6 +55,7 @@ void save_terminal_state()
   // save the old video memory. We do it lazily, meaning only once we are about
   // to switch terminals do we save the state of the current one
   memcpy((int8_t *)terminals[cur_terminal_displayed].video_mem_start, (int8_t *)VIDEO, NUM_COLS * NUM_ROWS * 2);
+  terminals[cur_terminal_displayed].row_offset = 0;
   terminals[cur_terminal_displayed].screen_y = (uint32_t)screen_y;
   terminals[cur_terminal_displayed].screen_x = (uint32_t)screen_x;
 }
@@ -68,8 +66,13 @@ void save_terminal_state()
 */
 void rewrite_video_state()
 {
-  // rewrite video memory from new terminal to video mem
-  memcpy((int8_t *)VIDEO, (int8_t *)terminals[cur_terminal_displayed].video_mem_start, NUM_COLS * NUM_ROWS * 2);
+  // rewrite video memory from new terminal to video mem. The backing page is
+  // a ring starting at row_offset, so that's two copies to get it in order
+  uint32_t top = terminals[cur_terminal_displayed].row_offset;
+  uint16_t *backing = (uint16_t *)terminals[cur_terminal_displayed].video_mem_start;
+  memcpy((uint16_t *)VIDEO, backing + top * NUM_COLS, (NUM_ROWS - top) * NUM_COLS * 2);
+  memcpy((uint16_t *)VIDEO + (NUM_ROWS - top) * NUM_COLS, backing, top * NUM_COLS * 2);
+  terminals[cur_terminal_displayed].row_offset = 0;
 
   // change cursor position (this will move blinking and also set screen_x and screen_y)
   change_write_head((int8_t)terminals[cur_terminal_displayed].screen_x, (int8_t)terminals[cur_terminal_displayed].screen_y);
@@ -101,89 +104,226 @@ void switch_terminal(uint32_t new_terminal_idx)
   // restore video map
   // map_video_mem(0);
 
+  scrollback_reset();
   save_terminal_state();
   cur_terminal_displayed = new_terminal_idx;
   rewrite_video_state();
 }
 
-int32_t terminal_close(int32_t fd)
+/*
+Scrollback. Rows are copied into the history ring as they scroll off the top,
+one 160 byte copy per line no matter how much history there is. Viewing it
+saves the live screen to the backing page like a terminal switch would, then
+draws the view straight from the ring and the saved screen. Any output puts
+the live screen back first.
+*/
+void scrollback_push(uint32_t term, const uint16_t *row)
 {
-  return 0;
+  terminal_t *t = &terminals[term];
+  if (!t->history)
+  {
+    return;
+  }
+  memcpy(t->history + t->history_next * NUM_COLS, row, NUM_COLS * sizeof(uint16_t));
+  if (++t->history_next == SCROLLBACK_LINES)
+  {
+    t->history_next = 0;
+  }
+  if (t->history_lines < SCROLLBACK_LINES)
+  {
+    t->history_lines++;
+  }
 }
 
-/*
-Terminal read only returns when the enter key is pressed and should always add the newline character at the
-end of the buffer before returning. Remember that the 128 character limit includes the newline character.
+// shows the screen scroll_view lines back: the oldest history_lines rows come
+// from the history ring, the rest from the saved screen
+static void scrollback_render(terminal_t *t)
+{
+  uint16_t *row = (uint16_t *)VIDEO;
+  uint32_t line = t->history_lines - t->scroll_view;
+  uint32_t r;
+  for (r = 0; r < NUM_ROWS; r++, line++, row += NUM_COLS)
+  {
+    if (line < t->history_lines)
+    {
+      uint32_t idx = t->history_next + SCROLLBACK_LINES - t->history_lines + line;
+      memcpy(row, t->history + (idx % SCROLLBACK_LINES) * NUM_COLS, NUM_COLS * sizeof(uint16_t));
+    }
+    else
+    {
+      memcpy(row, backing_row(cur_terminal_displayed, line - t->history_lines), NUM_COLS * sizeof(uint16_t));
+    }
+  }
+}
 
-Terminal read should be able to handle buffer overflow (User types more than 127 characters) and situations
-where the size sent by the user is smaller than 128 characters.
+void scrollback_scroll(int32_t lines)
+{
+  terminal_t *t = &terminals[cur_terminal_displayed];
+  int32_t view = (int32_t)t->scroll_view + lines;
+  if (view < 0)
+  {
+    view = 0;
+  }
+  if (view > (int32_t)t->history_lines)
+  {
+    view = t->history_lines;
+  }
+  if ((uint32_t)view == t->scroll_view)
+  {
+    return;
+  }
+  if (view == 0)
+  {
+    scrollback_reset();
+    return;
+  }
+  if (t->scroll_view == 0)
+  {
+    save_terminal_state();
+    change_blinking_cursor_pos(0, NUM_ROWS);  // off screen
+  }
+  t->scroll_view = view;
+  scrollback_render(t);
+}
 
-. If the user fills up one line by typing and hasn’t typed 128 characters yet, you should roll over to the next line.
-Backspace on the new line should go back to the previous line as well.
-*/
-int32_t terminal_read(int32_t fd, void *buf, int32_t nbytes)
+void scrollback_reset()
 {
-  // clear terminal buffer ( can read in max 127 chars cuz we need newline)
-  clear_terminal_line_buffer(cur_terminal_running);
+  if (terminals[cur_terminal_displayed].scroll_view == 0)
+  {
+    return;
+  }
+  terminals[cur_terminal_displayed].scroll_view = 0;
+  rewrite_video_state();
+}
 
-  sti();
-  // while (get_task()->term->line_buffer_idx < LINE_BUFFER_MAX_SIZE- 1 && get_task()->term->newline_received != 1)
-  //   ;
-  while (terminals[cur_terminal_running].newline_received != 1)
-    ;
+int32_t terminal_close(inode_t *inode, file_t *file)
+{
+  return 0;
+}
 
-  cli();
+// keeps a line that was read for get_previous_command. buf is the reader's
+static void remember_command(const void *buf, int32_t len)
+{
+  terminal_t *t = &terminals[cur_terminal_running];
+  uint8_t line[LINE_BUFFER_MAX_SIZE];
+  int i;
+  memset(line, 0, sizeof(line));
+  if (__copy_from_user(line, buf, len < LINE_BUFFER_MAX_SIZE ? len : LINE_BUFFER_MAX_SIZE))
+  {
+    return;
+  }
+  for (i = 0; i < MAX_PREVIOUS_COMMANDS; i++)
+  {
+    if (t->previous_commands[i].in_use == 0)
+    {
+      // if has space
+      memcpy(t->previous_commands[i].line_buffer, line, LINE_BUFFER_MAX_SIZE);
+      t->previous_commands[i].in_use = 1;
+      return;
+    }
+  }
+  // if the previous commands buffer is full
+  // shift everything 0-9 down one and leave room at 0
+  memmove(&t->previous_commands[1], &t->previous_commands[0],
+          (MAX_PREVIOUS_COMMANDS - 1) * sizeof(prev_command_t));
+  memcpy(t->previous_commands[0].line_buffer, line, LINE_BUFFER_MAX_SIZE);
+}
 
-  // once we reach here, we know either buffer was full or newline
-  // was received. Gets past when cur_terminal_running equals cur_terminal_displayed
+/*
+Input comes from the terminal's tty (drivers/tty.c). In canonical mode that's
+a line at a time with the newline on the end, the 128 characters include the
+newline. Whatever doesn't fit in nbytes stays for the next read, and so does
+anything typed before the program asked for it.
+*/
+int32_t terminal_read(file_t *file, void *buf, int32_t nbytes)
+{
+  tty_t *tty = tty_get(cur_terminal_running);
+  int32_t len = tty_read(tty, buf, nbytes);
+  if (len > 0 && !(tty->flags & TTY_FG_RAW))
+  {
+    remember_command(buf, len);
+  }
+  return len;
+}
 
-  terminals[cur_terminal_running].line_buffer[terminals[cur_terminal_running].line_buffer_idx] = '\n';
+int32_t terminal_ioctl(file_t *file, uint32_t request, uint32_t arg)
+{
+  return tty_ioctl(tty_get(cur_terminal_running), request, arg);
+}
 
-  // set enter flag to zero again
-  terminals[cur_terminal_running].newline_received = 0;
+/*
+Output engine for terminal_write. putc writes one cell, then moves the
+hardware cursor (four port writes) and saves the position, for every
+character. Here the position stays in locals while a chunk is parsed and
+whole runs of printable characters are stored as cells (character +
+attribute, one 16 bit store each). The cursor only goes back to the
+hardware, and the position to the terminal, once per write.
+*/
+#define CELL(c) ((uint16_t)((ATTRIB << 8) | (uint8_t)(c)))
 
-  // copy the characters into the buffer. Need -2 because we don't wanna read
-  // the newline into the buffer. We can handle formatting later but we
-  // want our buffers to only have the characters. The newline comes from the keyboard
+// row y of term, on the screen if it's displayed, else in its backing page
+static uint16_t *terminal_row(uint32_t term, uint32_t y)
+{
+  if (term == cur_terminal_displayed)
+  {
+    return (uint16_t *)VIDEO + y * NUM_COLS;
+  }
+  return backing_row(term, y);
+}
 
-  uint32_t i;
-  int8_t *bufnew = (int8_t *)buf;
-  for (i = 0; i < terminals[cur_terminal_running].line_buffer_idx + 1; i++)
+static void terminal_scroll(uint32_t term)
+{
+  if (term == cur_terminal_displayed)
   {
-    bufnew[i] = (int8_t)terminals[cur_terminal_running].line_buffer[i];
+    scroll_up();
   }
-  int j;
-  // remember this
-  for (i = 0; i < MAX_PREVIOUS_COMMANDS; i++)
+  else
+  {
+    scroll_up_mem(term);
+  }
+}
+
+/**
+ * @brief Draws n bytes of s at (*x, *y) of term and moves the position.
+ * Stops at a NUL like printf did
+ * @return int32_t bytes consumed
+ */
+static int32_t terminal_emit(uint32_t term, const uint8_t *s, int32_t n, uint32_t *x, uint32_t *y)
+{
+  int32_t i = 0;
+  while (i < n && s[i] != '\0')
   {
-    if (terminals[cur_terminal_running].previous_commands[i].in_use == 0)
+    if (s[i] == '\n' || s[i] == '\r')
     {
-      // if has space
-      memcpy(terminals[cur_terminal_running].previous_commands[i].line_buffer,
-             terminals[cur_terminal_running].line_buffer, LINE_BUFFER_MAX_SIZE);
-      terminals[cur_terminal_running].previous_commands[i].in_use = 1;
-      break;
+      *x = 0;
+      (*y)++;
+      i++;
     }
-    else if (i == MAX_PREVIOUS_COMMANDS - 1)
+    else
     {
-      // if the previous commands buffer is full
-      // shift everything 0-9 down one and leave room at 0
-      for (j = MAX_PREVIOUS_COMMANDS - 1; j >= 1; j--)
+      // the run ends at the end of the row or at the first byte that isn't a plain character
+      uint16_t *cell = terminal_row(term, *y) + *x;
+      uint32_t room = NUM_COLS - *x;
+      while (room && i < n && s[i] != '\0' && s[i] != '\n' && s[i] != '\r')
       {
-        memcpy(terminals[cur_terminal_running].previous_commands[j].line_buffer,
-               terminals[cur_terminal_running].previous_commands[j - 1].line_buffer, LINE_BUFFER_MAX_SIZE);
+        *cell++ = CELL(s[i]);
+        i++;
+        room--;
       }
-      memcpy(terminals[cur_terminal_running].previous_commands[0].line_buffer,
-             terminals[cur_terminal_running].line_buffer, LINE_BUFFER_MAX_SIZE);
+      *x = NUM_COLS - room;
+      if (*x == NUM_COLS)
+      {
+        *x = 0;
+        (*y)++;
+      }
+    }
+    if (*y == NUM_ROWS)
+    {
+      terminal_scroll(term);
+      *y = NUM_ROWS - 1;
     }
   }
-
-  // the number of characters read (not including newline)
-  int32_t ret = terminals[cur_terminal_running].line_buffer_idx + 1;
-
-  // memcpy(buf, cur_terminal_running->line_buffer, nbytes);
-  clear_terminal_line_buffer(cur_terminal_running);
-  return ret;
+  return i;
 }
 
 /*
@@ -192,24 +332,70 @@ be displayed to the screen immediately.
 The call returns the number of bytes
 written, or -1 on failure.
 */
-int32_t terminal_write(int32_t fd, const void *buf, int32_t nbytes)
+#define TERMINAL_WRITE_CHUNK 128
+int32_t terminal_write(file_t *file, const void *buf, int32_t nbytes)
 {
   if ((int8_t *)buf == 0)
   {
     return -1;
   }
-  if (cur_terminal_displayed == cur_terminal_running)
+  // buf is the user's, pull it in a chunk at a time. Output stops at a NUL
+  // like it did when this was printf
+  uint8_t chunk[TERMINAL_WRITE_CHUNK];
+  int32_t written = 0;
+  uint32_t flags, x, y;
+  uint32_t term = cur_terminal_running;
+  while (written < nbytes)
   {
-    nbytes = printf((int8_t*) buf);
+    int32_t n = nbytes - written < TERMINAL_WRITE_CHUNK ? nbytes - written : TERMINAL_WRITE_CHUNK;
+    int32_t done;
+    if (__copy_from_user(chunk, (const uint8_t *)buf + written, n))
+    {
+      return written ? written : -EFAULT;
+    }
+    // keyboard echo moves the same position, so a chunk is drawn in one go
+    cli_and_save(flags);
+    if (term == cur_terminal_displayed)
+    {
+      scrollback_reset();
+      x = screen_x;
+      y = screen_y;
+    }
+    else
+    {
+      x = terminals[term].screen_x;
+      y = terminals[term].screen_y;
+    }
+    done = terminal_emit(term, chunk, n, &x, &y);
+    if (term == cur_terminal_displayed)
+    {
+      screen_x = x;
+      screen_y = y;
+    }
+    terminals[term].screen_x = x;
+    terminals[term].screen_y = y;
+    restore_flags(flags);
+    written += done;
+    if (done < n)
+    {
+      break;
+    }
   }
-  else
+  if (term == cur_terminal_displayed)
   {
-    nbytes = printf_mem((int8_t*) buf);
+    change_blinking_cursor_pos(screen_x, screen_y);
   }
-
-  return nbytes;
+  return written;
 }
-int32_t terminal_open(const uint8_t *directory)
+int32_t terminal_open(inode_t *inode, file_t *file)
 {
   return 0;
 }
+
+file_operations_t terminal_fops = {
+    .open = terminal_open,
+    .release = terminal_close,
+    .read = terminal_read,
+    .write = terminal_write,
+    .ioctl = terminal_ioctl,
+};
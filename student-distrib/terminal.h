@@ -7,6 +7,8 @@
 #define LINE_BUFFER_MAX_SIZE 128
 #define NUM_TERMINALS 3
 #define MAX_PREVIOUS_COMMANDS 10
+// lines of history each terminal keeps above its screen, 0 turns it off
+#define SCROLLBACK_LINES 500
 
 // page directory entry 0000 0010 00 -> 8
 #define TERMINAL_VIDEO_VIRTUAL_ADDRESS 0x2000000
@@ -31,9 +33,17 @@ typedef struct terminal_t
 {
   // actual entire screen (for when we switch terminals)
   uint32_t video_mem_start;
-
-  // for terminal_read, set whenever user types enter
-  uint8_t newline_received;
+  // the backing page is a ring of rows, this one is the top of the screen
+  uint32_t row_offset;
+
+  // lines that scrolled off the top, a ring of SCROLLBACK_LINES rows of cells
+  // (NULL if it couldn't be allocated). history_next is where the next one
+  // goes, history_lines how many are in it
+  uint16_t *history;
+  uint32_t history_next;
+  uint32_t history_lines;
+  // how far back the screen is showing, 0 when it's live
+  uint32_t scroll_view;
 
   // since each terminal can run one task only, we store a pointer
   // to the currently running task here
@@ -44,9 +54,6 @@ typedef struct terminal_t
   uint32_t screen_y;
 
   uint32_t num_processes_running;
-  // line buffer for line-buffered input, and its index
-  uint8_t line_buffer[LINE_BUFFER_MAX_SIZE];
-  uint32_t line_buffer_idx;
 
   prev_command_t previous_commands[MAX_PREVIOUS_COMMANDS];
 
@@ -77,9 +84,24 @@ void get_next_command();
 // called when ALT + Function key combo pressed
 void switch_terminal(uint32_t new_terminal_idx);
 
-int32_t terminal_close(int32_t fd);
-int32_t terminal_read(int32_t fd, void *buf, int32_t nbytes);
-int32_t terminal_write(int32_t fd, const void *buf, int32_t nbytes);
-int32_t terminal_open(const uint8_t *directory);
+// saves a row that's about to scroll off the top of term's screen
+void scrollback_push(uint32_t term, const uint16_t *row);
+
+// Shift + PgUp / PgDn, moves the displayed terminal's view lines back (> 0)
+// or forward (< 0) through its history
+void scrollback_scroll(int32_t lines);
+
+// puts the live screen back if the displayed terminal is viewing history.
+// Anything that draws on the screen calls this first
+void scrollback_reset();
+
+int32_t terminal_close(inode_t *inode, file_t *file);
+int32_t terminal_read(file_t *file, void *buf, int32_t nbytes);
+int32_t terminal_write(file_t *file, const void *buf, int32_t nbytes);
+int32_t terminal_ioctl(file_t *file, uint32_t request, uint32_t arg);
+int32_t terminal_open(inode_t *inode, file_t *file);
+
+// registered as the "tty" character device, stdin and stdout open it
+extern file_operations_t terminal_fops;
 
 #endif
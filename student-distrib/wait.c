@@ -0,0 +1,57 @@
+#include "wait.h"
+#include "task.h"
+#include "lib.h"
+#include "errno.h"
+#include "mm/zeropage.h"
+
+void wait_queue_init(wait_queue_t *wq) {
+  wq->head = NULL;
+}
+
+int32_t wait_queue_sleep(wait_queue_t *wq) {
+  task *t = &tasks[get_task()->pid];
+  wait_entry_t me, **e;
+  int32_t ret = 0;
+
+  me.pid = t->pid;
+  me.next = wq->head;
+  wq->head = &me;
+  t->status = TASK_ST_SLEEP;
+
+  // the next timer tick switches away, and the scheduler doesn't come back
+  // to a sleeping task until wake_up. sti takes effect after hlt starts, so
+  // nothing gets in between. Until then the time goes to zeroing pages, one
+  // step at a time with a chance for interrupts in between
+  while (t->status == TASK_ST_SLEEP) {
+    if (t->pending_signals & ~t->signal_mask) {
+      t->status = TASK_ST_RUNNING;
+      ret = -EINTR;
+      break;
+    }
+    if (zeropage_idle()) {
+      asm volatile ("sti; nop; cli" : : : "memory");
+    }
+    else {
+      asm volatile ("sti; hlt; cli" : : : "memory");
+    }
+  }
+
+  // wake_up takes the whole list, but a signal leaves us on it
+  for (e = &wq->head; *e; e = &(*e)->next) {
+    if (*e == &me) {
+      *e = me.next;
+      break;
+    }
+  }
+  return ret;
+}
+
+void wake_up(wait_queue_t *wq) {
+  wait_entry_t *e;
+  for (e = wq->head; e; e = e->next) {
+    if (tasks[e->pid].status == TASK_ST_SLEEP) {
+      tasks[e->pid].status = TASK_ST_RUNNING;
+    }
+  }
+  wq->head = NULL;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file wait.h
+ * @brief Wait queues, for a task in a system call to sleep until something
+ * happens. The sleeper puts itself on the queue and goes TASK_ST_SLEEP, so
+ * the scheduler skips it. Whoever makes the thing happen calls wake_up, which
+ * makes every sleeper runnable again to recheck its condition.
+ */
+#ifndef WAIT_H
+#define WAIT_H
+
+#include "types.h"
+
+/**
+ *	A sleeping task. Lives on the sleeper's kernel stack while it sleeps
+ */
+typedef struct wait_entry {
+	uint32_t pid;				///< the sleeper
+	struct wait_entry *next;
+} wait_entry_t;
+
+typedef struct wait_queue {
+	wait_entry_t *head;			///< sleepers, NULL if there are none
+} wait_queue_t;
+
+/**
+ * @brief Empties wq
+ */
+void wait_queue_init(wait_queue_t *wq);
+
+/**
+ * @brief Sleeps the calling task on wq until wake_up. Called with
+ * interrupts off (so a wake_up can't slip in between checking the condition
+ * and going to sleep), returns with them off
+ * @return int32_t 0 when woken, -EINTR if a signal came in
+ */
+int32_t wait_queue_sleep(wait_queue_t *wq);
+
+/**
+ * @brief Makes every task sleeping on wq runnable
+ */
+void wake_up(wait_queue_t *wq);
+
+/**
+ * @brief Sleeps on wq until cond is true. Interrupts have to be off, cond is
+ * checked with them off. Sets ret to 0, or -EINTR if a signal cut the wait
+ * short
+ */
+#define wait_event(wq, cond, ret)							\
+	do {													\
+		(ret) = 0;											\
+		while (!(cond) && ((ret) = wait_queue_sleep(wq)) == 0)	\
+			;												\
+	} while (0)
+
+#endif
@@ -0,0 +1,56 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+
+/* low half of the time-stamp counter, see sysbench */
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* cat, timing only the writes to the terminal */
+int main ()
+{
+    int32_t fd, cnt;
+    uint8_t buf[BUFSIZE];
+    uint8_t num[SBUFSIZE];
+    uint32_t start, cycles = 0, bytes = 0;
+
+    if (0 != ece391_getargs (buf, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: catbench <file>\n");
+        return 3;
+    }
+
+    if (-1 == (fd = ece391_open (buf))) {
+        ece391_fdputs (1, (uint8_t*)"file not found\n");
+        return 2;
+    }
+
+    while (0 != (cnt = ece391_read (fd, buf, BUFSIZE))) {
+        if (-1 == cnt) {
+            ece391_fdputs (1, (uint8_t*)"file read failed\n");
+            return 3;
+        }
+        start = rdtsc_lo ();
+        if (-1 == ece391_write (1, buf, cnt))
+            return 3;
+        cycles += rdtsc_lo () - start;
+        bytes += cnt;
+    }
+    ece391_close (fd);
+
+    ece391_fdputs (1, (uint8_t*)"\n");
+    ece391_fdputs (1, ece391_itoa (bytes, num, 10));
+    ece391_fdputs (1, (uint8_t*)" bytes written in ");
+    ece391_fdputs (1, ece391_itoa (cycles, num, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles, ");
+    ece391_fdputs (1, ece391_itoa (bytes ? cycles / bytes : 0, num, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles/byte\n");
+    return 0;
+}
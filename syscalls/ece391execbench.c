@@ -0,0 +1,103 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+#define LAUNCHES 10000
+#define MARK '\0'
+
+/* low half of the time-stamp counter, one launch is far under 2^32 cycles */
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* reads what the program wrote, up to the mark put in after it halted */
+static void drain (int32_t fd, int32_t wfd)
+{
+    uint8_t buf[BUFSIZE];
+    uint8_t mark = MARK;
+    int32_t cnt;
+
+    ece391_write (wfd, &mark, 1);
+    do {
+        cnt = ece391_read (fd, buf, BUFSIZE);
+    } while (cnt > 0 && buf[cnt - 1] != MARK);
+}
+
+static void print_result (const char* label, uint32_t value)
+{
+    uint8_t buf[SBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles\n");
+}
+
+/* runs a program LAUNCHES times, hello by default. Each run gets a line on
+   stdin and its output goes to a pipe, so the time is the launch (execute
+   up to halt) and not the terminal */
+int main ()
+{
+    uint8_t prog[BUFSIZE];
+    int32_t in[2], out[2];
+    int32_t saved_in, saved_out;
+    uint32_t start, cycles, first = 0, best = 0xFFFFFFFF;
+    uint32_t avg = 0, rem = 0;
+    int32_t i, ret = 0;
+
+    if (0 != ece391_getargs (prog, BUFSIZE) || prog[0] == '\0')
+        ece391_strcpy (prog, (uint8_t*)"hello");
+
+    if (ece391_pipe (in) < 0 || ece391_pipe (out) < 0) {
+        ece391_fdputs (1, (uint8_t*)"pipe failed\n");
+        return 2;
+    }
+    saved_in = ece391_dup (0);
+    saved_out = ece391_dup (1);
+    ece391_dup2 (in[0], 0);
+    ece391_dup2 (out[1], 1);
+
+    for (i = 0; i < LAUNCHES; i++) {
+        ece391_write (in[1], "\n", 1);
+        start = rdtsc_lo ();
+        ret = ece391_execute (prog);
+        cycles = rdtsc_lo () - start;
+        drain (out[0], out[1]);
+        if (ret < 0)
+            break;
+        if (i == 0)
+            first = cycles;
+        if (cycles < best)
+            best = cycles;
+        /* exact average without 64 bit division */
+        avg += cycles / LAUNCHES;
+        rem += cycles % LAUNCHES;
+        if (rem >= LAUNCHES) {
+            avg++;
+            rem -= LAUNCHES;
+        }
+    }
+
+    ece391_dup2 (saved_in, 0);
+    ece391_dup2 (saved_out, 1);
+    ece391_close (saved_in);
+    ece391_close (saved_out);
+    ece391_close (in[0]);
+    ece391_close (in[1]);
+    ece391_close (out[0]);
+    ece391_close (out[1]);
+
+    if (ret < 0) {
+        ece391_fdputs (1, (uint8_t*)"execute failed\n");
+        return 3;
+    }
+    print_result ("first launch: ", first);
+    print_result ("best launch:  ", best);
+    print_result ("average:      ", avg);
+    return 0;
+}
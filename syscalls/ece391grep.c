@@ -7,22 +7,20 @@
 #define BUFSIZE 1024
 #define SBUFSIZE 33
 
+/* prints the lines of fd that have s in them, each prefixed with "fname:"
+   unless fname is NULL */
 int32_t
-do_one_file(const char * s,
+do_one_fd(const char * s, int32_t fd,
   const char * fname) {
-  int32_t fd, cnt, last, line_start, line_end, check, s_len;
+  int32_t cnt, last, line_start, line_end, check, s_len;
   uint8_t data[BUFSIZE + 1];
+  struct ece391_iovec iov[4];
 
   s_len = ece391_strlen((uint8_t * ) s);
-  if (-1 == (fd = ece391_open((uint8_t * ) fname))) {
-    ece391_fdputs(1, (uint8_t * )
-      "file open failed\n");
-    return -1;
-  }
   last = 0;
   while (1) {
     cnt = ece391_read(fd, data + last, BUFSIZE - last);
-    if (-1 == cnt) {
+    if (0 > cnt) {
       ece391_fdputs(1, (uint8_t * )
         "file read failed\n");
       return -1;
@@ -48,12 +46,16 @@ do_one_file(const char * s,
       for (check = line_start; check < line_end; check++) {
         if (s[0] == data[check] &&
           0 == ece391_strncmp((uint8_t * )(data + check), (uint8_t * ) s, s_len)) {
-          ece391_fdputs(1, (uint8_t * ) fname);
-          ece391_fdputs(1, (uint8_t * )
-            ":");
-          ece391_fdputs(1, data + line_start);
-          ece391_fdputs(1, (uint8_t * )
-            "\n");
+          /* the whole match line in one system call */
+          iov[0].iov_base = (void * ) fname;
+          iov[0].iov_len = fname ? ece391_strlen((uint8_t * ) fname) : 0;
+          iov[1].iov_base = ":";
+          iov[1].iov_len = fname ? 1 : 0;
+          iov[2].iov_base = data + line_start;
+          iov[2].iov_len = line_end - line_start;
+          iov[3].iov_base = "\n";
+          iov[3].iov_len = 1;
+          ece391_writev(1, iov, 4);
           break;
         }
       }
@@ -66,6 +68,21 @@ do_one_file(const char * s,
     if (0 == cnt)
       break;
   }
+  return 0;
+}
+
+int32_t
+do_one_file(const char * s,
+  const char * fname) {
+  int32_t fd;
+
+  if (-1 == (fd = ece391_open((uint8_t * ) fname))) {
+    ece391_fdputs(1, (uint8_t * )
+      "file open failed\n");
+    return -1;
+  }
+  if (0 != do_one_fd(s, fd, fname))
+    return -1;
   if (-1 == ece391_close(fd)) {
     ece391_fdputs(1, (uint8_t * )
       "file close failed\n");
@@ -85,6 +102,10 @@ int main() {
     return 3;
   }
 
+  /* stdin that isn't the terminal is a pipe, search that instead */
+  if (0 > ece391_ioctl(0, ECE391_TTY_GETFLAGS, 0))
+    return 0 == do_one_fd((char * ) search, 0, 0) ? 0 : 3;
+
   if (-1 == (fd = ece391_open((uint8_t * )
       "."))) {
     ece391_fdputs(1, (uint8_t * )
@@ -0,0 +1,48 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 33
+
+static void print_stat (const char* label, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+int main ()
+{
+    uint8_t dev[BUFSIZE];
+    struct ece391_iostat st;
+
+    if (0 != ece391_getargs (dev, BUFSIZE) || dev[0] == '\0')
+        ece391_strcpy (dev, (uint8_t*)"hda");
+
+    if (0 != ece391_iostat (dev, &st)) {
+        ece391_fdputs (1, (uint8_t*)"no such block device\n");
+        return 2;
+    }
+
+    ece391_fdputs (1, dev);
+    ece391_fdputs (1, (uint8_t*)":\n");
+    print_stat ("  read requests:    ", st.reads);
+    print_stat ("  write requests:   ", st.writes);
+    print_stat ("  sectors read:     ", st.sectors_read);
+    print_stat ("  sectors written:  ", st.sectors_written);
+    print_stat ("  errors:           ", st.errors);
+    print_stat ("  avg cycles/req:   ", st.avg_cycles);
+    print_stat ("  max cycles/req:   ", st.max_cycles);
+    ece391_fdputs (1, (uint8_t*)"buffer cache:\n");
+    print_stat ("  hits:             ", st.cache_hits);
+    print_stat ("  misses:           ", st.cache_misses);
+    print_stat ("  read-ahead:       ", st.readahead);
+    print_stat ("  read-ahead hits:  ", st.readahead_hits);
+    print_stat ("  evictions:        ", st.evictions);
+    print_stat ("  writebacks:       ", st.writebacks);
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 33
+#define VECTORS 256
+
+static struct ece391_irqstat st[VECTORS];
+
+/* what the kernel puts on each vector, see interrupt_handlers.c */
+static const char* vector_name (int32_t v)
+{
+    static const char* exceptions[20] = {
+        "divide", "debug", "nmi", "breakpoint", "overflow", "bound",
+        "opcode", "no fpu", "double fault", "fpu overrun", "tss",
+        "not present", "stack", "protection", "page fault", "",
+        "fpu", "alignment", "machine check", "simd"
+    };
+    if (v < 20)
+        return exceptions[v];
+    switch (v) {
+        case 0x20: return "timer";
+        case 0x21: return "keyboard";
+        case 0x27: return "spurious irq7";
+        case 0x28: return "rtc";
+        case 0x2E: return "ata";
+        case 0x2F: return "spurious irq15";
+        case 0x80: return "syscall";
+    }
+    return "";
+}
+
+/* value right aligned in width columns */
+static void put_num (uint32_t value, int32_t width)
+{
+    uint8_t buf[BUFSIZE];
+    int32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+/* s left aligned in width columns */
+static void put_pad (const char* s, int32_t width)
+{
+    int32_t len;
+
+    ece391_fdputs (1, (uint8_t*)s);
+    for (len = ece391_strlen ((uint8_t*)s); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+}
+
+/* every vector that has fired: how often, and the handler's min / avg / max
+   TSC cycles where it was timed */
+int main ()
+{
+    int32_t n, v;
+
+    n = ece391_irqstat (st, VECTORS);
+    if (n < 0) {
+        ece391_fdputs (1, (uint8_t*)"irqstat failed\n");
+        return 2;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"vec name                count      min      avg      max\n");
+    for (v = 0; v < n; v++) {
+        if (!st[v].count)
+            continue;
+        put_num (v, 3);
+        ece391_fdputs (1, (uint8_t*)" ");
+        put_pad (vector_name (v), 14);
+        put_num (st[v].count, 11);
+        if (st[v].timed) {
+            put_num (st[v].min_cycles, 9);
+            put_num (st[v].avg_cycles, 9);
+            put_num (st[v].max_cycles, 9);
+        }
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    return 0;
+}
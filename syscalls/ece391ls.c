@@ -3,26 +3,42 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
-#define SBUFSIZE 33
+#define BUFSIZE 1024
 
 int main ()
 {
-    int32_t fd, cnt;
-    uint8_t buf[SBUFSIZE];
+    int32_t fd, cnt, off, len, outlen;
+    uint8_t buf[BUFSIZE];
+    uint8_t out[BUFSIZE];
+    struct ece391_dirent* de;
 
-    if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
+    /* the directory to list, "." unless one is given */
+    if (0 != ece391_getargs (buf, BUFSIZE) || buf[0] == '\0')
+        ece391_strcpy (buf, (uint8_t*)".");
+
+    if (-1 == (fd = ece391_open (buf))) {
         ece391_fdputs (1, (uint8_t*)"directory open failed\n");
         return 2;
     }
 
-    while (0 != (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
-        if (-1 == cnt) {
+    /* one getdents returns a whole batch of entries, and the names of the
+       batch go out in a single write (a name never takes more room in out
+       than its record took in buf) */
+    while (0 != (cnt = ece391_getdents (fd, buf, BUFSIZE))) {
+        if (cnt < 0) {
 	        ece391_fdputs (1, (uint8_t*)"directory entry read failed\n");
 	        return 3;
 	    }
-	    buf[cnt] = '\n';
-	    if (-1 == ece391_write (1, buf, cnt + 1))
-	        return 3;
+        outlen = 0;
+        for (off = 0; off < cnt; off += de->d_reclen) {
+            de = (struct ece391_dirent*)(buf + off);
+            len = ece391_strlen ((uint8_t*)de->d_name);
+            ece391_strcpy (out + outlen, (uint8_t*)de->d_name);
+            outlen += len;
+            out[outlen++] = '\n';
+        }
+        if (-1 == ece391_write (1, out, outlen))
+            return 3;
     }
 
     return 0;
@@ -0,0 +1,133 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+#define CHUNK 64 /* small reads, so the cost per system call dominates */
+
+static struct ece391_ring ring;
+static uint8_t chunks[ECE391_RING_ENTRIES][CHUNK];
+
+/* low half of the time-stamp counter, see sysbench */
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* what cat would have written, folded into a number so the terminal
+   doesn't end up being what's measured */
+static uint32_t sum_chunk (uint32_t sum, const uint8_t* buf, int32_t cnt)
+{
+    int32_t i;
+    for (i = 0; i < cnt; i++)
+        sum = sum * 31 + buf[i];
+    return sum;
+}
+
+/* one read system call per chunk */
+static int32_t stream_plain (uint8_t* fname, uint32_t* sum, uint32_t* bytes)
+{
+    int32_t fd, cnt;
+
+    if (-1 == (fd = ece391_open (fname)))
+        return -1;
+    while (0 != (cnt = ece391_read (fd, chunks[0], CHUNK))) {
+        if (cnt < 0)
+            return -1;
+        *sum = sum_chunk (*sum, chunks[0], cnt);
+        *bytes += cnt;
+    }
+    ece391_close (fd);
+    return 0;
+}
+
+/* a full queue of reads per system call. They run in order on the same
+   file, so the completions come back in file order too */
+static int32_t stream_ring (uint8_t* fname, uint32_t* sum, uint32_t* bytes)
+{
+    int32_t fd, i, done = 0;
+    struct ece391_ring_sqe* sqe;
+    struct ece391_ring_cqe* cqe;
+
+    if (-1 == (fd = ece391_open (fname)))
+        return -1;
+    if (0 != ece391_ring_setup (&ring, 0))
+        return -1;
+    while (!done) {
+        for (i = 0; i < ECE391_RING_ENTRIES; i++) {
+            sqe = &ring.sq[ring.sq_tail % ECE391_RING_ENTRIES];
+            sqe->opcode = ECE391_RING_OP_READ;
+            sqe->fd = fd;
+            sqe->addr = (uint32_t)chunks[i];
+            sqe->len = CHUNK;
+            sqe->user_data = i;
+            ring.sq_tail++;
+        }
+        if (ECE391_RING_ENTRIES != ece391_enter_ring (ECE391_RING_ENTRIES))
+            return -1;
+        while (ring.cq_head != ring.cq_tail) {
+            cqe = &ring.cq[ring.cq_head % ECE391_RING_ENTRIES];
+            ring.cq_head++;
+            if (cqe->res < 0)
+                return -1;
+            if (0 == cqe->res)
+                done = 1;
+            if (!done) {
+                *sum = sum_chunk (*sum, chunks[cqe->user_data], cqe->res);
+                *bytes += cqe->res;
+            }
+        }
+    }
+    ece391_ring_setup (0, 0);
+    ece391_close (fd);
+    return 0;
+}
+
+static void print_result (const char* label, uint32_t cycles, uint32_t bytes)
+{
+    uint8_t buf[SBUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (cycles, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles, ");
+    ece391_fdputs (1, ece391_itoa (bytes ? cycles / bytes : 0, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles/byte\n");
+}
+
+int main ()
+{
+    uint8_t fname[BUFSIZE];
+    uint32_t start, plain, ringed;
+    uint32_t sum_plain = 0, sum_ring = 0, bytes_plain = 0, bytes_ring = 0;
+
+    if (0 != ece391_getargs (fname, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: ringbench <file>\n");
+        return 3;
+    }
+
+    start = rdtsc_lo ();
+    if (0 != stream_plain (fname, &sum_plain, &bytes_plain)) {
+        ece391_fdputs (1, (uint8_t*)"plain read failed\n");
+        return 2;
+    }
+    plain = rdtsc_lo () - start;
+
+    start = rdtsc_lo ();
+    if (0 != stream_ring (fname, &sum_ring, &bytes_ring)) {
+        ece391_fdputs (1, (uint8_t*)"ring read failed\n");
+        return 2;
+    }
+    ringed = rdtsc_lo () - start;
+
+    if (sum_plain != sum_ring || bytes_plain != bytes_ring) {
+        ece391_fdputs (1, (uint8_t*)"ring read different data\n");
+        return 1;
+    }
+    print_result ("read syscalls: ", plain, bytes_plain);
+    print_result ("ring:          ", ringed, bytes_ring);
+    return 0;
+}
@@ -5,6 +5,73 @@
 
 #define BUFSIZE 1024
 
+/* Cuts the spaces off both ends of s */
+static uint8_t* trim (uint8_t* s)
+{
+    uint8_t* end;
+    while (' ' == *s)
+        s++;
+    end = s + ece391_strlen (s);
+    while (end > s && ' ' == end[-1])
+        *--end = '\0';
+    return s;
+}
+
+/* Runs "a | b | ...". execute only returns once the program is done, so the
+   stages run one after another and each one's output waits in a pipe for
+   the next. A pipe nobody has read yet takes up to 1MB of it (fs/pipe.h),
+   so a stage never waits on one that hasn't started; past that its writes
+   fail. Returns what the last stage returned */
+static int32_t run_pipeline (uint8_t* cmd)
+{
+    int32_t saved_in = ece391_dup (0), saved_out = ece391_dup (1);
+    int32_t in = -1, fds[2], rval = 0;
+    uint8_t* next;
+
+    while (0 != cmd) {
+        for (next = cmd; '\0' != *next && '|' != *next; next++)
+            ;
+        if ('|' == *next)
+            *next++ = '\0';
+        else
+            next = 0;
+
+        if (-1 != in) {
+            ece391_dup2 (in, 0);
+            ece391_close (in);
+            in = -1;
+        }
+        if (0 != next) {
+            if (0 != ece391_pipe (fds)) {
+                ece391_fdputs (saved_out, (uint8_t*)"pipe failed\n");
+                rval = -1;
+                break;
+            }
+            ece391_dup2 (fds[1], 1);
+            ece391_close (fds[1]);
+            in = fds[0];
+        } else {
+            ece391_dup2 (saved_out, 1);
+        }
+
+        /* the child gets our stdin and stdout */
+        rval = ece391_execute (trim (cmd));
+        /* done with the pipe it read, and with the write end once the next
+           stage's stdout replaces it, so the next reader sees the end */
+        ece391_dup2 (saved_in, 0);
+        if (-1 == rval)
+            break;
+        cmd = next;
+    }
+    if (-1 != in)
+        ece391_close (in);
+    ece391_dup2 (saved_in, 0);
+    ece391_dup2 (saved_out, 1);
+    ece391_close (saved_in);
+    ece391_close (saved_out);
+    return rval;
+}
+
 int main ()
 {
     int32_t cnt, rval;
@@ -24,7 +91,24 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
+	/* cd has to run in the shell itself, a child can't change our directory */
+	if (0 == ece391_strncmp (buf, (uint8_t*)"cd", 2) &&
+	    ('\0' == buf[2] || ' ' == buf[2])) {
+	    uint8_t* dir = buf + 2;
+	    while (' ' == *dir)
+	        dir++;
+	    if ('\0' == *dir)
+	        dir = (uint8_t*)"/";
+	    if (0 != ece391_chdir (dir))
+	        ece391_fdputs (1, (uint8_t*)"no such directory\n");
+	    continue;
+	}
+	for (cnt = 0; '\0' != buf[cnt] && '|' != buf[cnt]; cnt++)
+	    ;
+	if ('|' == buf[cnt])
+	    rval = run_pipeline (buf);
+	else
+	    rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
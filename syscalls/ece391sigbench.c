@@ -0,0 +1,70 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 33
+#define ROUNDS 100
+#define KERNEL_SIGUSR1 30   /* USER1 in the kernel's numbering, what kill takes */
+
+static volatile uint32_t handled_at;
+static volatile int32_t handled;
+
+/* low half of the time-stamp counter, see sysbench */
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+static void usr1_handler (int signum)
+{
+    handled_at = rdtsc_lo ();
+    handled = 1;
+}
+
+static void print_result (const char* label, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles\n");
+}
+
+/* cycles from kill() on ourselves to the handler running */
+int main ()
+{
+    uint32_t start, cycles, best = 0xFFFFFFFF, worst = 0, total = 0;
+    int32_t pid = ece391_getpid ();
+    int32_t i;
+
+    if (0 != ece391_set_handler (USER1, usr1_handler)) {
+        ece391_fdputs (1, (uint8_t*)"set_handler failed\n");
+        return 2;
+    }
+
+    for (i = 0; i < ROUNDS; i++) {
+        handled = 0;
+        start = rdtsc_lo ();
+        if (0 != ece391_kill (pid, KERNEL_SIGUSR1)) {
+            ece391_fdputs (1, (uint8_t*)"kill failed\n");
+            return 3;
+        }
+        /* until the handler has run, however it gets there */
+        while (!handled)
+            ;
+        cycles = handled_at - start;
+        if (cycles < best)
+            best = cycles;
+        if (cycles > worst)
+            worst = cycles;
+        total += cycles / ROUNDS;
+    }
+
+    print_result ("kill to handler, best:  ", best);
+    print_result ("kill to handler, worst: ", worst);
+    print_result ("kill to handler, avg:   ", total);
+    return 0;
+}
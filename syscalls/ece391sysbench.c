@@ -0,0 +1,67 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 33
+#define CALLS 20000
+#define ROUNDS 5
+#define VSYSCALL_ENTRY ((uint8_t**)0x10000004)
+#define INT_OPCODE 0xCD
+
+/* low half of the time-stamp counter is plenty, a round is far under 2^32 cycles */
+static uint32_t rdtsc_lo (void)
+{
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return lo;
+}
+
+/* best average over ROUNDS rounds of CALLS calls, in cycles per call */
+static uint32_t bench (int32_t (*call)(void))
+{
+    uint32_t best = 0xFFFFFFFF;
+    uint32_t start, cycles;
+    int32_t i, r;
+
+    for (r = 0; r < ROUNDS; r++) {
+        start = rdtsc_lo ();
+        for (i = 0; i < CALLS; i++)
+            call ();
+        cycles = (rdtsc_lo () - start) / CALLS;
+        if (cycles < best)
+            best = cycles;
+    }
+    return best;
+}
+
+static void print_result (const char* label, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)label);
+    ece391_fdputs (1, ece391_itoa (value, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles/call\n");
+}
+
+int main ()
+{
+    uint32_t int80, vsyscall;
+
+    if (ece391_getpid () != ece391_getpid_int80 ()) {
+        ece391_fdputs (1, (uint8_t*)"getpid differs between entry paths\n");
+        return 2;
+    }
+
+    /* the stub starts with the int instruction when SYSENTER is off */
+    if (**VSYSCALL_ENTRY == INT_OPCODE)
+        ece391_fdputs (1, (uint8_t*)"vsyscall: int 0x80 (no SYSENTER)\n");
+    else
+        ece391_fdputs (1, (uint8_t*)"vsyscall: sysenter\n");
+
+    int80 = bench (ece391_getpid_int80);
+    vsyscall = bench (ece391_getpid);
+    print_result ("getpid, int 0x80: ", int80);
+    print_result ("getpid, vsyscall: ", vsyscall);
+    return 0;
+}
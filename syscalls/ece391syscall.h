@@ -22,6 +22,153 @@ extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
 
+/* Directory entry filled in by getdents, same layout as the kernel's struct dirent.
+ * Entries are packed back to back, d_reclen is the offset to the next one */
+struct ece391_dirent {
+    uint32_t d_ino;      /* offset 0 */
+    uint32_t d_size;     /* 4 */
+    uint16_t d_reclen;   /* 8 */
+    uint8_t d_type;      /* 10 */
+    uint8_t d_pad;       /* 11, always 0 */
+    char d_name[];       /* 12 */
+};
+
+/* Fills buf with as many entries of the directory fd as fit. Returns the
+ * number of bytes used, 0 at the end of the directory, negative on error */
+extern int32_t ece391_getdents (int32_t fd, void* buf, uint32_t count);
+
+/* Directories. Paths may be absolute or relative to the working directory */
+extern int32_t ece391_chdir (const uint8_t* path);
+extern int32_t ece391_mkdir (const uint8_t* path, int32_t mode);
+
+/* Block device + buffer cache statistics, same layout as the kernel's iostat_t */
+struct ece391_iostat {
+    uint32_t reads, writes;
+    uint32_t sectors_read, sectors_written;
+    uint32_t errors;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+    uint32_t avg_cycles;
+    uint32_t cache_hits, cache_misses;
+    uint32_t readahead, readahead_hits;
+    uint32_t evictions, writebacks;
+};
+
+/* Returns 0 on success, negative if the device doesn't exist */
+extern int32_t ece391_iostat (const uint8_t* dev, struct ece391_iostat* buf);
+
+/* New fd sharing the open file (and its position) of fd */
+extern int32_t ece391_dup (int32_t fd);
+/* Point newfd at oldfd's open file, closing newfd first. Returns newfd */
+extern int32_t ece391_dup2 (int32_t oldfd, int32_t newfd);
+
+/* fds[0] = read end, fds[1] = write end. Reads wait for data and return 0
+   once every write end is closed. Returns 0 or a negative errno */
+extern int32_t ece391_pipe (int32_t fds[2]);
+
+/* Process id of the caller. The _int80 version always enters the kernel with
+   INT $0x80 instead of the vsyscall stub, to compare the two */
+extern int32_t ece391_getpid (void);
+extern int32_t ece391_getpid_int80 (void);
+
+/* One buffer of a readv / writev, same layout as the kernel's struct iovec */
+struct ece391_iovec {
+    void* iov_base;
+    uint32_t iov_len;
+};
+
+/* read / write over iovcnt (at most 16) buffers in one call. Returns the
+   total number of bytes moved, stopping at the first short transfer */
+extern int32_t ece391_readv (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+
+/* read / write at offset in a regular file without moving its position */
+extern int32_t ece391_pread (int32_t fd, void* buf, int32_t nbytes, uint32_t offset);
+extern int32_t ece391_pwrite (int32_t fd, const void* buf, int32_t nbytes, uint32_t offset);
+
+/* System call ring, same layout as the kernel's ring_t (ring.h). Queue
+   entries at sq[sq_tail % ECE391_RING_ENTRIES], bump sq_tail, then
+   ece391_enter_ring runs them and posts one completion each */
+#define ECE391_RING_ENTRIES 32
+#define ECE391_RING_POLL    0x1   /* drained after timer ticks too */
+
+#define ECE391_RING_OP_NOP   0
+#define ECE391_RING_OP_READ  1
+#define ECE391_RING_OP_WRITE 2
+#define ECE391_RING_OP_OPEN  3
+#define ECE391_RING_OP_CLOSE 4
+
+struct ece391_ring_sqe {
+    uint8_t opcode;
+    uint8_t pad[3];
+    int32_t fd;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t user_data;
+};
+
+struct ece391_ring_cqe {
+    uint32_t user_data;
+    int32_t res;
+};
+
+struct ece391_ring {
+    volatile uint32_t sq_head, sq_tail;
+    volatile uint32_t cq_head, cq_tail;
+    struct ece391_ring_sqe sq[ECE391_RING_ENTRIES];
+    struct ece391_ring_cqe cq[ECE391_RING_ENTRIES];
+};
+
+/* Register ring (NULL unregisters). Returns 0 or a negative errno */
+extern int32_t ece391_ring_setup (struct ece391_ring* ring, uint32_t flags);
+/* Run up to to_submit queued entries, returns how many ran */
+extern int32_t ece391_enter_ring (uint32_t to_submit);
+
+/* Terminal modes, same as the kernel's TTY_FG_* (drivers/tty.h). By default
+   reads wait for Enter and return the line; in raw mode they return as soon
+   as a key is pressed */
+#define ECE391_TTY_GETFLAGS 0x5401
+#define ECE391_TTY_SETFLAGS 0x5402
+#define ECE391_TTY_NOECHO   0x1
+#define ECE391_TTY_RAW      0x2
+
+extern int32_t ece391_ioctl (int32_t fd, uint32_t request, uint32_t arg);
+
+/* What a signal carries, same layout as the kernel's siginfo_t */
+struct ece391_siginfo {
+    int32_t si_signo;
+    int32_t si_code;
+    int32_t si_pid;
+    int32_t si_value;
+};
+
+/* Sends signum (the kernel's numbering, SIGUSR1 is 30) to pid. Returns 0 or
+   a negative errno */
+extern int32_t ece391_kill (int32_t pid, int32_t signum);
+/* Sends signum (the kernel's numbering) to pid with value. Every send is
+   queued and delivered on its own, in order. Returns 0 or a negative errno */
+extern int32_t ece391_sigqueue (int32_t pid, int32_t signum, int32_t value);
+/* fd that reads a struct ece391_siginfo per pending signal in mask (bit n for
+   signal n) instead of running handlers. fd -1 makes a new one, otherwise
+   changes the mask of fd. Returns the fd or a negative errno */
+extern int32_t ece391_signalfd (int32_t fd, uint32_t mask);
+
+/* Interrupt stats of one vector, same layout as the kernel's irqstat_t. The
+   cycles are TSC cycles in the handler, over the timed entries only (IRQs
+   whose handler came back, not exceptions or system calls) */
+struct ece391_irqstat {
+    uint32_t count;
+    uint32_t timed;
+    uint64_t total_cycles;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint32_t avg_cycles;
+};
+
+/* Fills buf with the stats of vectors 0 to n - 1 (at most 256). Returns how
+   many it filled or a negative errno */
+extern int32_t ece391_irqstat (struct ece391_irqstat* buf, uint32_t n);
+
 enum signums {
 	DIV_ZERO = 0,
 	SEGFAULT,